@@ -0,0 +1,62 @@
+#!/usr/bin/python
+#
+# replay-bootstrap.py:  Time block connection over a bootstrap.dat range with
+#                       different numbers of script verification threads.
+#
+# Copyright (c) 2013-2015 The Bitcoin developers
+# Distributed under the MIT/X11 software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#
+# Usage: replay-bootstrap.py <MarteXd> <bootstrap.dat> [par ...]
+#
+# A bootstrap.dat covering the wanted height range can be produced with
+# contrib/linearize (set min_height/max_height). Every run imports the file
+# into a fresh data directory with -loadblock -stopafterblockimport and the
+# wall-clock import time reported in debug.log is compared against -par=1.
+#
+
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+RE_LOADED = re.compile(r'Loaded (\d+) blocks from external file in (\d+)ms')
+
+def replay(daemon, bootstrap, par):
+	datadir = tempfile.mkdtemp(prefix='martex-bench-')
+	try:
+		subprocess.check_call([daemon, '-datadir=' + datadir, '-listen=0',
+			'-maxconnections=0', '-dnsseed=0', '-nosmsg', '-server=0', '-benchmark',
+			'-loadblock=' + bootstrap, '-stopafterblockimport',
+			'-par=%d' % par])
+		for line in open(os.path.join(datadir, 'debug.log')):
+			m = RE_LOADED.search(line)
+			if m:
+				return (int(m.group(1)), int(m.group(2)))
+		raise RuntimeError('no import summary in debug.log (par=%d)' % par)
+	finally:
+		shutil.rmtree(datadir)
+
+if __name__ == '__main__':
+	if len(sys.argv) < 3:
+		print "Usage: replay-bootstrap.py <MarteXd> <bootstrap.dat> [par ...]"
+		sys.exit(1)
+
+	daemon = sys.argv[1]
+	bootstrap = os.path.abspath(sys.argv[2])
+	pars = [int(x) for x in sys.argv[3:]] or [1, 0]
+	if 1 not in pars:
+		pars.insert(0, 1)
+
+	results = {}
+	for par in pars:
+		results[par] = replay(daemon, bootstrap, par)
+
+	nBlocks, nBase = results[1]
+	for par in pars:
+		nLoaded, nMillis = results[par]
+		print "-par=%-3d %7d blocks %9dms %8.1f blocks/s  speedup %.2fx" % (
+			par, nLoaded, nMillis, nLoaded * 1000.0 / max(nMillis, 1),
+			float(nBase) / max(nMillis, 1))
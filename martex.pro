@@ -214,6 +214,7 @@ HEADERS += src/qt/bitcoingui.h \
     src/qt/editaddressdialog.h \
     src/qt/bitcoinaddressvalidator.h \
     src/alert.h \
+    src/arith_uint256.h \
     src/blocksizecalculator.h \
     src/allocators.h \
     src/addrman.h \
@@ -234,6 +235,10 @@ HEADERS += src/qt/bitcoingui.h \
     src/support/cleanse.h \
     src/core.h \
     src/main.h \
+    src/mappedfile.h \
+    src/merkle.h \
+    src/arena.h \
+    src/checkqueue.h \
     src/miner.h \
     src/net.h \
     src/ecwrapper.h \
@@ -241,6 +246,7 @@ HEADERS += src/qt/bitcoingui.h \
     src/pubkey.h \
     src/db.h \
     src/txdb.h \
+    src/leveldbbatch.h \
     src/txmempool.h \
     src/walletdb.h \
     src/script.h \
@@ -302,6 +308,8 @@ HEADERS += src/qt/bitcoingui.h \
     src/anonsend.h \
     src/anonsend-relay.h \
     src/fasttx.h \
+    src/fasttxcheck.h \
+    src/timingwheel.h \
     src/activemasternode.h \
     src/masternodeconfig.h \
     src/masternodeman.h \
@@ -313,6 +321,7 @@ HEADERS += src/qt/bitcoingui.h \
     src/crypto/ripemd160.h \
     src/crypto/sha1.h \
     src/crypto/sha256.h \
+    src/crypto/sha256_impl.h \
     src/crypto/sha512.h \
     src/qt/masternodemanager.h \
     src/qt/addeditadrenalinenode.h \
@@ -355,6 +364,7 @@ SOURCES += src/qt/bitcoin.cpp src/qt/bitcoingui.cpp \
     src/qt/editaddressdialog.cpp \
     src/qt/bitcoinaddressvalidator.cpp \
     src/alert.cpp \
+    src/arith_uint256.cpp \
     src/blocksizecalculator.cpp \
     src/allocators.cpp \
     src/base58.cpp \
@@ -365,6 +375,7 @@ SOURCES += src/qt/bitcoin.cpp src/qt/bitcoingui.cpp \
     src/txmempool.cpp \
     src/util.cpp \
     src/hash.cpp \
+    src/hashblock.cpp \
     src/netbase.cpp \
     src/ecwrapper.cpp \
     src/key.cpp \
@@ -373,6 +384,8 @@ SOURCES += src/qt/bitcoin.cpp src/qt/bitcoingui.cpp \
     src/scrypt.cpp \
     src/core.cpp \
     src/main.cpp \
+    src/mappedfile.cpp \
+    src/merkle.cpp \
     src/miner.cpp \
     src/init.cpp \
     src/net.cpp \
@@ -441,6 +454,9 @@ SOURCES += src/qt/bitcoin.cpp src/qt/bitcoingui.cpp \
     src/crypto/ripemd160.cpp \
     src/crypto/sha1.cpp \
     src/crypto/sha256.cpp \
+    src/crypto/sha256_avx2.cpp \
+    src/crypto/sha256_shani.cpp \
+    src/crypto/sha256_sse41.cpp \
     src/crypto/sha512.cpp \
     src/qt/masternodemanager.cpp \
     src/qt/addeditadrenalinenode.cpp \
@@ -203,11 +203,11 @@ void CAnonsendPool::ProcessMessageAnonsend(CNode* pfrom, std::string& strCommand
             bool missingTx = false;
 
             CValidationState state;
-            CTransaction tx;
+            CMutableTransaction txNew;
 
             BOOST_FOREACH(const CTxOut o, out){
                 nValueOut += o.nValue;
-                tx.vout.push_back(o);
+                txNew.vout.push_back(o);
 
                 if(o.scriptPubKey.size() != 25){
                     LogPrintf("dsi - non-standard pubkey detected! %s\n", o.scriptPubKey.ToString().c_str());
@@ -224,7 +224,7 @@ void CAnonsendPool::ProcessMessageAnonsend(CNode* pfrom, std::string& strCommand
             }
 
             BOOST_FOREACH(const CTxIn i, in){
-                tx.vin.push_back(i);
+                txNew.vin.push_back(i);
 
                 LogPrint("anonsend", "dsi -- tx in %s\n", i.ToString().c_str());
 
@@ -239,6 +239,8 @@ void CAnonsendPool::ProcessMessageAnonsend(CNode* pfrom, std::string& strCommand
                 }
             }
 
+            const CTransaction tx(txNew);
+
             if (nValueIn > ANONSEND_POOL_MAX) {
                 LogPrintf("dsi -- more than Anonsend pool max! %s\n", tx.ToString().c_str());
                 error = _("Value more than Anonsend pool maximum allows.");
@@ -373,7 +375,7 @@ int randomizeList (int i) { return std::rand()%i;}
 void CAnonsendPool::Reset(){
     cachedLastSuccess = 0;
     lastNewBlock = 0;
-    txCollateral = CTransaction();
+    txCollateral = CMutableTransaction();
     vecMasternodesUsed.clear();
     UnlockCoins();
     SetNull();
@@ -542,7 +544,7 @@ void CAnonsendPool::Check()
         UpdateState(POOL_STATUS_SIGNING);
 
         if (fMasterNode) {
-            CTransaction txNew;
+            CMutableTransaction txNew;
 
             // make our new transaction
             for(unsigned int i = 0; i < entries.size(); i++){
@@ -917,7 +919,7 @@ void CAnonsendPool::CheckForCompleteQueue(){
 
 // check to see if the signature is valid
 bool CAnonsendPool::SignatureValid(const CScript& newSig, const CTxIn& newVin){
-    CTransaction txNew;
+    CMutableTransaction txNew;
     txNew.vin.clear();
     txNew.vout.clear();
 
@@ -944,7 +946,7 @@ bool CAnonsendPool::SignatureValid(const CScript& newSig, const CTxIn& newVin){
         int n = found;
         txNew.vin[n].scriptSig = newSig;
         LogPrint("anonsend", "CAnonsendPool::SignatureValid() - Sign with sig %s\n", newSig.ToString().substr(0,24));
-        if (!VerifyScript(txNew.vin[n].scriptSig, sigPubKey, txNew, n, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, 0)){
+        if (!VerifyScript(txNew.vin[n].scriptSig, sigPubKey, CTransaction(txNew), n, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, 0)){
             LogPrint("anonsend", "CAnonsendPool::SignatureValid() - Signing - Error signing input %u\n", n);
             return false;
         }
@@ -1123,7 +1125,7 @@ void CAnonsendPool::SendAnonsendDenominate(std::vector<CTxIn>& vin, std::vector<
         return;
     }
 
-    if(txCollateral == CTransaction()){
+    if(CTransaction(txCollateral) == CTransaction()){
         LogPrintf ("CAnonsendPool:SendAnonsendDenominate() - Anonsend collateral not set");
         return;
     }
@@ -1167,19 +1169,21 @@ void CAnonsendPool::SendAnonsendDenominate(std::vector<CTxIn>& vin, std::vector<
         int64_t nValueOut = 0;
 
         CValidationState state;
-        CTransaction tx;
+        CMutableTransaction txNew;
 
         BOOST_FOREACH(const CTxOut& o, vout){
             nValueOut += o.nValue;
-            tx.vout.push_back(o);
+            txNew.vout.push_back(o);
         }
 
         BOOST_FOREACH(const CTxIn& i, vin){
-            tx.vin.push_back(i);
+            txNew.vin.push_back(i);
 
             LogPrint("anonsend", "dsi -- tx in %s\n", i.ToString());
         }
 
+        const CTransaction tx(txNew);
+
         LogPrintf("Submitting tx %s\n", tx.ToString());
 
         while(true){
@@ -1515,7 +1519,7 @@ bool CAnonsendPool::DoAutomaticDenominating(bool fDryRun)
 
         //check our collateral
         std::string strReason;
-        if(txCollateral == CTransaction()){
+        if(CTransaction(txCollateral) == CTransaction()){
             if(!pwalletMain->CreateCollateralTransaction(txCollateral, strReason)){
                 LogPrintf("% -- create collateral error:%s\n", __func__, strReason);
                 return false;
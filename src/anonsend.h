@@ -258,7 +258,7 @@ private:
     mutable CCriticalSection cs_anonsend;
 
     std::vector<CAnonSendEntry> entries; // Masternode entries
-    CTransaction finalTransaction; // the finalized transaction ready for signing
+    CMutableTransaction finalTransaction; // the finalized transaction ready for signing
 
     int64_t lastTimeChanged; // last time the 'state' changed, in UTC milliseconds
 
@@ -281,7 +281,7 @@ private:
     int cachedLastSuccess;
 
     int minBlockSpacing; //required blocks between mixes
-    CTransaction txCollateral;
+    CMutableTransaction txCollateral;
 
     int64_t lastNewBlock;
 
@@ -331,7 +331,7 @@ public:
         cachedLastSuccess = 0;
         cachedNumBlocks = std::numeric_limits<int>::max();
         unitTest = false;
-        txCollateral = CTransaction();
+        txCollateral = CMutableTransaction();
         minBlockSpacing = 0;
         lastNewBlock = 0;
 
@@ -0,0 +1,71 @@
+// Copyright (c) 2014-2018 The MarteX developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_ARENA_H
+#define BITCOIN_ARENA_H
+
+#include <new>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+/** Slab allocator for large numbers of long-lived objects of one type.
+ *  Storage is carved out of slabs of nSlabObjects objects, which keeps the
+ *  objects dense in memory and avoids per-object heap overhead. Slabs are
+ *  only returned to the system when the arena is destroyed; freed objects
+ *  are recycled. Not thread safe: callers serialize access.
+ *
+ *  Usage: T* p = new (arena.Allocate()) T(...); ... arena.Free(p);
+ */
+template<typename T, size_t nSlabObjects = 4096>
+class CSlabArena : private boost::noncopyable
+{
+private:
+    std::vector<char*> vSlabs;
+    std::vector<void*> vFree;
+    size_t nSlabUsed;
+
+public:
+    CSlabArena() : nSlabUsed(nSlabObjects) {}
+
+    ~CSlabArena()
+    {
+        // Objects still allocated are not destroyed, only their storage freed
+        for (size_t i = 0; i < vSlabs.size(); i++)
+            ::operator delete(vSlabs[i]);
+    }
+
+    /** Uninitialized storage for one T */
+    void* Allocate()
+    {
+        if (!vFree.empty())
+        {
+            void* p = vFree.back();
+            vFree.pop_back();
+            return p;
+        }
+        if (nSlabUsed == nSlabObjects)
+        {
+            vSlabs.push_back(static_cast<char*>(::operator new(sizeof(T) * nSlabObjects)));
+            nSlabUsed = 0;
+        }
+        return vSlabs.back() + sizeof(T) * nSlabUsed++;
+    }
+
+    /** Destroy an object obtained from this arena and recycle its storage */
+    void Free(T* p)
+    {
+        if (p == NULL)
+            return;
+        p->~T();
+        vFree.push_back(p);
+    }
+
+    /** Number of objects currently allocated */
+    size_t size() const
+    {
+        return vSlabs.empty() ? 0 : (vSlabs.size() - 1) * nSlabObjects + nSlabUsed - vFree.size();
+    }
+};
+
+#endif // BITCOIN_ARENA_H
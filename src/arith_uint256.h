@@ -0,0 +1,257 @@
+// Copyright (c) 2009-2010 Satoshi Nakamoto
+// Copyright (c) 2009-2014 The Bitcoin developers
+// Copyright (c) 2014-2018 The MarteX developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_ARITH_UINT256_H
+#define BITCOIN_ARITH_UINT256_H
+
+#include "uint256.h"
+
+#include <stdexcept>
+#include <stdint.h>
+#include <string.h>
+
+class uint_error : public std::runtime_error {
+public:
+    explicit uint_error(const std::string& str) : std::runtime_error(str) {}
+};
+
+/** Fixed-width unsigned big integer for target and difficulty arithmetic.
+ *  Unlike base_uint in uint256.h, which is a hash container, this type
+ *  multiplies and divides, and converts to and from the compact nBits
+ *  encoding exactly like CBigNum does for non-negative values, without
+ *  OpenSSL or heap allocation.
+ */
+template<unsigned int BITS>
+class arith_base_uint
+{
+protected:
+    enum { WIDTH=BITS/32 };
+    uint32_t pn[WIDTH];
+
+public:
+    arith_base_uint()
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] = 0;
+    }
+
+    arith_base_uint(const arith_base_uint& b)
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] = b.pn[i];
+    }
+
+    arith_base_uint& operator=(const arith_base_uint& b)
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] = b.pn[i];
+        return *this;
+    }
+
+    arith_base_uint(uint64_t b)
+    {
+        pn[0] = (unsigned int)b;
+        pn[1] = (unsigned int)(b >> 32);
+        for (int i = 2; i < WIDTH; i++)
+            pn[i] = 0;
+    }
+
+    bool operator!() const
+    {
+        for (int i = 0; i < WIDTH; i++)
+            if (pn[i] != 0)
+                return false;
+        return true;
+    }
+
+    const arith_base_uint operator~() const
+    {
+        arith_base_uint ret;
+        for (int i = 0; i < WIDTH; i++)
+            ret.pn[i] = ~pn[i];
+        return ret;
+    }
+
+    const arith_base_uint operator-() const
+    {
+        arith_base_uint ret;
+        for (int i = 0; i < WIDTH; i++)
+            ret.pn[i] = ~pn[i];
+        ret++;
+        return ret;
+    }
+
+    double getdouble() const;
+
+    arith_base_uint& operator=(uint64_t b)
+    {
+        pn[0] = (unsigned int)b;
+        pn[1] = (unsigned int)(b >> 32);
+        for (int i = 2; i < WIDTH; i++)
+            pn[i] = 0;
+        return *this;
+    }
+
+    arith_base_uint& operator^=(const arith_base_uint& b)
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] ^= b.pn[i];
+        return *this;
+    }
+
+    arith_base_uint& operator&=(const arith_base_uint& b)
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] &= b.pn[i];
+        return *this;
+    }
+
+    arith_base_uint& operator|=(const arith_base_uint& b)
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] |= b.pn[i];
+        return *this;
+    }
+
+    arith_base_uint& operator<<=(unsigned int shift);
+    arith_base_uint& operator>>=(unsigned int shift);
+
+    arith_base_uint& operator+=(const arith_base_uint& b)
+    {
+        uint64_t carry = 0;
+        for (int i = 0; i < WIDTH; i++)
+        {
+            uint64_t n = carry + pn[i] + b.pn[i];
+            pn[i] = n & 0xffffffff;
+            carry = n >> 32;
+        }
+        return *this;
+    }
+
+    arith_base_uint& operator-=(const arith_base_uint& b)
+    {
+        *this += -b;
+        return *this;
+    }
+
+    arith_base_uint& operator+=(uint64_t b64)
+    {
+        arith_base_uint b;
+        b = b64;
+        *this += b;
+        return *this;
+    }
+
+    arith_base_uint& operator-=(uint64_t b64)
+    {
+        arith_base_uint b;
+        b = b64;
+        *this += -b;
+        return *this;
+    }
+
+    arith_base_uint& operator*=(uint32_t b32);
+    arith_base_uint& operator*=(const arith_base_uint& b);
+    arith_base_uint& operator/=(const arith_base_uint& b);
+
+    arith_base_uint& operator++()
+    {
+        // prefix operator
+        int i = 0;
+        while (++pn[i] == 0 && i < WIDTH-1)
+            i++;
+        return *this;
+    }
+
+    const arith_base_uint operator++(int)
+    {
+        // postfix operator
+        const arith_base_uint ret = *this;
+        ++(*this);
+        return ret;
+    }
+
+    arith_base_uint& operator--()
+    {
+        // prefix operator
+        int i = 0;
+        while (--pn[i] == (uint32_t)-1 && i < WIDTH-1)
+            i++;
+        return *this;
+    }
+
+    const arith_base_uint operator--(int)
+    {
+        // postfix operator
+        const arith_base_uint ret = *this;
+        --(*this);
+        return ret;
+    }
+
+    int CompareTo(const arith_base_uint& b) const;
+    bool EqualTo(uint64_t b) const;
+
+    friend inline const arith_base_uint operator+(const arith_base_uint& a, const arith_base_uint& b) { return arith_base_uint(a) += b; }
+    friend inline const arith_base_uint operator-(const arith_base_uint& a, const arith_base_uint& b) { return arith_base_uint(a) -= b; }
+    friend inline const arith_base_uint operator*(const arith_base_uint& a, const arith_base_uint& b) { return arith_base_uint(a) *= b; }
+    friend inline const arith_base_uint operator/(const arith_base_uint& a, const arith_base_uint& b) { return arith_base_uint(a) /= b; }
+    friend inline const arith_base_uint operator|(const arith_base_uint& a, const arith_base_uint& b) { return arith_base_uint(a) |= b; }
+    friend inline const arith_base_uint operator&(const arith_base_uint& a, const arith_base_uint& b) { return arith_base_uint(a) &= b; }
+    friend inline const arith_base_uint operator^(const arith_base_uint& a, const arith_base_uint& b) { return arith_base_uint(a) ^= b; }
+    friend inline const arith_base_uint operator>>(const arith_base_uint& a, int shift) { return arith_base_uint(a) >>= shift; }
+    friend inline const arith_base_uint operator<<(const arith_base_uint& a, int shift) { return arith_base_uint(a) <<= shift; }
+    friend inline const arith_base_uint operator*(const arith_base_uint& a, uint32_t b) { return arith_base_uint(a) *= b; }
+    friend inline bool operator==(const arith_base_uint& a, const arith_base_uint& b) { return memcmp(a.pn, b.pn, sizeof(a.pn)) == 0; }
+    friend inline bool operator!=(const arith_base_uint& a, const arith_base_uint& b) { return memcmp(a.pn, b.pn, sizeof(a.pn)) != 0; }
+    friend inline bool operator>(const arith_base_uint& a, const arith_base_uint& b) { return a.CompareTo(b) > 0; }
+    friend inline bool operator<(const arith_base_uint& a, const arith_base_uint& b) { return a.CompareTo(b) < 0; }
+    friend inline bool operator>=(const arith_base_uint& a, const arith_base_uint& b) { return a.CompareTo(b) >= 0; }
+    friend inline bool operator<=(const arith_base_uint& a, const arith_base_uint& b) { return a.CompareTo(b) <= 0; }
+    friend inline bool operator==(const arith_base_uint& a, uint64_t b) { return a.EqualTo(b); }
+    friend inline bool operator!=(const arith_base_uint& a, uint64_t b) { return !a.EqualTo(b); }
+
+    std::string GetHex() const;
+    std::string ToString() const;
+
+    /** Number of significant bits: position of the highest set bit plus one */
+    unsigned int bits() const;
+
+    uint64_t GetLow64() const
+    {
+        return pn[0] | (uint64_t)pn[1] << 32;
+    }
+};
+
+/** 256-bit unsigned big integer. */
+class arith_uint256 : public arith_base_uint<256>
+{
+public:
+    arith_uint256() {}
+    arith_uint256(const arith_base_uint<256>& b) : arith_base_uint<256>(b) {}
+    arith_uint256(uint64_t b) : arith_base_uint<256>(b) {}
+
+    /**
+     * The "compact" format is a representation of a whole number N using an
+     * unsigned 32bit number similar to a floating point format. The most
+     * significant 8 bits are the unsigned exponent of base 256, the lower 23
+     * bits are the mantissa and bit 24 (0x00800000) is the sign bit.
+     * N = (-1^sign) * mantissa * 256^(exponent-3)
+     *
+     * This matches CBigNum::SetCompact()/GetCompact(); a negative or
+     * overflowing compact is reported through pfNegative and pfOverflow
+     * because this type cannot represent it.
+     */
+    arith_uint256& SetCompact(uint32_t nCompact, bool* pfNegative = NULL, bool* pfOverflow = NULL);
+    uint32_t GetCompact(bool fNegative = false) const;
+
+    friend uint256 ArithToUint256(const arith_uint256& a);
+    friend arith_uint256 UintToArith256(const uint256& a);
+};
+
+uint256 ArithToUint256(const arith_uint256& a);
+arith_uint256 UintToArith256(const uint256& a);
+
+#endif // BITCOIN_ARITH_UINT256_H
@@ -0,0 +1,195 @@
+// Copyright (c) 2014-2018 The MarteX developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Micro-benchmark: how many FastTx transaction locks per second the vote
+// signatures can be verified for, one vote at a time on the message handler
+// thread versus in batches on a CCheckQueue worker pool.
+//
+// Every lock gets FASTTX_SIGNATURES_TOTAL votes from random masternodes. The
+// votes of all locks arrive interleaved and are verified in batches of the
+// given size, like the votes collected during one message handler pass. A
+// lock is final once the votes are checked again when they are counted,
+// which the verified-vote cache answers without recovering the signatures.
+//
+// Usage: bench_fasttx [locks] [batch size] [masternodes]
+
+#include "checkqueue.h"
+#include "fasttxcheck.h"
+#include "pubkey.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include <secp256k1.h>
+#include <secp256k1_recovery.h>
+
+static const int FASTTX_SIGNATURES_TOTAL = 10;
+
+static double Now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static uint256 RandomHash()
+{
+    uint256 hash;
+    for (unsigned char* p = hash.begin(); p != hash.end(); p++)
+        *p = rand() & 0xff;
+    return hash;
+}
+
+struct Masternode
+{
+    unsigned char vchSecret[32];
+    CPubKey pubkey;
+};
+
+struct Vote
+{
+    uint256 hashMessage;
+    std::vector<unsigned char> vchSig;
+    const Masternode* pmn;
+};
+
+// Compact signature in the format CPubKey::RecoverCompact() reads
+static std::vector<unsigned char> SignCompact(secp256k1_context* ctx, const Masternode& mn, const uint256& hash)
+{
+    secp256k1_ecdsa_recoverable_signature sig;
+    secp256k1_ecdsa_sign_recoverable(ctx, &sig, hash.begin(), mn.vchSecret, NULL, NULL);
+    std::vector<unsigned char> vchSig(65);
+    int recid;
+    secp256k1_ecdsa_recoverable_signature_serialize_compact(ctx, &vchSig[1], &recid, &sig);
+    vchSig[0] = 27 + recid + 4;
+    return vchSig;
+}
+
+// Verify all votes one at a time and count them again when finalizing
+static double RunSerial(const std::vector<Vote>& vVotes, CConsensusVoteCache* pcache)
+{
+    double nStart = Now();
+    size_t nValid = 0;
+    for (size_t i = 0; i < vVotes.size(); i++)
+    {
+        CConsensusVoteCheck check(vVotes[i].hashMessage, vVotes[i].vchSig, vVotes[i].pmn->pubkey, pcache);
+        if (check.Verify())
+            nValid++;
+    }
+    for (size_t i = 0; i < vVotes.size(); i++)
+    {
+        CConsensusVoteCheck check(vVotes[i].hashMessage, vVotes[i].vchSig, vVotes[i].pmn->pubkey, pcache);
+        if (!check.Verify())
+            nValid = 0;
+    }
+    double nTime = Now() - nStart;
+    if (nValid != vVotes.size())
+        printf("ERROR: %u of %u votes valid\n", (unsigned int)nValid, (unsigned int)vVotes.size());
+    return nTime;
+}
+
+// Verify the votes in batches on nThreads threads, then count them again
+static double RunBatched(const std::vector<Vote>& vVotes, size_t nBatch, int nThreads, CConsensusVoteCache* pcache)
+{
+    CCheckQueue<CConsensusVoteCheck> queue(128);
+    boost::thread_group threadGroup;
+    for (int i = 0; i < nThreads - 1; i++)
+        threadGroup.create_thread(boost::bind(&CCheckQueue<CConsensusVoteCheck>::Thread, &queue));
+
+    double nStart = Now();
+    for (size_t i = 0; i < vVotes.size(); i += nBatch)
+    {
+        std::vector<CConsensusVoteCheck> vChecks;
+        for (size_t j = i; j < std::min(i + nBatch, vVotes.size()); j++)
+            vChecks.push_back(CConsensusVoteCheck(vVotes[j].hashMessage, vVotes[j].vchSig, vVotes[j].pmn->pubkey, pcache));
+        CCheckQueueControl<CConsensusVoteCheck> control(&queue);
+        control.Add(vChecks);
+        control.Wait();
+    }
+    size_t nValid = 0;
+    for (size_t i = 0; i < vVotes.size(); i++)
+    {
+        CConsensusVoteCheck check(vVotes[i].hashMessage, vVotes[i].vchSig, vVotes[i].pmn->pubkey, pcache);
+        if (check.Verify())
+            nValid++;
+    }
+    double nTime = Now() - nStart;
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+
+    if (nValid != vVotes.size())
+        printf("ERROR: %u of %u votes valid\n", (unsigned int)nValid, (unsigned int)vVotes.size());
+    return nTime;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t nLocks = argc > 1 ? atoi(argv[1]) : 500;
+    size_t nBatch = argc > 2 ? atoi(argv[2]) : 64;
+    size_t nMasternodes = argc > 3 ? atoi(argv[3]) : 200;
+    if (nLocks == 0 || nBatch == 0 || nMasternodes == 0)
+        return 1;
+
+    ECCVerifyHandle verifyHandle;
+    secp256k1_context* ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN);
+
+    std::vector<Masternode> vMasternodes(nMasternodes);
+    for (size_t i = 0; i < nMasternodes; i++)
+    {
+        Masternode& mn = vMasternodes[i];
+        secp256k1_pubkey pubkey;
+        do {
+            for (int j = 0; j < 32; j++)
+                mn.vchSecret[j] = rand() & 0xff;
+        } while (!secp256k1_ec_pubkey_create(ctx, &pubkey, mn.vchSecret));
+        unsigned char vch[33];
+        size_t nSize = sizeof(vch);
+        secp256k1_ec_pubkey_serialize(ctx, vch, &nSize, &pubkey, SECP256K1_EC_COMPRESSED);
+        mn.pubkey.Set(vch, vch + nSize);
+    }
+
+    // votes of all locks, interleaved as they would arrive
+    std::vector<Vote> vVotes(nLocks * FASTTX_SIGNATURES_TOTAL);
+    for (size_t i = 0; i < nLocks; i++)
+    {
+        uint256 hashMessage = RandomHash();
+        for (int j = 0; j < FASTTX_SIGNATURES_TOTAL; j++)
+        {
+            Vote& vote = vVotes[j * nLocks + i];
+            vote.hashMessage = hashMessage;
+            vote.pmn = &vMasternodes[rand() % nMasternodes];
+            vote.vchSig = SignCompact(ctx, *vote.pmn, hashMessage);
+        }
+    }
+    secp256k1_context_destroy(ctx);
+
+    printf("Finalize %u locks of %d votes, batches of %u votes\n",
+           (unsigned int)nLocks, FASTTX_SIGNATURES_TOTAL, (unsigned int)nBatch);
+
+    double nSerialUncached = RunSerial(vVotes, NULL);
+    printf("%-28s %10.2f ms %10.0f locks/s\n", "serial, no cache", nSerialUncached * 1e3, nLocks / nSerialUncached);
+
+    CConsensusVoteCache cacheSerial;
+    double nSerial = RunSerial(vVotes, &cacheSerial);
+    printf("%-28s %10.2f ms %10.0f locks/s\n", "serial, cache", nSerial * 1e3, nLocks / nSerial);
+
+    int nMaxThreads = std::max(1, (int)boost::thread::hardware_concurrency());
+    for (int nThreads = 1; ; nThreads = std::min(nThreads * 2, nMaxThreads))
+    {
+        CConsensusVoteCache cache;
+        double nTime = RunBatched(vVotes, nBatch, nThreads, &cache);
+        char strName[32];
+        snprintf(strName, sizeof(strName), "batched, cache, %d thread%s", nThreads, nThreads > 1 ? "s" : "");
+        printf("%-28s %10.2f ms %10.0f locks/s  x%.2f\n", strName, nTime * 1e3, nLocks / nTime, nSerialUncached / nTime);
+        if (nThreads == nMaxThreads)
+            break;
+    }
+    return 0;
+}
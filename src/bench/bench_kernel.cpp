@@ -0,0 +1,130 @@
+// Copyright (c) 2014-2018 The MarteX developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Micro-benchmark: stake kernel checks per second, comparing the CBigNum
+// target with a CDataStream serialized kernel against the arith_uint256
+// target with a stack buffer kernel used by CheckStakeKernelHash().
+//
+// Usage: bench_kernel [candidates] [timestamps]
+
+#include "arith_uint256.h"
+#include "bignum.h"
+#include "hash.h"
+#include "serialize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <vector>
+
+struct KernelInput
+{
+    uint256 hashModifier;
+    unsigned int nTimeTxPrev;
+    uint256 hashPrev;
+    unsigned int n;
+    int64_t nValue;
+};
+
+static double Now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void Report(const char* name, size_t nChecks, double nSeconds, double nBaseline)
+{
+    printf("%-24s %10.0f checks/s %8.2f us/check  x%.2f\n", name, nChecks / nSeconds,
+           nSeconds * 1e6 / nChecks, nBaseline > 0 ? nBaseline / nSeconds : 1.0);
+}
+
+static bool CheckBigNum(const KernelInput& in, unsigned int nBits, unsigned int nTimeTx, uint256& hashProof)
+{
+    CBigNum bnTarget;
+    bnTarget.SetCompact(nBits);
+    bnTarget *= CBigNum(in.nValue);
+
+    CDataStream ss(SER_GETHASH, 0);
+    ss << in.hashModifier << in.nTimeTxPrev << in.hashPrev << in.n << nTimeTx;
+    hashProof = Hash(ss.begin(), ss.end());
+
+    return CBigNum(hashProof) <= bnTarget;
+}
+
+static bool CheckArith(const KernelInput& in, unsigned int nBits, unsigned int nTimeTx, uint256& hashProof)
+{
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(nBits);
+    arith_uint256 bnWeight((uint64_t)in.nValue);
+    if (bnTarget.bits() + bnWeight.bits() > 256 && bnTarget > ~arith_uint256(0) / bnWeight)
+        bnTarget = ~arith_uint256(0);
+    else
+        bnTarget *= bnWeight;
+
+    unsigned char pchKernel[76];
+    unsigned char* pch = pchKernel;
+    memcpy(pch, in.hashModifier.begin(), 32); pch += 32;
+    memcpy(pch, &in.nTimeTxPrev, 4); pch += 4;
+    memcpy(pch, in.hashPrev.begin(), 32); pch += 32;
+    memcpy(pch, &in.n, 4); pch += 4;
+    memcpy(pch, &nTimeTx, 4); pch += 4;
+    hashProof = Hash(pchKernel, pch);
+
+    return UintToArith256(hashProof) <= bnTarget;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t nCandidates = argc > 1 ? atoi(argv[1]) : 1000;
+    int nTimestamps = argc > 2 ? atoi(argv[2]) : 60;
+    if (nCandidates == 0 || nTimestamps <= 0)
+        return 1;
+
+    std::vector<KernelInput> vInputs(nCandidates);
+    for (size_t i = 0; i < nCandidates; i++)
+    {
+        KernelInput& in = vInputs[i];
+        for (unsigned char* p = in.hashModifier.begin(); p != in.hashModifier.end(); p++)
+            *p = rand() & 0xff;
+        for (unsigned char* p = in.hashPrev.begin(); p != in.hashPrev.end(); p++)
+            *p = rand() & 0xff;
+        in.nTimeTxPrev = 1500000000 + rand() % 1000000;
+        in.n = rand() % 4;
+        in.nValue = (int64_t)(rand() % 100000 + 1) * 100000000;
+    }
+    // A loose target so both paths see passing kernels to compare
+    unsigned int nBits = 0x1e0fffff;
+    unsigned int nTimeStart = 1510000000;
+    size_t nChecks = nCandidates * nTimestamps;
+
+    printf("Stake kernel checks over %u candidates x %d timestamps\n",
+           (unsigned int)nCandidates, nTimestamps);
+
+    std::vector<uint256> vBigNum(nChecks), vArith(nChecks);
+    size_t nPassBigNum = 0, nPassArith = 0;
+
+    double nStart = Now();
+    for (size_t i = 0; i < nCandidates; i++)
+        for (int n = 0; n < nTimestamps; n++)
+            nPassBigNum += CheckBigNum(vInputs[i], nBits, nTimeStart - n, vBigNum[i * nTimestamps + n]);
+    double nBigNum = Now() - nStart;
+    Report("CBigNum + CDataStream", nChecks, nBigNum, 0);
+
+    nStart = Now();
+    for (size_t i = 0; i < nCandidates; i++)
+        for (int n = 0; n < nTimestamps; n++)
+            nPassArith += CheckArith(vInputs[i], nBits, nTimeStart - n, vArith[i * nTimestamps + n]);
+    Report("arith_uint256 + stack", nChecks, Now() - nStart, nBigNum);
+
+    if (vBigNum != vArith || nPassBigNum != nPassArith)
+    {
+        printf("ERROR: kernel results differ (%u vs %u passing)\n",
+               (unsigned int)nPassBigNum, (unsigned int)nPassArith);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2014-2018 The MarteX developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Micro-benchmark: SHA-256 throughput of every backend this CPU supports,
+// for streaming CSHA256 writes and for the SHA256D64() double hash of
+// 64-byte inputs that merkle tree levels use. Every backend's digests are
+// checked against the generic implementation.
+//
+// Usage: bench_sha256 [megabytes]
+
+#include "crypto/sha256.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <vector>
+
+static double Now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+int main(int argc, char* argv[])
+{
+    int nMegabytes = argc > 1 ? atoi(argv[1]) : 256;
+    if (nMegabytes <= 0)
+        return 1;
+
+    static const size_t CHUNK = 1 << 20;
+    static const size_t D64_INPUTS = 4096;
+    std::vector<unsigned char> vData(CHUNK);
+    for (size_t i = 0; i < vData.size(); i++)
+        vData[i] = rand() & 0xff;
+
+    static const char* const pszImpl[] = {"generic", "sse4.1", "avx2", "shani", "auto"};
+    unsigned char hashGeneric[CSHA256::OUTPUT_SIZE];
+    std::vector<unsigned char> vD64Generic(D64_INPUTS * 32);
+    bool fError = false;
+
+    printf("SHA-256 over %d MB, automatic selection: %s\n", nMegabytes, SHA256Implementation());
+    for (unsigned int n = 0; n < sizeof(pszImpl) / sizeof(pszImpl[0]); n++)
+    {
+        if (!SHA256UseImplementation(pszImpl[n]))
+        {
+            printf("%-12s not supported\n", pszImpl[n]);
+            continue;
+        }
+
+        unsigned char hash[CSHA256::OUTPUT_SIZE];
+        double nStart = Now();
+        CSHA256 sha;
+        for (int i = 0; i < nMegabytes; i++)
+            sha.Write(&vData[0], CHUNK);
+        sha.Finalize(hash);
+        double nStream = Now() - nStart;
+
+        std::vector<unsigned char> vD64(D64_INPUTS * 32);
+        size_t nRounds = (size_t)nMegabytes * CHUNK / (D64_INPUTS * 64);
+        nStart = Now();
+        for (size_t i = 0; i < nRounds; i++)
+            SHA256D64(&vD64[0], &vData[0], D64_INPUTS);
+        double nD64 = Now() - nStart;
+
+        if (n == 0)
+        {
+            memcpy(hashGeneric, hash, sizeof(hash));
+            vD64Generic = vD64;
+        }
+        else if (memcmp(hash, hashGeneric, sizeof(hash)) != 0 || vD64 != vD64Generic)
+        {
+            printf("ERROR: %s digests differ from generic\n", SHA256Implementation());
+            fError = true;
+        }
+        printf("%-12s %8.1f MB/s stream %8.1f MB/s SHA256D64\n", SHA256Implementation(),
+               nMegabytes / nStream, nMegabytes / nD64);
+    }
+    SHA256UseImplementation("auto");
+    return fError ? 1 : 0;
+}
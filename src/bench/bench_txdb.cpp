@@ -0,0 +1,210 @@
+// Copyright (c) 2014-2018 The MarteX developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Micro-benchmark: the CTxDB read/write pattern of connecting one block
+// inside a transaction, comparing reads that scan the whole pending
+// leveldb::WriteBatch with reads served from the CLevelDBBatch index.
+//
+// Each synthetic transaction reads the index entries of its inputs, marks
+// them spent and writes its own entry, all into the pending batch. Half of
+// the inputs spend transactions of the same block, so their reads have to
+// see the uncommitted writes.
+//
+// Usage: bench_txdb [transactions] [inputs per transaction]
+
+#include "leveldbbatch.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <leveldb/db.h>
+#include <leveldb/env.h>
+#include <memenv/memenv.h>
+
+static double Now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static uint256 RandomHash()
+{
+    uint256 hash;
+    for (unsigned char* p = hash.begin(); p != hash.end(); p++)
+        *p = rand() & 0xff;
+    return hash;
+}
+
+static std::string TxKey(const uint256& hash)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << std::make_pair(std::string("tx"), hash);
+    return ssKey.str();
+}
+
+// Stand-in for a serialized CTxIndex: disk position plus one spent marker
+// per output.
+static std::string TxIndexValue(unsigned int nPos, const std::vector<unsigned int>& vSpent)
+{
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    ssValue << nPos << vSpent;
+    return ssValue.str();
+}
+
+// The pending-write lookup CTxDB used before CLevelDBBatch: walk every
+// queued operation and keep the last one for the key.
+class CBatchScanner : public leveldb::WriteBatch::Handler
+{
+public:
+    std::string needle;
+    bool* deleted;
+    std::string* foundValue;
+    bool foundEntry;
+
+    CBatchScanner() : foundEntry(false) {}
+
+    virtual void Put(const leveldb::Slice& key, const leveldb::Slice& value)
+    {
+        if (key.ToString() == needle) {
+            foundEntry = true;
+            *deleted = false;
+            *foundValue = value.ToString();
+        }
+    }
+
+    virtual void Delete(const leveldb::Slice& key)
+    {
+        if (key.ToString() == needle) {
+            foundEntry = true;
+            *deleted = true;
+        }
+    }
+};
+
+struct SyntheticTx
+{
+    uint256 hash;
+    std::vector<uint256> vPrevHash;
+    std::vector<unsigned int> vPrevN;
+};
+
+// Connect the block against db, returning the number of index reads that
+// were found. fIndexed selects the lookup used for pending writes.
+static size_t ConnectBlock(leveldb::DB* db, const std::vector<SyntheticTx>& vtx, bool fIndexed, std::vector<std::string>& vRead)
+{
+    CLevelDBBatch batch;
+    size_t nFound = 0;
+    std::string strValue;
+
+    for (size_t i = 0; i < vtx.size(); i++)
+    {
+        const SyntheticTx& tx = vtx[i];
+        for (size_t j = 0; j < tx.vPrevHash.size(); j++)
+        {
+            std::string strKey = TxKey(tx.vPrevHash[j]);
+            bool fPending, fDeleted = false;
+            if (fIndexed)
+                fPending = batch.Lookup(strKey, &strValue, &fDeleted);
+            else
+            {
+                CBatchScanner scanner;
+                scanner.needle = strKey;
+                scanner.deleted = &fDeleted;
+                scanner.foundValue = &strValue;
+                batch.GetWriteBatch()->Iterate(&scanner);
+                fPending = scanner.foundEntry;
+            }
+            if (fDeleted)
+                continue;
+            if (!fPending && !db->Get(leveldb::ReadOptions(), strKey, &strValue).ok())
+                continue;
+            nFound++;
+            vRead.push_back(strValue);
+
+            // Mark the spent output and queue the updated entry
+            CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
+            unsigned int nPos;
+            std::vector<unsigned int> vSpent;
+            ssValue >> nPos >> vSpent;
+            if (tx.vPrevN[j] < vSpent.size())
+                vSpent[tx.vPrevN[j]] = i + 1;
+            batch.Put(strKey, TxIndexValue(nPos, vSpent));
+        }
+        batch.Put(TxKey(tx.hash), TxIndexValue(i, std::vector<unsigned int>(2, 0)));
+    }
+    return nFound;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t nTx = argc > 1 ? atoi(argv[1]) : 5000;
+    size_t nInputs = argc > 2 ? atoi(argv[2]) : 2;
+    if (nTx == 0 || nInputs == 0)
+        return 1;
+
+    boost::scoped_ptr<leveldb::Env> env(leveldb::NewMemEnv(leveldb::Env::Default()));
+    leveldb::Options options;
+    options.env = env.get();
+    options.create_if_missing = true;
+    leveldb::DB* pdb;
+    if (!leveldb::DB::Open(options, "bench_txdb", &pdb).ok())
+    {
+        printf("ERROR: cannot open in-memory LevelDB\n");
+        return 1;
+    }
+    boost::scoped_ptr<leveldb::DB> db(pdb);
+
+    // Transactions already in the database that the block spends from
+    std::vector<uint256> vOnDisk(nTx * nInputs);
+    for (size_t i = 0; i < vOnDisk.size(); i++)
+    {
+        vOnDisk[i] = RandomHash();
+        db->Put(leveldb::WriteOptions(), TxKey(vOnDisk[i]), TxIndexValue(i, std::vector<unsigned int>(2, 0)));
+    }
+
+    std::vector<SyntheticTx> vtx(nTx);
+    for (size_t i = 0; i < nTx; i++)
+    {
+        SyntheticTx& tx = vtx[i];
+        tx.hash = RandomHash();
+        for (size_t j = 0; j < nInputs; j++)
+        {
+            // Every other input spends an earlier transaction of this block
+            bool fInBlock = i > 0 && (j & 1);
+            tx.vPrevHash.push_back(fInBlock ? vtx[rand() % i].hash : vOnDisk[i * nInputs + j]);
+            tx.vPrevN.push_back(rand() % 2);
+        }
+    }
+
+    printf("Connect %u transactions x %u inputs inside one CTxDB transaction\n",
+           (unsigned int)nTx, (unsigned int)nInputs);
+
+    std::vector<std::string> vScan, vIndexed;
+    double nStart = Now();
+    size_t nFoundScan = ConnectBlock(db.get(), vtx, false, vScan);
+    double nScan = Now() - nStart;
+    printf("%-24s %10.2f ms %8.2f us/read\n", "WriteBatch scan", nScan * 1e3, nScan * 1e6 / (nTx * nInputs));
+
+    nStart = Now();
+    size_t nFoundIndexed = ConnectBlock(db.get(), vtx, true, vIndexed);
+    double nIndexed = Now() - nStart;
+    printf("%-24s %10.2f ms %8.2f us/read  x%.2f\n", "CLevelDBBatch index", nIndexed * 1e3,
+           nIndexed * 1e6 / (nTx * nInputs), nScan / nIndexed);
+
+    if (nFoundScan != nFoundIndexed || vScan != vIndexed)
+    {
+        printf("ERROR: reads differ (%u vs %u found)\n", (unsigned int)nFoundScan, (unsigned int)nFoundIndexed);
+        return 1;
+    }
+    return 0;
+}
@@ -57,16 +57,18 @@ public:
         nRPCPort = 51314;
         bnProofOfWorkLimit = CBigNum(~uint256(0) >> 18);
         bnProofOfStakeLimit = CBigNum(~uint256(0) >> 18);
+        nProofOfWorkTargetLimit = UintToArith256(bnProofOfWorkLimit.getuint256());
+        nProofOfStakeTargetLimit = UintToArith256(bnProofOfStakeLimit.getuint256());
 
         const char* pszTimestamp = "E quando eu pensar em desistir, lembro-me dos motivos que te fizeram aguentar ate agora!";
-        std::vector<CTxIn> vin;
-        vin.resize(1);
-        vin[0].scriptSig = CScript() << 0 << CBigNum(42) << vector<unsigned char>((const unsigned char*)pszTimestamp, (const unsigned char*)pszTimestamp + strlen(pszTimestamp));
-        std::vector<CTxOut> vout;
-        vout.resize(1);
-        vout[0].nValue = nGenesisBlockReward;
-        vout[0].SetEmpty();
-        CTransaction txNew(1, 1498159985, vin, vout, 0);
+        CMutableTransaction txNew;
+        txNew.nVersion = 1;
+        txNew.nTime = 1498159985;
+        txNew.vin.resize(1);
+        txNew.vin[0].scriptSig = CScript() << 0 << CBigNum(42) << vector<unsigned char>((const unsigned char*)pszTimestamp, (const unsigned char*)pszTimestamp + strlen(pszTimestamp));
+        txNew.vout.resize(1);
+        txNew.vout[0].nValue = nGenesisBlockReward;
+        txNew.vout[0].SetEmpty();
         genesis.vtx.push_back(txNew);
         genesis.hashPrevBlock = 0;
         genesis.hashMerkleRoot = genesis.BuildMerkleTree();
@@ -129,6 +131,8 @@ public:
 
         bnProofOfWorkLimit = CBigNum(~uint256(0) >> 16);
         bnProofOfStakeLimit = CBigNum(~uint256(0) >> 16);
+        nProofOfWorkTargetLimit = UintToArith256(bnProofOfWorkLimit.getuint256());
+        nProofOfStakeTargetLimit = UintToArith256(bnProofOfStakeLimit.getuint256());
         vAlertPubKey = ParseHex("04da6ac103778f420a56c8d3b47133ad05872a6eeae68a29e765d4d98b8273361fd0bc7cab6fa28463611b852cfca06afd41e8dab8ce48736763c07d2015736469");
         nDefaultPort = 41315;
         nRPCPort = 41314;
@@ -170,6 +174,7 @@ public:
         pchMessageStart[2] = 0x4d;
         pchMessageStart[3] = 0x3e;
         bnProofOfWorkLimit = CBigNum(~uint256(0) >> 16);
+        nProofOfWorkTargetLimit = UintToArith256(bnProofOfWorkLimit.getuint256());
         genesis.nTime = 1498159985;
         genesis.nBits  = bnProofOfWorkLimit.GetCompact();
         genesis.nNonce = 857701;
@@ -6,6 +6,7 @@
 #ifndef BITCOIN_CHAIN_PARAMS_H
 #define BITCOIN_CHAIN_PARAMS_H
 
+#include "arith_uint256.h"
 #include "bignum.h"
 #include "uint256.h"
 #include "util.h"
@@ -60,6 +61,9 @@ public:
     int GetDefaultPort() const { return nDefaultPort; }
     const CBigNum& ProofOfWorkLimit() const { return bnProofOfWorkLimit; }
     const CBigNum& ProofOfStakeLimit() const { return bnProofOfStakeLimit; }
+    /** The limits above as arith_uint256, for the target checks */
+    const arith_uint256& ProofOfWorkTargetLimit() const { return nProofOfWorkTargetLimit; }
+    const arith_uint256& ProofOfStakeTargetLimit() const { return nProofOfStakeTargetLimit; }
     int SubsidyHalvingInterval() const { return nSubsidyHalvingInterval; }
     virtual const CBlock& GenesisBlock() const = 0;
     virtual bool RequireRPCPassword() const { return true; }
@@ -84,6 +88,8 @@ protected:
     int nRPCPort;
     CBigNum bnProofOfWorkLimit;
     CBigNum bnProofOfStakeLimit;
+    arith_uint256 nProofOfWorkTargetLimit;
+    arith_uint256 nProofOfStakeTargetLimit;
     int nSubsidyHalvingInterval;
     string strDataDir;
     vector<CDNSSeedData> vSeeds;
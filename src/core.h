@@ -47,6 +47,13 @@ public:
 
 };
 
+/** Outpoints are transaction hashes plus an index; the hash is already
+ *  uniformly distributed */
+struct COutPointHasher
+{
+    size_t operator()(const COutPoint& out) const { return out.hash.Get64() ^ out.n; }
+};
+
 /** An inpoint - a combination of a transaction and an index n into its vin */
 class CInPoint
 {
@@ -5,9 +5,16 @@
 #include "crypto/sha256.h"
 
 #include "crypto/common.h"
+#include "crypto/sha256_impl.h"
 
+#include <algorithm>
+#include <assert.h>
 #include <string.h>
 
+#ifdef USE_SHA256_X86
+#include <cpuid.h>
+#endif
+
 // Internal implementation code.
 namespace
 {
@@ -33,18 +40,11 @@ void inline Round(uint32_t a, uint32_t b, uint32_t c, uint32_t& d, uint32_t e, u
 /** Initialize SHA-256 state. */
 void inline Initialize(uint32_t* s)
 {
-    s[0] = 0x6a09e667ul;
-    s[1] = 0xbb67ae85ul;
-    s[2] = 0x3c6ef372ul;
-    s[3] = 0xa54ff53aul;
-    s[4] = 0x510e527ful;
-    s[5] = 0x9b05688cul;
-    s[6] = 0x1f83d9abul;
-    s[7] = 0x5be0cd19ul;
+    memcpy(s, sha256_impl::IV, sizeof(sha256_impl::IV));
 }
 
 /** Perform one SHA-256 transformation, processing a 64-byte chunk. */
-void Transform(uint32_t* s, const unsigned char* chunk)
+void TransformOne(uint32_t* s, const unsigned char* chunk)
 {
     uint32_t a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
     uint32_t w0, w1, w2, w3, w4, w5, w6, w7, w8, w9, w10, w11, w12, w13, w14, w15;
@@ -127,6 +127,167 @@ void Transform(uint32_t* s, const unsigned char* chunk)
     s[7] += h;
 }
 
+/** Perform LANES independent SHA-256 transformations side by side. Each
+ *  lane is a separate dependency chain, so the lanes fill the execution
+ *  units a single transformation leaves idle, and the lane loops are laid
+ *  out for the compiler to vectorize. */
+template<int LANES>
+void TransformLanes(uint32_t s[][8], const unsigned char* const chunk[])
+{
+    uint32_t w[64][LANES];
+    uint32_t a[LANES], b[LANES], c[LANES], d[LANES], e[LANES], f[LANES], g[LANES], h[LANES];
+
+    for (int t = 0; t < 16; t++)
+        for (int l = 0; l < LANES; l++)
+            w[t][l] = ReadBE32(chunk[l] + 4 * t);
+    for (int t = 16; t < 64; t++)
+        for (int l = 0; l < LANES; l++)
+            w[t][l] = sigma1(w[t - 2][l]) + w[t - 7][l] + sigma0(w[t - 15][l]) + w[t - 16][l];
+
+    for (int l = 0; l < LANES; l++) {
+        a[l] = s[l][0]; b[l] = s[l][1]; c[l] = s[l][2]; d[l] = s[l][3];
+        e[l] = s[l][4]; f[l] = s[l][5]; g[l] = s[l][6]; h[l] = s[l][7];
+    }
+    for (int t = 0; t < 64; t++) {
+        for (int l = 0; l < LANES; l++) {
+            uint32_t t1 = h[l] + Sigma1(e[l]) + Ch(e[l], f[l], g[l]) + sha256_impl::K[t] + w[t][l];
+            uint32_t t2 = Sigma0(a[l]) + Maj(a[l], b[l], c[l]);
+            h[l] = g[l];
+            g[l] = f[l];
+            f[l] = e[l];
+            e[l] = d[l] + t1;
+            d[l] = c[l];
+            c[l] = b[l];
+            b[l] = a[l];
+            a[l] = t1 + t2;
+        }
+    }
+    for (int l = 0; l < LANES; l++) {
+        s[l][0] += a[l]; s[l][1] += b[l]; s[l][2] += c[l]; s[l][3] += d[l];
+        s[l][4] += e[l]; s[l][5] += f[l]; s[l][6] += g[l]; s[l][7] += h[l];
+    }
+}
+
+/** Generic transform of blocks consecutive 64-byte chunks. */
+void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks)
+{
+    while (blocks--) {
+        TransformOne(s, chunk);
+        chunk += 64;
+    }
+}
+
+typedef void (*TransformFn)(uint32_t* s, const unsigned char* chunk, size_t blocks);
+typedef void (*TransformD64Fn)(unsigned char* out, const unsigned char* in);
+
+/** Double SHA-256 of one 64-byte input on top of a single message transform. */
+template<TransformFn tr>
+void TransformD64(unsigned char* out, const unsigned char* in)
+{
+    // Padding of a 64-byte message, and of the 32-byte inner digest
+    static const unsigned char padding1[64] = {0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x02, 0};
+    unsigned char buffer2[64] = {0};
+    buffer2[32] = 0x80;
+    buffer2[62] = 0x01;
+
+    uint32_t s[8];
+    Initialize(s);
+    tr(s, in, 1);
+    tr(s, padding1, 1);
+    for (int i = 0; i < 8; i++)
+        WriteBE32(buffer2 + 4 * i, s[i]);
+    Initialize(s);
+    tr(s, buffer2, 1);
+    for (int i = 0; i < 8; i++)
+        WriteBE32(out + 4 * i, s[i]);
+}
+
+#ifdef USE_SHA256_X86
+bool HaveSSE41()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return false;
+    return ecx & (1 << 19);
+}
+
+bool HaveAVX2()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return false;
+    // AVX (bit 28) and OSXSAVE (bit 27), and the OS must save the YMM registers
+    if (!(ecx & (1 << 27)) || !(ecx & (1 << 28)))
+        return false;
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    if ((a & 6) != 6)
+        return false;
+    if (__get_cpuid_max(0, NULL) < 7)
+        return false;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return ebx & (1 << 5);
+}
+
+bool HaveSHANI()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (!HaveSSE41() || __get_cpuid_max(0, NULL) < 7)
+        return false;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return ebx & (1 << 29);
+}
+#endif
+
+/** The implementations CSHA256 and SHA256D64() use, chosen at startup from
+ *  what the CPU supports. */
+struct Backend
+{
+    TransformFn transform;
+    TransformD64Fn transformD64;
+    TransformD64Fn transformD64_4way;
+    TransformD64Fn transformD64_8way;
+    const char* name;
+
+    Backend() { Select("auto"); }
+
+    bool Select(const std::string& strName)
+    {
+        bool fAuto = strName == "auto";
+        transform = Transform;
+        transformD64 = TransformD64<Transform>;
+        transformD64_4way = NULL;
+        transformD64_8way = NULL;
+        name = "generic";
+        if (strName == "generic")
+            return true;
+#ifdef USE_SHA256_X86
+        if ((fAuto || strName == "shani") && HaveSHANI()) {
+            transform = sha256_shani::Transform;
+            transformD64 = TransformD64<sha256_shani::Transform>;
+            name = "shani";
+        } else if ((fAuto || strName == "sse4.1") && HaveSSE41()) {
+            // SHA-NI hashes one message faster than SSE4.1 hashes four
+            transformD64_4way = sha256d64_sse41::Transform_4way;
+            name = "sse4.1";
+        }
+        if ((fAuto || strName == "avx2") && HaveAVX2()) {
+            transformD64_8way = sha256d64_avx2::Transform_8way;
+            name = transform == Transform ? (transformD64_4way ? "sse4.1+avx2" : "avx2") : "shani+avx2";
+        }
+#endif
+        return fAuto || strcmp(name, "generic") != 0;
+    }
+};
+
+Backend& GetBackend()
+{
+    static Backend backend;
+    return backend;
+}
+
 } // namespace sha256
 } // namespace
 
@@ -147,14 +308,15 @@ CSHA256& CSHA256::Write(const unsigned char* data, size_t len)
         memcpy(buf + bufsize, data, 64 - bufsize);
         bytes += 64 - bufsize;
         data += 64 - bufsize;
-        sha256::Transform(s, buf);
+        sha256::GetBackend().transform(s, buf, 1);
         bufsize = 0;
     }
-    while (end >= data + 64) {
+    if (end - data >= 64) {
         // Process full chunks directly from the source.
-        sha256::Transform(s, data);
-        bytes += 64;
-        data += 64;
+        size_t blocks = (end - data) / 64;
+        sha256::GetBackend().transform(s, data, blocks);
+        data += 64 * blocks;
+        bytes += 64 * blocks;
     }
     if (end > data) {
         // Fill the buffer with what remains.
@@ -187,3 +349,89 @@ CSHA256& CSHA256::Reset()
     sha256::Initialize(s);
     return *this;
 }
+
+bool CSHA256::Midstate(uint32_t sOut[8]) const
+{
+    if (bytes % 64 != 0)
+        return false;
+    memcpy(sOut, s, sizeof(s));
+    return true;
+}
+
+void SHA256DTailLanes(const uint32_t midstate[8], const unsigned char* pTails, size_t nTailSize, size_t nLanes, unsigned char* pHashes)
+{
+    static const int LANES = SHA256_LANES;
+    static const unsigned char pad[64] = {0x80};
+    assert(nTailSize <= 55);
+
+    uint32_t s[LANES][8];
+    unsigned char blocks[LANES][64];
+    const unsigned char* chunks[LANES];
+    for (int l = 0; l < LANES; l++)
+        chunks[l] = blocks[l];
+
+    for (size_t nDone = 0; nDone < nLanes; nDone += LANES) {
+        int nBatch = (int)std::min(nLanes - nDone, (size_t)LANES);
+
+        // Last block of the inner hash: tail, padding, length of prefix + tail
+        for (int l = 0; l < LANES; l++) {
+            const unsigned char* pTail = pTails + (nDone + std::min(l, nBatch - 1)) * nTailSize;
+            memcpy(blocks[l], pTail, nTailSize);
+            memcpy(blocks[l] + nTailSize, pad, 56 - nTailSize);
+            WriteBE64(blocks[l] + 56, (64 + nTailSize) << 3);
+            memcpy(s[l], midstate, sizeof(s[l]));
+        }
+        sha256::TransformLanes<LANES>(s, chunks);
+
+        // Outer hash of the 32 byte digest, a single padded block
+        for (int l = 0; l < LANES; l++) {
+            for (int i = 0; i < 8; i++)
+                WriteBE32(blocks[l] + 4 * i, s[l][i]);
+            memcpy(blocks[l] + 32, pad, 24);
+            WriteBE64(blocks[l] + 56, 32 << 3);
+            sha256::Initialize(s[l]);
+        }
+        sha256::TransformLanes<LANES>(s, chunks);
+
+        for (int l = 0; l < nBatch; l++)
+            for (int i = 0; i < 8; i++)
+                WriteBE32(pHashes + (nDone + l) * 32 + 4 * i, s[l][i]);
+    }
+}
+
+void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks)
+{
+    const sha256::Backend& backend = sha256::GetBackend();
+    if (backend.transformD64_8way) {
+        while (blocks >= 8) {
+            backend.transformD64_8way(out, in);
+            out += 256;
+            in += 512;
+            blocks -= 8;
+        }
+    }
+    if (backend.transformD64_4way) {
+        while (blocks >= 4) {
+            backend.transformD64_4way(out, in);
+            out += 128;
+            in += 256;
+            blocks -= 4;
+        }
+    }
+    while (blocks) {
+        backend.transformD64(out, in);
+        out += 32;
+        in += 64;
+        blocks--;
+    }
+}
+
+const char* SHA256Implementation()
+{
+    return sha256::GetBackend().name;
+}
+
+bool SHA256UseImplementation(const std::string& strName)
+{
+    return sha256::GetBackend().Select(strName);
+}
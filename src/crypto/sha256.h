@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string>
 
 /** A hasher class for SHA-256. */
 class CSHA256
@@ -23,6 +24,32 @@ public:
     CSHA256& Write(const unsigned char* data, size_t len);
     void Finalize(unsigned char hash[OUTPUT_SIZE]);
     CSHA256& Reset();
+    /** Copy out the internal state; only meaningful, and only succeeds,
+        after a multiple of 64 bytes has been written. */
+    bool Midstate(uint32_t sOut[8]) const;
 };
 
+/** Number of messages SHA256DTailLanes() hashes side by side. */
+static const int SHA256_LANES = 4;
+
+/** Double SHA-256 of nLanes messages that share the same first 64 bytes.
+ *  midstate is the state after that shared block (CSHA256::Midstate()),
+ *  pTails holds each message's remaining nTailSize <= 55 bytes back to back,
+ *  and the 32 byte hashes are written to pHashes in the same order. */
+void SHA256DTailLanes(const uint32_t midstate[8], const unsigned char* pTails, size_t nTailSize, size_t nLanes, unsigned char* pHashes);
+
+/** Double SHA-256 of blocks independent 64-byte inputs at in, written as
+ *  blocks 32-byte digests to out. This is the shape of every merkle tree
+ *  level, and uses the widest multi-message backend the CPU supports. */
+void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks);
+
+/** Name of the SHA-256 implementation chosen for this CPU. */
+const char* SHA256Implementation();
+
+/** Force an implementation ("generic", "sse4.1", "avx2", "shani") or go back
+ *  to automatic selection ("auto"). Returns false if the CPU lacks it, in
+ *  which case the generic code is used. For benchmarks and tests only: not
+ *  thread safe against concurrent hashing. */
+bool SHA256UseImplementation(const std::string& strName);
+
 #endif // BITCOIN_CRYPTO_SHA256_H
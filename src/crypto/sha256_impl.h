@@ -0,0 +1,74 @@
+// Copyright (c) 2014-2018 The MarteX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_SHA256_IMPL_H
+#define BITCOIN_CRYPTO_SHA256_IMPL_H
+
+// Internal to the SHA-256 implementation: constants shared by the generic
+// code in sha256.cpp and the x86 backends, and the backend entry points the
+// runtime dispatch in sha256.cpp chooses from. Not for use outside crypto/.
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define USE_SHA256_X86 1
+#endif
+
+namespace sha256_impl
+{
+/** SHA-256 round constants. */
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+/** SHA-256 initial state. */
+static const uint32_t IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+/** K[t] + W[t] for the padding block that follows a 64-byte message. That
+ *  block is the same for every such message, so its schedule is folded in
+ *  ahead of time by the SHA256D64() implementations. */
+static const uint32_t PADDING_KW64[64] = {
+    0xc28a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf374,
+    0x649b69c1, 0xf0fe4786, 0x0fe1edc6, 0x240cf254, 0x4fe9346f, 0x6cc984be, 0x61b9411e, 0x16f988fa,
+    0xf2c65152, 0xa88e5a6d, 0xb019fc65, 0xb9d99ec7, 0x9a1231c3, 0xe70eeaa0, 0xfdb1232b, 0xc7353eb0,
+    0x3069bad5, 0xcb976d5f, 0x5a0f118f, 0xdc1eeefd, 0x0a35b689, 0xde0b7a04, 0x58f4ca9d, 0xe15d5b16,
+    0x007f3e86, 0x37088980, 0xa507ea32, 0x6fab9537, 0x17406110, 0x0d8cd6f1, 0xcdaa3b6d, 0xc0bbbe37,
+    0x83613bda, 0xdb48a363, 0x0b02e931, 0x6fd15ca7, 0x521afaca, 0x31338431, 0x6ed41a95, 0x6d437890,
+    0xc39c91f2, 0x9eccabbd, 0xb5c9a0e6, 0x532fb63c, 0xd2c741c6, 0x07237ea3, 0xa4954b68, 0x4c191d76};
+} // namespace sha256_impl
+
+#ifdef USE_SHA256_X86
+/// SHA-NI (Intel SHA extensions) transform, one message at a time.
+namespace sha256_shani
+{
+/** Process blocks consecutive 64-byte chunks into state s. */
+void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
+} // namespace sha256_shani
+
+/// SSE4.1 double SHA-256 of four 64-byte inputs side by side.
+namespace sha256d64_sse41
+{
+/** Hash the 4 inputs at in (64 bytes each) into 4 digests at out (32 bytes each). */
+void Transform_4way(unsigned char* out, const unsigned char* in);
+} // namespace sha256d64_sse41
+
+/// AVX2 double SHA-256 of eight 64-byte inputs side by side.
+namespace sha256d64_avx2
+{
+/** Hash the 8 inputs at in (64 bytes each) into 8 digests at out (32 bytes each). */
+void Transform_8way(unsigned char* out, const unsigned char* in);
+} // namespace sha256d64_avx2
+#endif // USE_SHA256_X86
+
+#endif // BITCOIN_CRYPTO_SHA256_IMPL_H
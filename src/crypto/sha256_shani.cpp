@@ -0,0 +1,88 @@
+// Copyright (c) 2014-2018 The MarteX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// SHA-256 transform using the Intel SHA extensions (SHA-NI).
+
+#include "crypto/sha256_impl.h"
+
+#ifdef USE_SHA256_X86
+
+#include <immintrin.h>
+
+#define SHA256_SHANI __attribute__((target("sse4.1,sha")))
+
+namespace sha256_shani
+{
+namespace
+{
+/** Four rounds on the state halves s0 (ABEF) and s1 (CDGH), with message
+ *  words m and round constants K[t..t+3]. */
+SHA256_SHANI inline void QuadRound(__m128i& s0, __m128i& s1, __m128i m, int t)
+{
+    const __m128i msg = _mm_add_epi32(m, _mm_loadu_si128((const __m128i*)&sha256_impl::K[t]));
+    s1 = _mm_sha256rnds2_epu32(s1, s0, msg);
+    s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(msg, 0x0e));
+}
+
+/** Message schedule: m0 becomes the next four words from m0..m3. */
+SHA256_SHANI inline void Schedule(__m128i& m0, __m128i m1, __m128i m2, __m128i m3)
+{
+    m0 = _mm_sha256msg1_epu32(m0, m1);
+    m0 = _mm_add_epi32(m0, _mm_alignr_epi8(m3, m2, 4));
+    m0 = _mm_sha256msg2_epu32(m0, m3);
+}
+
+/** Load four big endian words. */
+SHA256_SHANI inline __m128i Load(const unsigned char* in)
+{
+    const __m128i mask = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)in), mask);
+}
+} // namespace
+
+SHA256_SHANI void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks)
+{
+    // Rearrange the state from ABCD EFGH into the ABEF CDGH layout the
+    // rounds instruction works on
+    __m128i t0 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)s), 0xb1);       // CDAB
+    __m128i t1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(s + 4)), 0x1b); // EFGH
+    __m128i s0 = _mm_alignr_epi8(t0, t1, 8);     // ABEF
+    __m128i s1 = _mm_blend_epi16(t1, t0, 0xf0);  // CDGH
+
+    while (blocks--) {
+        const __m128i so0 = s0, so1 = s1;
+        __m128i m0 = Load(chunk);
+        __m128i m1 = Load(chunk + 16);
+        __m128i m2 = Load(chunk + 32);
+        __m128i m3 = Load(chunk + 48);
+
+        QuadRound(s0, s1, m0, 0);
+        QuadRound(s0, s1, m1, 4);
+        QuadRound(s0, s1, m2, 8);
+        QuadRound(s0, s1, m3, 12);
+        for (int t = 16; t < 64; t += 16) {
+            Schedule(m0, m1, m2, m3);
+            QuadRound(s0, s1, m0, t);
+            Schedule(m1, m2, m3, m0);
+            QuadRound(s0, s1, m1, t + 4);
+            Schedule(m2, m3, m0, m1);
+            QuadRound(s0, s1, m2, t + 8);
+            Schedule(m3, m0, m1, m2);
+            QuadRound(s0, s1, m3, t + 12);
+        }
+
+        s0 = _mm_add_epi32(s0, so0);
+        s1 = _mm_add_epi32(s1, so1);
+        chunk += 64;
+    }
+
+    // Back to ABCD EFGH
+    t0 = _mm_shuffle_epi32(s0, 0x1b);            // FEBA
+    t1 = _mm_shuffle_epi32(s1, 0xb1);            // DCHG
+    _mm_storeu_si128((__m128i*)s, _mm_blend_epi16(t0, t1, 0xf0));      // DCBA
+    _mm_storeu_si128((__m128i*)(s + 4), _mm_alignr_epi8(t1, t0, 8));   // HGFE
+}
+} // namespace sha256_shani
+
+#endif // USE_SHA256_X86
@@ -0,0 +1,120 @@
+// Copyright (c) 2014-2018 The MarteX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// 4-way double SHA-256 of 64-byte inputs using SSE4.1.
+
+#include "crypto/sha256_impl.h"
+
+#include "crypto/common.h"
+
+#ifdef USE_SHA256_X86
+
+#include <immintrin.h>
+
+#define SHA256_SSE41 __attribute__((target("sse4.1")))
+
+namespace sha256d64_sse41
+{
+namespace
+{
+typedef __m128i vec;
+static const int LANES = 4;
+
+SHA256_SSE41 inline vec K(uint32_t x) { return _mm_set1_epi32(x); }
+SHA256_SSE41 inline vec Add(vec x, vec y) { return _mm_add_epi32(x, y); }
+SHA256_SSE41 inline vec Add(vec x, vec y, vec z) { return Add(Add(x, y), z); }
+SHA256_SSE41 inline vec Add(vec x, vec y, vec z, vec w) { return Add(Add(x, y), Add(z, w)); }
+SHA256_SSE41 inline vec Xor(vec x, vec y) { return _mm_xor_si128(x, y); }
+SHA256_SSE41 inline vec Xor(vec x, vec y, vec z) { return Xor(Xor(x, y), z); }
+SHA256_SSE41 inline vec Or(vec x, vec y) { return _mm_or_si128(x, y); }
+SHA256_SSE41 inline vec And(vec x, vec y) { return _mm_and_si128(x, y); }
+SHA256_SSE41 inline vec ShR(vec x, int n) { return _mm_srli_epi32(x, n); }
+SHA256_SSE41 inline vec ShL(vec x, int n) { return _mm_slli_epi32(x, n); }
+SHA256_SSE41 inline vec Rot(vec x, int n) { return Or(ShR(x, n), ShL(x, 32 - n)); }
+
+SHA256_SSE41 inline vec Ch(vec x, vec y, vec z) { return Xor(z, And(x, Xor(y, z))); }
+SHA256_SSE41 inline vec Maj(vec x, vec y, vec z) { return Or(And(x, y), And(z, Or(x, y))); }
+SHA256_SSE41 inline vec Sigma0(vec x) { return Xor(Rot(x, 2), Rot(x, 13), Rot(x, 22)); }
+SHA256_SSE41 inline vec Sigma1(vec x) { return Xor(Rot(x, 6), Rot(x, 11), Rot(x, 25)); }
+SHA256_SSE41 inline vec sigma0(vec x) { return Xor(Rot(x, 7), Rot(x, 18), ShR(x, 3)); }
+SHA256_SSE41 inline vec sigma1(vec x) { return Xor(Rot(x, 17), Rot(x, 19), ShR(x, 10)); }
+
+/** Load the big endian word at offset of each lane's 64-byte input. */
+SHA256_SSE41 inline vec Read(const unsigned char* in, int offset)
+{
+    return _mm_set_epi32(ReadBE32(in + 192 + offset), ReadBE32(in + 128 + offset),
+                         ReadBE32(in + 64 + offset), ReadBE32(in + offset));
+}
+
+/** Store each lane's word as big endian at offset of its 32-byte output. */
+SHA256_SSE41 inline void Write(unsigned char* out, int offset, vec v)
+{
+    uint32_t tmp[LANES];
+    _mm_storeu_si128((vec*)tmp, v);
+    for (int l = 0; l < LANES; l++)
+        WriteBE32(out + 32 * l + offset, tmp[l]);
+}
+
+/** 64 rounds on state s, with the message schedule expanded from w in place.
+ *  kw, if given, holds precomputed K[t] + W[t] for a message that is the same
+ *  in every lane, and w is then unused. */
+SHA256_SSE41 void Compress(vec* s, vec* w, const uint32_t* kw)
+{
+    vec a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int t = 0; t < 64; t++) {
+        vec x;
+        if (kw) {
+            x = K(kw[t]);
+        } else {
+            if (t >= 16)
+                w[t & 15] = Add(sigma1(w[(t - 2) & 15]), w[(t - 7) & 15], sigma0(w[(t - 15) & 15]), w[t & 15]);
+            x = Add(K(sha256_impl::K[t]), w[t & 15]);
+        }
+        vec t1 = Add(h, Sigma1(e), Ch(e, f, g), x);
+        vec t2 = Add(Sigma0(a), Maj(a, b, c));
+        h = g;
+        g = f;
+        f = e;
+        e = Add(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = Add(t1, t2);
+    }
+    s[0] = Add(s[0], a); s[1] = Add(s[1], b); s[2] = Add(s[2], c); s[3] = Add(s[3], d);
+    s[4] = Add(s[4], e); s[5] = Add(s[5], f); s[6] = Add(s[6], g); s[7] = Add(s[7], h);
+}
+} // namespace
+
+SHA256_SSE41 void Transform_4way(unsigned char* out, const unsigned char* in)
+{
+    vec s[8], w[16];
+
+    // First block: the 64-byte inputs
+    for (int i = 0; i < 8; i++)
+        s[i] = K(sha256_impl::IV[i]);
+    for (int i = 0; i < 16; i++)
+        w[i] = Read(in, 4 * i);
+    Compress(s, w, NULL);
+
+    // Second block: padding of a 64-byte message, the same for every lane
+    Compress(s, w, sha256_impl::PADDING_KW64);
+
+    // Outer hash of the 32-byte digests
+    for (int i = 0; i < 8; i++)
+        w[i] = s[i];
+    w[8] = K(0x80000000);
+    for (int i = 9; i < 15; i++)
+        w[i] = K(0);
+    w[15] = K(256);
+    for (int i = 0; i < 8; i++)
+        s[i] = K(sha256_impl::IV[i]);
+    Compress(s, w, NULL);
+
+    for (int i = 0; i < 8; i++)
+        Write(out, 4 * i, s[i]);
+}
+} // namespace sha256d64_sse41
+
+#endif // USE_SHA256_X86
@@ -12,18 +12,38 @@
 #include "anonsend.h"
 #include "spork.h"
 #include "txdb.h"
+#include "checkqueue.h"
 #include <boost/lexical_cast.hpp>
 
 using namespace std;
 using namespace boost;
 
-std::map<uint256, CTransaction> mapTxLockReq;
-std::map<uint256, CTransaction> mapTxLockReqRejected;
-std::map<uint256, CConsensusVote> mapTxLockVote;
-std::map<uint256, CTransactionLock> mapTxLocks;
-std::map<COutPoint, uint256> mapLockedInputs;
-std::map<uint256, int64_t> mapUnknownVotes; //track votes with no tx for DOS
+TxLockReqMap mapTxLockReq;
+TxLockReqMap mapTxLockReqRejected;
+TxLockVoteMap mapTxLockVote;
+TxLockMap mapTxLocks;
+LockedInputMap mapLockedInputs;
+boost::unordered_map<uint256, int64_t, BlockHasher> mapUnknownVotes; //track votes with no tx for DOS
+static int64_t nUnknownVotesTotal = 0; // sum of mapUnknownVotes, for GetAverageVoteTime()
 int nCompleteTXLocks;
+CConsensusVoteCache consensusVoteCache;
+CFastTxStats fastTxStats;
+
+// Expiry indexes of the stores above. A lock is due once its nExpiration
+// passed; requests and votes are due FASTTX_LOCK_EXPIRATION_SECONDS after
+// they arrived, but live on while their lock does.
+static CTimingWheel<uint256> wheelTxLocks(FASTTX_EXPIRY_WHEEL_SLOTS, FASTTX_EXPIRY_WHEEL_RESOLUTION, GetTime());
+static CTimingWheel<uint256> wheelTxLockReqs(FASTTX_EXPIRY_WHEEL_SLOTS, FASTTX_EXPIRY_WHEEL_RESOLUTION, GetTime());
+static CTimingWheel<uint256> wheelTxLockVotes(FASTTX_EXPIRY_WHEEL_SLOTS, FASTTX_EXPIRY_WHEEL_RESOLUTION, GetTime());
+
+// votes received during the current message handler pass. The nodes are
+// referenced by ThreadMessageHandler until the end of the pass, which is when
+// ProcessQueuedConsensusVotes() runs.
+static std::vector<std::pair<CNode*, CConsensusVote> > vecQueuedVotes;
+static CCheckQueue<CConsensusVoteCheck> votecheckqueue(128);
+
+static void ProcessReceivedConsensusVote(CNode* pfrom, CConsensusVote& ctx);
+static void SetUnknownVoteTime(const uint256& hash, int64_t nTime);
 
 //txlock - Locks transaction
 //
@@ -40,7 +60,6 @@ void ProcessMessageFastTx(CNode* pfrom, std::string& strCommand, CDataStream& vR
     if (strCommand == "txlreq")
     {
         //LogPrintf("ProcessMessageFastTx::txlreq\n");
-        CDataStream vMsg(vRecv);
         CTransaction tx;
         vRecv >> tx;
 
@@ -81,7 +100,7 @@ void ProcessMessageFastTx(CNode* pfrom, std::string& strCommand, CDataStream& vR
 
             DoConsensusVote(tx, nBlockHeight);
 
-            mapTxLockReq.insert(make_pair(tx.GetHash(), tx));
+            AddTransactionLockReq(tx, true);
 
             LogPrintf("ProcessMessageFastTx::txlreq - Transaction Lock Request: %s %s : accepted %s\n",
                 pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
@@ -91,7 +110,7 @@ void ProcessMessageFastTx(CNode* pfrom, std::string& strCommand, CDataStream& vR
             return;
 
         } else {
-            mapTxLockReqRejected.insert(make_pair(tx.GetHash(), tx));
+            AddTransactionLockReq(tx, false);
 
             // can we get the conflicting transaction as proof?
 
@@ -107,7 +126,7 @@ void ProcessMessageFastTx(CNode* pfrom, std::string& strCommand, CDataStream& vR
             }
 
             // resolve conflicts
-            std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(tx.GetHash());
+            TxLockMap::iterator i = mapTxLocks.find(tx.GetHash());
             if (i != mapTxLocks.end()){
                 //we only care if we have a complete tx lock
                 if((*i).second.CountSignatures() >= FASTTX_SIGNATURES_REQUIRED){
@@ -136,37 +155,85 @@ void ProcessMessageFastTx(CNode* pfrom, std::string& strCommand, CDataStream& vR
             return;
         }
 
-        mapTxLockVote.insert(make_pair(ctx.GetHash(), ctx));
-
-        if(ProcessConsensusVote(pfrom, ctx)){
-            //Spam/Dos protection
-            /*
-                Masternodes will sometimes propagate votes before the transaction is known to the client.
-                This tracks those messages and allows it at the same rate of the rest of the network, if
-                a peer violates it, it will simply be ignored
-            */
-            if(!mapTxLockReq.count(ctx.txHash) && !mapTxLockReqRejected.count(ctx.txHash)){
-                if(!mapUnknownVotes.count(ctx.vinMasternode.prevout.hash)){
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime()+(60*10);
-                }
+        AddTransactionLockVote(ctx);
 
-                if(mapUnknownVotes[ctx.vinMasternode.prevout.hash] > GetTime() &&
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] - GetAverageVoteTime() > 60*10){
-                        LogPrintf("ProcessMessageFastTx::txlreq - masternode is spamming transaction votes: %s %s\n",
-                            ctx.vinMasternode.ToString().c_str(),
-                            ctx.txHash.ToString().c_str()
-                        );
-                        return;
-                } else {
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime()+(60*10);
-                }
+        vecQueuedVotes.push_back(make_pair(pfrom, ctx));
+
+        return;
+    }
+}
+
+void ThreadConsensusVoteCheck()
+{
+    RenameThread("martex-votecheck");
+    votecheckqueue.Thread();
+}
+
+void ProcessQueuedConsensusVotes()
+{
+    if(vecQueuedVotes.empty()) return;
+
+    std::vector<std::pair<CNode*, CConsensusVote> > vecVotes;
+    vecVotes.swap(vecQueuedVotes);
+
+    if(nScriptCheckThreads)
+    {
+        // recover the signatures of the votes that will be checked in parallel,
+        // ProcessConsensusVote() then finds them in consensusVoteCache
+        std::vector<CConsensusVoteCheck> vChecks;
+        vChecks.reserve(vecVotes.size());
+        for(unsigned int i = 0; i < vecVotes.size(); i++)
+        {
+            const CConsensusVote& ctx = vecVotes[i].second;
+            int n = mnodeman.GetMasternodeRank(ctx.vinMasternode, ctx.nBlockHeight, MIN_FASTTX_PROTO_VERSION);
+            if(n == -1 || n > FASTTX_SIGNATURES_TOTAL) continue;
+
+            CMasternode* pmn = mnodeman.Find(ctx.vinMasternode);
+            if(pmn == NULL) continue;
+
+            vChecks.push_back(CConsensusVoteCheck(ctx.GetSignatureHash(), ctx.vchMasterNodeSignature, pmn->pubkey2, &consensusVoteCache));
+        }
+
+        CCheckQueueControl<CConsensusVoteCheck> control(&votecheckqueue);
+        control.Add(vChecks);
+        control.Wait();
+    }
+
+    for(unsigned int i = 0; i < vecVotes.size(); i++)
+        ProcessReceivedConsensusVote(vecVotes[i].first, vecVotes[i].second);
+}
+
+static void ProcessReceivedConsensusVote(CNode* pfrom, CConsensusVote& ctx)
+{
+    CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
+
+    if(ProcessConsensusVote(pfrom, ctx)){
+        //Spam/Dos protection
+        /*
+            Masternodes will sometimes propagate votes before the transaction is known to the client.
+            This tracks those messages and allows it at the same rate of the rest of the network, if
+            a peer violates it, it will simply be ignored
+        */
+        if(!mapTxLockReq.count(ctx.txHash) && !mapTxLockReqRejected.count(ctx.txHash)){
+            if(!mapUnknownVotes.count(ctx.vinMasternode.prevout.hash)){
+                SetUnknownVoteTime(ctx.vinMasternode.prevout.hash, GetTime()+(60*10));
             }
 
-            RelayInventory(inv);
+            if(mapUnknownVotes[ctx.vinMasternode.prevout.hash] > GetTime() &&
+                mapUnknownVotes[ctx.vinMasternode.prevout.hash] - GetAverageVoteTime() > 60*10){
+                    LogPrintf("ProcessMessageFastTx::txlreq - masternode is spamming transaction votes: %s %s\n",
+                        ctx.vinMasternode.ToString().c_str(),
+                        ctx.txHash.ToString().c_str()
+                    );
+                    return;
+            } else {
+                SetUnknownVoteTime(ctx.vinMasternode.prevout.hash, GetTime()+(60*10));
+            }
         }
 
-        return;
+        RelayInventory(inv);
     }
+
 }
 
 bool IsIXTXValid(const CTransaction& txCollateral){
@@ -215,6 +282,24 @@ bool IsIXTXValid(const CTransaction& txCollateral){
     return true;
 }
 
+// Schedule the lock to be removed once nExpirationIn passed
+static void SetLockExpiration(CTransactionLock& lock, int nExpirationIn)
+{
+    lock.nExpiration = nExpirationIn;
+    wheelTxLocks.Insert(lock.txHash, (int64_t)nExpirationIn + 1);
+}
+
+// Record how long the lock took to complete, the first time it counts enough votes
+static void UpdateLockLatency(CTransactionLock& lock)
+{
+    if(lock.nTimeComplete != 0 || lock.CountSignatures() < FASTTX_SIGNATURES_REQUIRED) return;
+
+    lock.nTimeComplete = GetTimeMillis();
+    fastTxStats.nLocksCompleted++;
+    if(lock.nTimeRequest != 0)
+        fastTxStats.AddLatency(lock.nTimeComplete - lock.nTimeRequest);
+}
+
 int64_t CreateNewLock(CTransaction tx)
 {
 
@@ -240,12 +325,20 @@ int64_t CreateNewLock(CTransaction tx)
 
         CTransactionLock newLock;
         newLock.nBlockHeight = nBlockHeight;
-        newLock.nExpiration = GetTime()+(20*60); //locks expire after 20 minutes (20 confirmations)
-        newLock.nTimeout = GetTime()+(60*5);
+        newLock.nTimeout = GetTime()+FASTTX_LOCK_TIMEOUT_SECONDS;
+        newLock.nTimeRequest = GetTimeMillis();
         newLock.txHash = tx.GetHash();
-        mapTxLocks.insert(make_pair(tx.GetHash(), newLock));
+        SetLockExpiration(mapTxLocks.insert(make_pair(tx.GetHash(), newLock)).first->second, GetTime()+FASTTX_LOCK_EXPIRATION_SECONDS);
+        fastTxStats.nLockRequests++;
     } else {
-        mapTxLocks[tx.GetHash()].nBlockHeight = nBlockHeight;
+        CTransactionLock& lock = mapTxLocks[tx.GetHash()];
+        lock.nBlockHeight = nBlockHeight;
+        if(lock.nTimeRequest == 0){
+            // the votes came first
+            lock.nTimeRequest = GetTimeMillis();
+            fastTxStats.nLockRequests++;
+        }
+        UpdateLockLatency(lock);
         LogPrint("fasttx", "CreateNewLock - Transaction Lock Exists %s !\n", tx.GetHash().ToString().c_str());
     }
 
@@ -289,7 +382,7 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight)
         return;
     }
 
-    mapTxLockVote[ctx.GetHash()] = ctx;
+    AddTransactionLockVote(ctx);
 
     CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
 
@@ -334,10 +427,9 @@ bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
 
         CTransactionLock newLock;
         newLock.nBlockHeight = 0;
-        newLock.nExpiration = GetTime()+(20*60);
-        newLock.nTimeout = GetTime()+(60*5);
+        newLock.nTimeout = GetTime()+FASTTX_LOCK_TIMEOUT_SECONDS;
         newLock.txHash = ctx.txHash;
-        mapTxLocks.insert(make_pair(ctx.txHash, newLock));
+        SetLockExpiration(mapTxLocks.insert(make_pair(ctx.txHash, newLock)).first->second, GetTime()+FASTTX_LOCK_EXPIRATION_SECONDS);
     } else {
         LogPrint("fasttx", "FastTx::ProcessConsensusVote - Transaction Lock Exists %s !\n", ctx.txHash.ToString().c_str());
     }
@@ -346,9 +438,11 @@ bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
     CBlock block;
     CTxDB txdb("r");
     //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(ctx.txHash);
+    TxLockMap::iterator i = mapTxLocks.find(ctx.txHash);
     if (i != mapTxLocks.end()){
         (*i).second.AddSignature(ctx);
+        fastTxStats.nVotesAccepted++;
+        UpdateLockLatency((*i).second);
 
 #ifdef ENABLE_WALLET
         if(pwalletMain){
@@ -363,7 +457,10 @@ bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
         if((*i).second.CountSignatures() >= FASTTX_SIGNATURES_REQUIRED){
             LogPrint("fasttx", "FastTx::ProcessConsensusVote - Transaction Lock Is Complete %s !\n", (*i).second.GetHash().ToString().c_str());
 
-            CTransaction& tx = mapTxLockReq[ctx.txHash];
+            // don't add an empty request when the votes came first
+            CTransaction txUnknown;
+            TxLockReqMap::iterator mi = mapTxLockReq.find(ctx.txHash);
+            CTransaction& tx = mi != mapTxLockReq.end() ? mi->second : txUnknown;
             if(!CheckForConflictingLocks(tx)){
 
 #ifdef ENABLE_WALLET
@@ -374,7 +471,7 @@ bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
                 }
 #endif
 
-                if(mapTxLockReq.count(ctx.txHash)){
+                if(mi != mapTxLockReq.end()){
                     BOOST_FOREACH(const CTxIn& in, tx.vin){
                         if(!mapLockedInputs.count(in.prevout)){
                             mapLockedInputs.insert(make_pair(in.prevout, ctx.txHash));
@@ -412,8 +509,8 @@ bool CheckForConflictingLocks(CTransaction& tx)
         if(mapLockedInputs.count(in.prevout)){
             if(mapLockedInputs[in.prevout] != tx.GetHash()){
                 LogPrintf("FastTx::CheckForConflictingLocks - found two complete conflicting locks - removing both. %s %s", tx.GetHash().ToString().c_str(), mapLockedInputs[in.prevout].ToString().c_str());
-                if(mapTxLocks.count(tx.GetHash())) mapTxLocks[tx.GetHash()].nExpiration = GetTime();
-                if(mapTxLocks.count(mapLockedInputs[in.prevout])) mapTxLocks[mapLockedInputs[in.prevout]].nExpiration = GetTime();
+                if(mapTxLocks.count(tx.GetHash())) SetLockExpiration(mapTxLocks[tx.GetHash()], GetTime());
+                if(mapTxLocks.count(mapLockedInputs[in.prevout])) SetLockExpiration(mapTxLocks[mapLockedInputs[in.prevout]], GetTime());
                 return true;
             }
         }
@@ -422,50 +519,106 @@ bool CheckForConflictingLocks(CTransaction& tx)
     return false;
 }
 
+static void SetUnknownVoteTime(const uint256& hash, int64_t nTime)
+{
+    int64_t& nVoteTime = mapUnknownVotes[hash];
+    nUnknownVotesTotal += nTime - nVoteTime;
+    nVoteTime = nTime;
+}
+
 int64_t GetAverageVoteTime()
 {
-    std::map<uint256, int64_t>::iterator it = mapUnknownVotes.begin();
-    int64_t total = 0;
-    int64_t count = 0;
-
-    while(it != mapUnknownVotes.end()) {
-        total+= it->second;
-        count++;
-        it++;
-    }
+    if(mapUnknownVotes.empty()) return 0;
 
-    return total / count;
+    return nUnknownVotesTotal / (int64_t)mapUnknownVotes.size();
+}
+
+void CFastTxStats::AddLatency(int64_t nLatency)
+{
+    nLatencySamples++;
+    nLatencyTotal += nLatency;
+    nLatencyMax = std::max(nLatencyMax, nLatency);
+
+    unsigned int nBucket = 0;
+    while(nBucket < FASTTX_LATENCY_BUCKET_COUNT - 1 && nLatency >= FASTTX_LATENCY_BUCKETS[nBucket])
+        nBucket++;
+    vLatencyBuckets[nBucket]++;
+}
+
+void AddTransactionLockReq(const CTransaction& tx, bool fAccepted)
+{
+    TxLockReqMap& mapReq = fAccepted ? mapTxLockReq : mapTxLockReqRejected;
+    if(mapReq.insert(make_pair(tx.GetHash(), tx)).second)
+        wheelTxLockReqs.Insert(tx.GetHash(), GetTime()+FASTTX_LOCK_EXPIRATION_SECONDS);
+}
+
+void AddTransactionLockVote(const CConsensusVote& ctx)
+{
+    uint256 hash = ctx.GetHash();
+    bool fNew = !mapTxLockVote.count(hash);
+    mapTxLockVote[hash] = ctx;
+    if(fNew)
+        wheelTxLockVotes.Insert(hash, GetTime()+FASTTX_LOCK_EXPIRATION_SECONDS);
+}
+
+// If the lock of txHash is still alive, move the entry to when it expires
+static bool RescheduleWithLock(CTimingWheel<uint256>& wheel, const uint256& hash, const uint256& txHash, int64_t nNow)
+{
+    TxLockMap::iterator it = mapTxLocks.find(txHash);
+    if(it == mapTxLocks.end() || nNow > it->second.nExpiration) return false;
+
+    wheel.Insert(hash, (int64_t)it->second.nExpiration + 1);
+    return true;
 }
 
 void CleanTransactionLocksList()
 {
     if(pindexBest == NULL) return;
 
-    std::map<uint256, CTransactionLock>::iterator it = mapTxLocks.begin();
+    int64_t nNow = GetTime();
+    std::vector<uint256> vExpired;
 
-    while(it != mapTxLocks.end()) {
-        if(GetTime() > it->second.nExpiration){ //keep them for an hour
-            LogPrintf("Removing old transaction lock %s\n", it->second.txHash.ToString().c_str());
+    wheelTxLocks.Expire(nNow, vExpired);
+    BOOST_FOREACH(const uint256& txHash, vExpired){
+        TxLockMap::iterator it = mapTxLocks.find(txHash);
+        // gone already, or expiration moved and scheduled again
+        if(it == mapTxLocks.end() || nNow <= it->second.nExpiration) continue;
 
-            if(mapTxLockReq.count(it->second.txHash)){
-                CTransaction& tx = mapTxLockReq[it->second.txHash];
+        LogPrintf("Removing old transaction lock %s\n", txHash.ToString().c_str());
 
-                BOOST_FOREACH(const CTxIn& in, tx.vin)
-                    mapLockedInputs.erase(in.prevout);
+        TxLockReqMap::iterator mi = mapTxLockReq.find(txHash);
+        if(mi != mapTxLockReq.end()){
+            BOOST_FOREACH(const CTxIn& in, mi->second.vin)
+                mapLockedInputs.erase(in.prevout);
 
-                mapTxLockReq.erase(it->second.txHash);
-                mapTxLockReqRejected.erase(it->second.txHash);
+            mapTxLockReq.erase(mi);
+        }
+        mapTxLockReqRejected.erase(txHash);
 
-                BOOST_FOREACH(CConsensusVote& v, it->second.vecConsensusVotes)
-                    mapTxLockVote.erase(v.GetHash());
-            }
+        BOOST_FOREACH(CConsensusVote& v, it->second.vecConsensusVotes)
+            mapTxLockVote.erase(v.GetHash());
 
-            mapTxLocks.erase(it++);
-        } else {
-            it++;
-        }
+        mapTxLocks.erase(it);
+        fastTxStats.nLocksExpired++;
     }
 
+    // requests and votes that never made it into a lock
+    vExpired.clear();
+    wheelTxLockReqs.Expire(nNow, vExpired);
+    BOOST_FOREACH(const uint256& txHash, vExpired){
+        if(RescheduleWithLock(wheelTxLockReqs, txHash, txHash, nNow)) continue;
+        mapTxLockReq.erase(txHash);
+        mapTxLockReqRejected.erase(txHash);
+    }
+
+    vExpired.clear();
+    wheelTxLockVotes.Expire(nNow, vExpired);
+    BOOST_FOREACH(const uint256& hash, vExpired){
+        TxLockVoteMap::iterator it = mapTxLockVote.find(hash);
+        if(it == mapTxLockVote.end()) continue;
+        if(RescheduleWithLock(wheelTxLockVotes, hash, it->second.txHash, nNow)) continue;
+        mapTxLockVote.erase(it);
+    }
 }
 
 uint256 CConsensusVote::GetHash() const
@@ -474,12 +627,17 @@ uint256 CConsensusVote::GetHash() const
 }
 
 
-bool CConsensusVote::SignatureValid()
+uint256 CConsensusVote::GetSignatureHash() const
 {
-    std::string errorMessage;
-    std::string strMessage = txHash.ToString().c_str() + boost::lexical_cast<std::string>(nBlockHeight);
-    //LogPrintf("verify strMessage %s \n", strMessage.c_str());
+    // same as CAnonSendSigner::VerifyMessage() hashes the signed message
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << strMessageMagic;
+    ss << txHash.ToString() + boost::lexical_cast<std::string>(nBlockHeight);
+    return ss.GetHash();
+}
 
+bool CConsensusVote::SignatureValid()
+{
     CMasternode* pmn = mnodeman.Find(vinMasternode);
 
     if(pmn == NULL)
@@ -488,7 +646,9 @@ bool CConsensusVote::SignatureValid()
         return false;
     }
 
-    if(!anonSendSigner.VerifyMessage(pmn->pubkey2, vchMasterNodeSignature, strMessage, errorMessage)) {
+    // only recovers the signature if this vote was not verified before
+    CConsensusVoteCheck check(GetSignatureHash(), vchMasterNodeSignature, pmn->pubkey2, &consensusVoteCache);
+    if(!check.Verify()) {
         LogPrintf("FastTx::CConsensusVote::SignatureValid() - Verify message failed\n");
         return false;
     }
@@ -529,7 +689,7 @@ bool CConsensusVote::Sign()
 bool CTransactionLock::SignaturesValid()
 {
 
-    BOOST_FOREACH(CConsensusVote vote, vecConsensusVotes)
+    BOOST_FOREACH(CConsensusVote& vote, vecConsensusVotes)
     {
         int n = mnodeman.GetMasternodeRank(vote.vinMasternode, vote.nBlockHeight, MIN_FASTTX_PROTO_VERSION);
 
@@ -14,6 +14,10 @@
 #include "script.h"
 #include "base58.h"
 #include "main.h"
+#include "fasttxcheck.h"
+#include "timingwheel.h"
+
+#include <boost/unordered_map.hpp>
 
 using namespace std;
 using namespace boost;
@@ -22,12 +26,54 @@ class CConsensusVote;
 class CTransaction;
 class CTransactionLock;
 
-extern map<uint256, CTransaction> mapTxLockReq;
-extern map<uint256, CTransaction> mapTxLockReqRejected;
-extern map<uint256, CConsensusVote> mapTxLockVote;
-extern map<uint256, CTransactionLock> mapTxLocks;
-extern std::map<COutPoint, uint256> mapLockedInputs;
+/** Transaction locks expire after 20 minutes (20 confirmations) */
+#define FASTTX_LOCK_EXPIRATION_SECONDS       (20*60)
+#define FASTTX_LOCK_TIMEOUT_SECONDS          (5*60)
+
+/** The expiry wheels cover 256 * 10 seconds, twice the lock lifetime */
+#define FASTTX_EXPIRY_WHEEL_SLOTS            256
+#define FASTTX_EXPIRY_WHEEL_RESOLUTION       10
+
+/** Lock latency histogram bounds in milliseconds, the last bucket is open */
+static const int64_t FASTTX_LATENCY_BUCKETS[] = { 1000, 2000, 5000, 10000, 30000 };
+static const unsigned int FASTTX_LATENCY_BUCKET_COUNT = sizeof(FASTTX_LATENCY_BUCKETS) / sizeof(FASTTX_LATENCY_BUCKETS[0]) + 1;
+
+typedef boost::unordered_map<uint256, CTransaction, BlockHasher> TxLockReqMap;
+typedef boost::unordered_map<uint256, CConsensusVote, BlockHasher> TxLockVoteMap;
+typedef boost::unordered_map<uint256, CTransactionLock, BlockHasher> TxLockMap;
+typedef boost::unordered_map<COutPoint, uint256, COutPointHasher> LockedInputMap;
+
+/** Counters of the transaction locks seen by this node, for getfasttxstats */
+class CFastTxStats
+{
+public:
+    uint64_t nLockRequests;     // locks started by a lock request
+    uint64_t nLocksCompleted;   // locks that collected FASTTX_SIGNATURES_REQUIRED votes
+    uint64_t nLocksExpired;
+    uint64_t nVotesAccepted;
+    uint64_t nLatencySamples;   // completed locks whose request was seen
+    int64_t nLatencyTotal;      // request to FASTTX_SIGNATURES_REQUIRED votes, ms
+    int64_t nLatencyMax;
+    uint64_t vLatencyBuckets[FASTTX_LATENCY_BUCKET_COUNT];
+
+    CFastTxStats()
+    {
+        nLockRequests = nLocksCompleted = nLocksExpired = nVotesAccepted = nLatencySamples = 0;
+        nLatencyTotal = nLatencyMax = 0;
+        memset(vLatencyBuckets, 0, sizeof(vLatencyBuckets));
+    }
+
+    void AddLatency(int64_t nLatency);
+};
+
+extern TxLockReqMap mapTxLockReq;
+extern TxLockReqMap mapTxLockReqRejected;
+extern TxLockVoteMap mapTxLockVote;
+extern TxLockMap mapTxLocks;
+extern LockedInputMap mapLockedInputs;
 extern int nCompleteTXLocks;
+extern CConsensusVoteCache consensusVoteCache;
+extern CFastTxStats fastTxStats;
 
 
 int64_t CreateNewLock(CTransaction tx);
@@ -45,7 +91,18 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight);
 //process consensus vote message
 bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx);
 
-// keep transaction locks in memory for an hour
+// process the votes received during this message handler pass, recovering
+// their signatures in parallel first
+void ProcessQueuedConsensusVotes();
+
+// worker thread of the consensus vote verification queue
+void ThreadConsensusVoteCheck();
+
+// remember a lock request or a received vote until it expires
+void AddTransactionLockReq(const CTransaction& tx, bool fAccepted);
+void AddTransactionLockVote(const CConsensusVote& ctx);
+
+// remove the transaction locks, requests and votes that expired
 void CleanTransactionLocksList();
 
 int64_t GetAverageVoteTime();
@@ -59,6 +116,8 @@ public:
     std::vector<unsigned char> vchMasterNodeSignature;
 
     uint256 GetHash() const;
+    // hash of the message the masternode signs
+    uint256 GetSignatureHash() const;
 
     bool SignatureValid();
     bool Sign();
@@ -80,6 +139,17 @@ public:
     std::vector<CConsensusVote> vecConsensusVotes;
     int nExpiration;
     int nTimeout;
+    int64_t nTimeRequest;   // when the lock request was seen, ms
+    int64_t nTimeComplete;  // when FASTTX_SIGNATURES_REQUIRED votes were counted, ms
+
+    CTransactionLock()
+    {
+        nBlockHeight = 0;
+        nExpiration = 0;
+        nTimeout = 0;
+        nTimeRequest = 0;
+        nTimeComplete = 0;
+    }
 
     bool SignaturesValid();
     int CountSignatures();
@@ -0,0 +1,123 @@
+// Copyright (c) 2014-2018 The MarteX developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef FASTTXCHECK_H
+#define FASTTXCHECK_H
+
+#include "hash.h"
+#include "pubkey.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include <boost/unordered_set.hpp>
+
+/** The maximum number of verified consensus votes remembered */
+static const unsigned int FASTTX_VOTE_CACHE_SIZE = 50000;
+
+/** Consensus votes whose signature was already recovered and matched the
+ *  masternode key. Entries commit to the signed message, the signature and
+ *  the key, so a hit means the same vote was verified against the same
+ *  masternode before. The oldest entries are forgotten first.
+ */
+class CConsensusVoteCache
+{
+private:
+    struct EntryHasher
+    {
+        size_t operator()(const uint256& hash) const { return hash.Get64(); }
+    };
+
+    CCriticalSection cs;
+    boost::unordered_set<uint256, EntryHasher> setVerified;
+    std::deque<uint256> vOrder;
+    unsigned int nMaxSize;
+
+public:
+    CConsensusVoteCache(unsigned int nMaxSizeIn = FASTTX_VOTE_CACHE_SIZE) : nMaxSize(nMaxSizeIn) {}
+
+    static uint256 GetEntry(const uint256& hashMessage, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey)
+    {
+        CHashWriter ss(SER_GETHASH, 0);
+        ss << hashMessage << vchSig << pubkey;
+        return ss.GetHash();
+    }
+
+    bool Contains(const uint256& entry)
+    {
+        LOCK(cs);
+        return setVerified.count(entry) != 0;
+    }
+
+    void Insert(const uint256& entry)
+    {
+        LOCK(cs);
+        if (!setVerified.insert(entry).second)
+            return;
+        vOrder.push_back(entry);
+        while (vOrder.size() > nMaxSize)
+        {
+            setVerified.erase(vOrder.front());
+            vOrder.pop_front();
+        }
+    }
+
+    size_t size()
+    {
+        LOCK(cs);
+        return setVerified.size();
+    }
+};
+
+/** Signature check of one consensus vote, for use with CCheckQueue.
+ *  operator() always returns true so that one bad vote does not stop the
+ *  rest of the batch; valid votes are reported through the cache instead.
+ */
+class CConsensusVoteCheck
+{
+private:
+    uint256 hashMessage;
+    std::vector<unsigned char> vchSig;
+    CPubKey pubkey;
+    CConsensusVoteCache* pcache;
+
+public:
+    CConsensusVoteCheck() : pcache(NULL) {}
+    CConsensusVoteCheck(const uint256& hashMessageIn, const std::vector<unsigned char>& vchSigIn, const CPubKey& pubkeyIn, CConsensusVoteCache* pcacheIn) :
+        hashMessage(hashMessageIn), vchSig(vchSigIn), pubkey(pubkeyIn), pcache(pcacheIn) {}
+
+    // Check the signature, looking it up in and adding it to the cache
+    bool Verify()
+    {
+        uint256 entry = CConsensusVoteCache::GetEntry(hashMessage, vchSig, pubkey);
+        if (pcache && pcache->Contains(entry))
+            return true;
+
+        CPubKey pubkeyRecovered;
+        if (!pubkeyRecovered.RecoverCompact(hashMessage, vchSig) || pubkeyRecovered.GetID() != pubkey.GetID())
+            return false;
+
+        if (pcache)
+            pcache->Insert(entry);
+        return true;
+    }
+
+    bool operator()()
+    {
+        Verify();
+        return true;
+    }
+
+    void swap(CConsensusVoteCheck& check)
+    {
+        std::swap(hashMessage, check.hashMessage);
+        vchSig.swap(check.vchSig);
+        std::swap(pubkey, check.pubkey);
+        std::swap(pcache, check.pcache);
+    }
+};
+
+#endif // FASTTXCHECK_H
@@ -0,0 +1,494 @@
+// Copyright (c) 2014-2018 The MarteX developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "hashblock.h"
+
+#include <string.h>
+
+#include <boost/thread/tss.hpp>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define USE_HASH9_AESNI 1
+#include <cpuid.h>
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+namespace
+{
+/// Generic stage implementations on top of the sph_* reference code.
+namespace generic
+{
+void Echo512(const unsigned char* in, unsigned char* out)
+{
+    sph_echo512_context ctx;
+    sph_echo512_init(&ctx);
+    sph_echo512(&ctx, in, 64);
+    sph_echo512_close(&ctx, out);
+}
+
+void Groestl512(const unsigned char* in, unsigned char* out)
+{
+    sph_groestl512_context ctx;
+    sph_groestl512_init(&ctx);
+    sph_groestl512(&ctx, in, 64);
+    sph_groestl512_close(&ctx, out);
+}
+
+void Shavite512(const unsigned char* in, unsigned char* out)
+{
+    sph_shavite512_context ctx;
+    sph_shavite512_init(&ctx);
+    sph_shavite512(&ctx, in, 64);
+    sph_shavite512_close(&ctx, out);
+}
+} // namespace generic
+
+#ifdef USE_HASH9_AESNI
+/// AES-NI implementations of the stages built on the AES round or S-box,
+/// specialised for the single 64-byte block every stage after the first
+/// one hashes.
+namespace aesni
+{
+#define HASH9_AESNI __attribute__((target("aes,ssse3")))
+
+HASH9_AESNI inline __m128i Mul2(__m128i x)
+{
+    // Multiply every byte by 2 in GF(2^8) (AES polynomial)
+    __m128i carry = _mm_and_si128(_mm_cmplt_epi8(x, _mm_setzero_si128()), _mm_set1_epi8(0x1b));
+    return _mm_xor_si128(_mm_add_epi8(x, x), carry);
+}
+
+HASH9_AESNI void Echo512(const unsigned char* in, unsigned char* out)
+{
+    // Chaining value: every 128-bit word starts as the output length (512)
+    const __m128i v = _mm_set_epi32(0, 0, 0, 512);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i w[16], b[8];
+
+    // Message block: 64 bytes of data, the 0x80 padding byte, the output
+    // length in bits at offset 110 and the 128-bit bit counter at 112
+    b[0] = _mm_loadu_si128((const __m128i*)(in + 0));
+    b[1] = _mm_loadu_si128((const __m128i*)(in + 16));
+    b[2] = _mm_loadu_si128((const __m128i*)(in + 32));
+    b[3] = _mm_loadu_si128((const __m128i*)(in + 48));
+    b[4] = _mm_set_epi32(0, 0, 0, 0x80);
+    b[5] = zero;
+    b[6] = _mm_set_epi32(0x02000000, 0, 0, 0);
+    b[7] = _mm_set_epi32(0, 0, 0, 512);
+
+    for (int i = 0; i < 8; i++) {
+        w[i] = v;
+        w[i + 8] = b[i];
+    }
+
+    uint32_t k = 512;
+    for (int r = 0; r < 10; r++) {
+        // BIG.SubWords: two AES rounds per word, keyed by the counter
+        for (int i = 0; i < 16; i++) {
+            w[i] = _mm_aesenc_si128(_mm_aesenc_si128(w[i], _mm_set_epi32(0, 0, 0, k++)), zero);
+        }
+
+        // BIG.ShiftRows
+        __m128i t = w[1];
+        w[1] = w[5]; w[5] = w[9]; w[9] = w[13]; w[13] = t;
+        t = w[2]; w[2] = w[10]; w[10] = t;
+        t = w[6]; w[6] = w[14]; w[14] = t;
+        t = w[15];
+        w[15] = w[11]; w[11] = w[7]; w[7] = w[3]; w[3] = t;
+
+        // BIG.MixColumns
+        for (int i = 0; i < 16; i += 4) {
+            __m128i a = w[i], bb = w[i + 1], c = w[i + 2], d = w[i + 3];
+            __m128i ab = _mm_xor_si128(a, bb);
+            __m128i bc = _mm_xor_si128(bb, c);
+            __m128i cd = _mm_xor_si128(c, d);
+            __m128i abx = Mul2(ab);
+            __m128i bcx = Mul2(bc);
+            __m128i cdx = Mul2(cd);
+            w[i] = _mm_xor_si128(abx, _mm_xor_si128(bc, d));
+            w[i + 1] = _mm_xor_si128(bcx, _mm_xor_si128(a, cd));
+            w[i + 2] = _mm_xor_si128(cdx, _mm_xor_si128(ab, d));
+            w[i + 3] = _mm_xor_si128(_mm_xor_si128(abx, bcx), _mm_xor_si128(cdx, _mm_xor_si128(ab, c)));
+        }
+    }
+
+    for (int i = 0; i < 4; i++)
+        _mm_storeu_si128((__m128i*)(out + 16 * i), _mm_xor_si128(_mm_xor_si128(v, b[i]), _mm_xor_si128(w[i], w[i + 8])));
+}
+
+static const uint32_t SHAVITE512_IV[16] = {
+    0x72FCCDD8, 0x79CA4727, 0x128A077B, 0x40D55AEC,
+    0xD1901A06, 0x430AE307, 0xB29F5CD1, 0xDF07FBFC,
+    0x8E45D73D, 0x681AB538, 0xBDE86578, 0xDD577E47,
+    0xE275EADE, 0x502D9FCD, 0xB9357178, 0x022A4B9A
+};
+
+HASH9_AESNI void Shavite512(const unsigned char* in, unsigned char* out)
+{
+    const __m128i zero = _mm_setzero_si128();
+    // The counter holds 512 message bits; the schedule XORs it (and its
+    // complement) into four fixed subkeys
+    const uint32_t c0 = 512, c1 = 0, c2 = 0, c3 = 0;
+    __m128i rk[112];
+
+    // Message block: 64 bytes of data, 0x80 padding, the bit counter (512)
+    // at offset 110 and the digest size (512) in the last two bytes
+    rk[0] = _mm_loadu_si128((const __m128i*)(in + 0));
+    rk[1] = _mm_loadu_si128((const __m128i*)(in + 16));
+    rk[2] = _mm_loadu_si128((const __m128i*)(in + 32));
+    rk[3] = _mm_loadu_si128((const __m128i*)(in + 48));
+    rk[4] = _mm_set_epi32(0, 0, 0, 0x80);
+    rk[5] = zero;
+    rk[6] = _mm_set_epi32(0x02000000, 0, 0, 0);
+    rk[7] = _mm_set_epi32(0x02000000, 0, 0, 0);
+
+    // Key schedule, in 128-bit units (rk[n] holds 32-bit words 4n..4n+3)
+    int u = 8;
+    for (;;) {
+        for (int s = 0; s < 4; s++) {
+            for (int h = 0; h < 2; h++) {
+                __m128i x = _mm_shuffle_epi32(rk[u - 8], 0x39);
+                x = _mm_aesenc_si128(x, zero);
+                rk[u] = _mm_xor_si128(x, rk[u - 1]);
+                if (u == 8)
+                    rk[u] = _mm_xor_si128(rk[u], _mm_set_epi32(~c3, c2, c1, c0));
+                else if (u == 41)
+                    rk[u] = _mm_xor_si128(rk[u], _mm_set_epi32(~c0, c1, c2, c3));
+                else if (u == 79)
+                    rk[u] = _mm_xor_si128(rk[u], _mm_set_epi32(~c1, c0, c3, c2));
+                else if (u == 110)
+                    rk[u] = _mm_xor_si128(rk[u], _mm_set_epi32(~c2, c3, c0, c1));
+                u++;
+            }
+        }
+        if (u == 112)
+            break;
+        for (int s = 0; s < 8; s++) {
+            rk[u] = _mm_xor_si128(rk[u - 8], _mm_alignr_epi8(rk[u - 1], rk[u - 2], 4));
+            u++;
+        }
+    }
+
+    __m128i p0 = _mm_loadu_si128((const __m128i*)(SHAVITE512_IV + 0));
+    __m128i p1 = _mm_loadu_si128((const __m128i*)(SHAVITE512_IV + 4));
+    __m128i p2 = _mm_loadu_si128((const __m128i*)(SHAVITE512_IV + 8));
+    __m128i p3 = _mm_loadu_si128((const __m128i*)(SHAVITE512_IV + 12));
+    const __m128i h0 = p0, h1 = p1, h2 = p2, h3 = p3;
+
+    u = 0;
+    for (int r = 0; r < 14; r++) {
+        __m128i x = _mm_xor_si128(p1, rk[u++]);
+        x = _mm_aesenc_si128(x, zero);
+        x = _mm_aesenc_si128(_mm_xor_si128(x, rk[u++]), zero);
+        x = _mm_aesenc_si128(_mm_xor_si128(x, rk[u++]), zero);
+        x = _mm_aesenc_si128(_mm_xor_si128(x, rk[u++]), zero);
+        p0 = _mm_xor_si128(p0, x);
+
+        x = _mm_xor_si128(p3, rk[u++]);
+        x = _mm_aesenc_si128(x, zero);
+        x = _mm_aesenc_si128(_mm_xor_si128(x, rk[u++]), zero);
+        x = _mm_aesenc_si128(_mm_xor_si128(x, rk[u++]), zero);
+        x = _mm_aesenc_si128(_mm_xor_si128(x, rk[u++]), zero);
+        p2 = _mm_xor_si128(p2, x);
+
+        // Rotate the four 128-bit lanes: (p0, p1, p2, p3) <- (p3, p0, p1, p2)
+        __m128i t = p3;
+        p3 = p2; p2 = p1; p1 = p0; p0 = t;
+    }
+
+    _mm_storeu_si128((__m128i*)(out + 0), _mm_xor_si128(h0, p0));
+    _mm_storeu_si128((__m128i*)(out + 16), _mm_xor_si128(h1, p1));
+    _mm_storeu_si128((__m128i*)(out + 32), _mm_xor_si128(h2, p2));
+    _mm_storeu_si128((__m128i*)(out + 48), _mm_xor_si128(h3, p3));
+}
+
+// Groestl-512 keeps its 1024-bit state as 8 rows of 16 bytes; row i,
+// column j is byte 8j+i of the specification's column-major layout.
+// SubBytes is the AES S-box, which AESENCLAST with a zero key applies after
+// ShiftRows; each row's PSHUFB mask undoes ShiftRows and applies the
+// Groestl row rotation in one step. MixBytes works on whole rows.
+static const unsigned char GROESTL_SHIFT_MASKS[8][16] = {
+    { 0, 13, 10,  7,  4,  1, 14, 11,  8,  5,  2, 15, 12,  9,  6,  3},  // rotate left 0
+    {13, 10,  7,  4,  1, 14, 11,  8,  5,  2, 15, 12,  9,  6,  3,  0},  // 1
+    {10,  7,  4,  1, 14, 11,  8,  5,  2, 15, 12,  9,  6,  3,  0, 13},  // 2
+    { 7,  4,  1, 14, 11,  8,  5,  2, 15, 12,  9,  6,  3,  0, 13, 10},  // 3
+    { 4,  1, 14, 11,  8,  5,  2, 15, 12,  9,  6,  3,  0, 13, 10,  7},  // 4
+    { 1, 14, 11,  8,  5,  2, 15, 12,  9,  6,  3,  0, 13, 10,  7,  4},  // 5
+    {14, 11,  8,  5,  2, 15, 12,  9,  6,  3,  0, 13, 10,  7,  4,  1},  // 6
+    {15, 12,  9,  6,  3,  0, 13, 10,  7,  4,  1, 14, 11,  8,  5,  2},  // 11
+};
+
+// Row rotations of P1024 (0,1,2,3,4,5,6,11) and Q1024 (1,3,5,11,0,2,4,6)
+// as indexes into GROESTL_SHIFT_MASKS
+static const int GROESTL_SHIFT_P[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+static const int GROESTL_SHIFT_Q[8] = {1, 3, 5, 7, 0, 2, 4, 6};
+
+HASH9_AESNI void GroestlPermutation(__m128i x[8], bool fQ)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi8((char)0xff);
+    // (j << 4) for column j, the column part of the round constants
+    const __m128i columns = _mm_set_epi8((char)0xf0, (char)0xe0, (char)0xd0, (char)0xc0, (char)0xb0, (char)0xa0, (char)0x90, (char)0x80,
+                                         0x70, 0x60, 0x50, 0x40, 0x30, 0x20, 0x10, 0x00);
+    const int* shift = fQ ? GROESTL_SHIFT_Q : GROESTL_SHIFT_P;
+
+    for (int r = 0; r < 14; r++) {
+        // AddRoundConstant
+        __m128i rc = _mm_xor_si128(columns, _mm_set1_epi8((char)r));
+        if (fQ) {
+            for (int i = 0; i < 7; i++)
+                x[i] = _mm_xor_si128(x[i], ones);
+            x[7] = _mm_xor_si128(x[7], _mm_xor_si128(rc, ones));
+        } else {
+            x[0] = _mm_xor_si128(x[0], rc);
+        }
+
+        // SubBytes and ShiftBytes
+        for (int i = 0; i < 8; i++)
+            x[i] = _mm_shuffle_epi8(_mm_aesenclast_si128(x[i], zero),
+                                    _mm_loadu_si128((const __m128i*)GROESTL_SHIFT_MASKS[shift[i]]));
+
+        // MixBytes: row i of the result is sum_k B[i][k] * row k with
+        // B = circ(02, 02, 03, 04, 05, 03, 05, 07)
+        __m128i x2[8], x4[8], y[8];
+        for (int k = 0; k < 8; k++) {
+            x2[k] = Mul2(x[k]);
+            x4[k] = Mul2(x2[k]);
+        }
+        for (int i = 0; i < 8; i++) {
+            int k0 = i, k1 = (i + 1) & 7, k2 = (i + 2) & 7, k3 = (i + 3) & 7;
+            int k4 = (i + 4) & 7, k5 = (i + 5) & 7, k6 = (i + 6) & 7, k7 = (i + 7) & 7;
+            __m128i t = _mm_xor_si128(x2[k0], x2[k1]);                                      // 02 02
+            t = _mm_xor_si128(t, _mm_xor_si128(x2[k2], x[k2]));                             // 03
+            t = _mm_xor_si128(t, x4[k3]);                                                   // 04
+            t = _mm_xor_si128(t, _mm_xor_si128(x4[k4], x[k4]));                             // 05
+            t = _mm_xor_si128(t, _mm_xor_si128(x2[k5], x[k5]));                             // 03
+            t = _mm_xor_si128(t, _mm_xor_si128(x4[k6], x[k6]));                             // 05
+            t = _mm_xor_si128(t, _mm_xor_si128(_mm_xor_si128(x4[k7], x2[k7]), x[k7]));      // 07
+            y[i] = t;
+        }
+        for (int i = 0; i < 8; i++)
+            x[i] = y[i];
+    }
+}
+
+HASH9_AESNI void Groestl512(const unsigned char* in, unsigned char* out)
+{
+    // Padded message block: 64 bytes of data, 0x80, and the block count (1)
+    // in the last byte. The chaining value starts as the output size (512).
+    unsigned char block[128], rows[8][16];
+    memcpy(block, in, 64);
+    memset(block + 64, 0, 64);
+    block[64] = 0x80;
+    block[127] = 0x01;
+
+    __m128i h[8], m[8], p[8];
+    for (int i = 0; i < 8; i++)
+        for (int j = 0; j < 16; j++)
+            rows[i][j] = block[8 * j + i];
+    for (int i = 0; i < 8; i++) {
+        m[i] = _mm_loadu_si128((const __m128i*)rows[i]);
+        h[i] = _mm_setzero_si128();
+    }
+    h[6] = _mm_insert_epi16(h[6], 0x0200, 7);   // byte 126 = 0x02
+
+    // Compression: h = P(h ^ m) ^ Q(m) ^ h
+    for (int i = 0; i < 8; i++)
+        p[i] = _mm_xor_si128(h[i], m[i]);
+    GroestlPermutation(p, false);
+    GroestlPermutation(m, true);
+    for (int i = 0; i < 8; i++)
+        h[i] = _mm_xor_si128(h[i], _mm_xor_si128(p[i], m[i]));
+
+    // Output transformation: the last 512 bits of P(h) ^ h
+    for (int i = 0; i < 8; i++)
+        p[i] = h[i];
+    GroestlPermutation(p, false);
+    for (int i = 0; i < 8; i++)
+        _mm_storeu_si128((__m128i*)rows[i], _mm_xor_si128(p[i], h[i]));
+    for (int j = 8; j < 16; j++)
+        for (int i = 0; i < 8; i++)
+            out[8 * (j - 8) + i] = rows[i][j];
+}
+
+bool Supported()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return false;
+    // SSSE3 (bit 9) and AES-NI (bit 25)
+    return (ecx & (1 << 9)) && (ecx & (1 << 25));
+}
+
+#undef HASH9_AESNI
+} // namespace aesni
+#endif // USE_HASH9_AESNI
+
+typedef void (*StageFn)(const unsigned char* in, unsigned char* out);
+
+struct StageTable
+{
+    StageFn echo512;
+    StageFn groestl512;
+    StageFn shavite512;
+    const char* name;
+
+    StageTable() : echo512(generic::Echo512), groestl512(generic::Groestl512), shavite512(generic::Shavite512), name("generic")
+    {
+#ifdef USE_HASH9_AESNI
+        if (aesni::Supported()) {
+            echo512 = aesni::Echo512;
+            groestl512 = aesni::Groestl512;
+            shavite512 = aesni::Shavite512;
+            name = "aesni";
+        }
+#endif
+    }
+};
+
+const StageTable& Stages()
+{
+    static const StageTable table;
+    return table;
+}
+
+/// Freshly initialised contexts every hash starts from.
+struct InitialContexts
+{
+    sph_blake512_context     blake;
+    sph_bmw512_context       bmw;
+    sph_jh512_context        jh;
+    sph_keccak512_context    keccak;
+    sph_skein512_context     skein;
+    sph_luffa512_context     luffa;
+    sph_cubehash512_context  cubehash;
+    sph_simd512_context      simd;
+    sph_hamsi512_context     hamsi;
+    sph_fugue512_context     fugue;
+
+    InitialContexts()
+    {
+        sph_blake512_init(&blake);
+        sph_bmw512_init(&bmw);
+        sph_jh512_init(&jh);
+        sph_keccak512_init(&keccak);
+        sph_skein512_init(&skein);
+        sph_luffa512_init(&luffa);
+        sph_cubehash512_init(&cubehash);
+        sph_simd512_init(&simd);
+        sph_hamsi512_init(&hamsi);
+        sph_fugue512_init(&fugue);
+    }
+};
+
+const InitialContexts& Initial()
+{
+    static const InitialContexts z;
+    return z;
+}
+} // namespace
+
+CHash9Engine::CHash9Engine(bool fGenericOnly)
+{
+    const StageTable& stages = Stages();
+    if (fGenericOnly) {
+        echo512 = generic::Echo512;
+        groestl512 = generic::Groestl512;
+        shavite512 = generic::Shavite512;
+    } else {
+        echo512 = stages.echo512;
+        groestl512 = stages.groestl512;
+        shavite512 = stages.shavite512;
+    }
+}
+
+const char* CHash9Engine::Implementation()
+{
+    return Stages().name;
+}
+
+CHash9Engine& CHash9Engine::ThreadEngine()
+{
+    // thread_specific_ptr deletes the engine when the thread ends
+    static boost::thread_specific_ptr<CHash9Engine> ptrEngine;
+    if (ptrEngine.get() == NULL)
+        ptrEngine.reset(new CHash9Engine());
+    return *ptrEngine;
+}
+
+void CHash9Engine::Chain(const void* pdata, size_t nLen, unsigned char* pout)
+{
+    // Every context is restored from its initialised template with a
+    // plain copy instead of re-running the init functions
+    uint512 hash[2];
+    unsigned char* a = hash[0].begin();
+    unsigned char* b = hash[1].begin();
+    static unsigned char pblank[1];
+    const InitialContexts& z = Initial();
+
+    memcpy(&ctx_blake, &z.blake, sizeof(z.blake));
+    sph_blake512(&ctx_blake, nLen ? pdata : pblank, nLen);
+    sph_blake512_close(&ctx_blake, a);
+
+    memcpy(&ctx_bmw, &z.bmw, sizeof(z.bmw));
+    sph_bmw512(&ctx_bmw, a, 64);
+    sph_bmw512_close(&ctx_bmw, b);
+
+    groestl512(b, a);
+
+    memcpy(&ctx_skein, &z.skein, sizeof(z.skein));
+    sph_skein512(&ctx_skein, a, 64);
+    sph_skein512_close(&ctx_skein, b);
+
+    memcpy(&ctx_jh, &z.jh, sizeof(z.jh));
+    sph_jh512(&ctx_jh, b, 64);
+    sph_jh512_close(&ctx_jh, a);
+
+    memcpy(&ctx_keccak, &z.keccak, sizeof(z.keccak));
+    sph_keccak512(&ctx_keccak, a, 64);
+    sph_keccak512_close(&ctx_keccak, b);
+
+    memcpy(&ctx_luffa, &z.luffa, sizeof(z.luffa));
+    sph_luffa512(&ctx_luffa, b, 64);
+    sph_luffa512_close(&ctx_luffa, a);
+
+    memcpy(&ctx_cubehash, &z.cubehash, sizeof(z.cubehash));
+    sph_cubehash512(&ctx_cubehash, a, 64);
+    sph_cubehash512_close(&ctx_cubehash, b);
+
+    shavite512(b, a);
+
+    memcpy(&ctx_simd, &z.simd, sizeof(z.simd));
+    sph_simd512(&ctx_simd, a, 64);
+    sph_simd512_close(&ctx_simd, b);
+
+    echo512(b, a);
+
+    memcpy(&ctx_hamsi, &z.hamsi, sizeof(z.hamsi));
+    sph_hamsi512(&ctx_hamsi, a, 64);
+    sph_hamsi512_close(&ctx_hamsi, b);
+
+    memcpy(&ctx_fugue, &z.fugue, sizeof(z.fugue));
+    sph_fugue512(&ctx_fugue, b, 64);
+    sph_fugue512_close(&ctx_fugue, pout);
+}
+
+uint256 CHash9Engine::Hash(const void* pdata, size_t nLen)
+{
+    uint512 hash;
+    Chain(pdata, nLen, hash.begin());
+    return hash.trim256();
+}
+
+void CHash9Engine::HashHeaders(const unsigned char* pheaders, size_t nCount, uint256* phashes)
+{
+    uint512 hash;
+    for (size_t i = 0; i < nCount; i++) {
+        Chain(pheaders + i * HEADER_SIZE, HEADER_SIZE, hash.begin());
+        phashes[i] = hash.trim256();
+    }
+}
@@ -20,51 +20,55 @@
 #include <string>
 #endif
 
-#ifdef GLOBALDEFINED
-#define GLOBAL
-#else
-#define GLOBAL extern
-#endif
+/** Reusable Hash9 (X13) engine.
+ *
+ * Keeps one set of sph_* contexts that are restored from process-wide,
+ * freshly-initialised templates, so each hash only pays a context copy per
+ * stage instead of the init functions. Inputs are hashed one at a time:
+ * HashHeaders() is a loop over the same engine, not a multi-lane hash. The
+ * stages built on the AES round or S-box (Groestl, SHAvite, ECHO) use AES-NI
+ * when the CPU supports it, selected once at runtime via CPUID.
+ *
+ * An engine is not thread safe; use ThreadEngine() for a per-thread one.
+ */
+class CHash9Engine
+{
+public:
+    static const size_t HEADER_SIZE = 80;
+
+    explicit CHash9Engine(bool fGenericOnly = false);
+
+    uint256 Hash(const void* pdata, size_t nLen);
+    /** Hash nCount consecutive HEADER_SIZE-byte headers into phashes */
+    void HashHeaders(const unsigned char* pheaders, size_t nCount, uint256* phashes);
+
+    /** Name of the stage implementation selected for this CPU */
+    static const char* Implementation();
+
+    /** Engine owned by the calling thread, created on first use */
+    static CHash9Engine& ThreadEngine();
+
+private:
+    typedef void (*StageFn)(const unsigned char* in, unsigned char* out);
+
+    StageFn echo512;
+    StageFn groestl512;
+    StageFn shavite512;
+
+    sph_blake512_context     ctx_blake;
+    sph_bmw512_context       ctx_bmw;
+    sph_jh512_context        ctx_jh;
+    sph_keccak512_context    ctx_keccak;
+    sph_skein512_context     ctx_skein;
+    sph_luffa512_context     ctx_luffa;
+    sph_cubehash512_context  ctx_cubehash;
+    sph_simd512_context      ctx_simd;
+    sph_hamsi512_context     ctx_hamsi;
+    sph_fugue512_context     ctx_fugue;
+
+    void Chain(const void* pdata, size_t nLen, unsigned char* pout);
+};
 
-GLOBAL sph_blake512_context     z_blake;
-GLOBAL sph_bmw512_context       z_bmw;
-GLOBAL sph_groestl512_context   z_groestl;
-GLOBAL sph_jh512_context        z_jh;
-GLOBAL sph_keccak512_context    z_keccak;
-GLOBAL sph_skein512_context     z_skein;
-GLOBAL sph_luffa512_context     z_luffa;
-GLOBAL sph_cubehash512_context  z_cubehash;
-GLOBAL sph_shavite512_context   z_shavite;
-GLOBAL sph_simd512_context      z_simd;
-GLOBAL sph_echo512_context      z_echo;
-GLOBAL sph_hamsi512_context      z_hamsi;
-GLOBAL sph_fugue512_context      z_fugue;
-
-#define fillz() do { \
-    sph_blake512_init(&z_blake); \
-    sph_bmw512_init(&z_bmw); \
-    sph_groestl512_init(&z_groestl); \
-    sph_jh512_init(&z_jh); \
-    sph_keccak512_init(&z_keccak); \
-    sph_skein512_init(&z_skein); \
-    sph_luffa512_init(&z_luffa); \
-    sph_cubehash512_init(&z_cubehash); \
-    sph_shavite512_init(&z_shavite); \
-    sph_simd512_init(&z_simd); \
-    sph_echo512_init(&z_echo); \
-    sph_hamsi512_init(&z_hamsi); \
-    sph_fugue512_init(&z_fugue); \
-} while (0) 
-
-
-#define ZBLAKE (memcpy(&ctx_blake, &z_blake, sizeof(z_blake)))
-#define ZBMW (memcpy(&ctx_bmw, &z_bmw, sizeof(z_bmw)))
-#define ZGROESTL (memcpy(&ctx_groestl, &z_groestl, sizeof(z_groestl)))
-#define ZJH (memcpy(&ctx_jh, &z_jh, sizeof(z_jh)))
-#define ZKECCAK (memcpy(&ctx_keccak, &z_keccak, sizeof(z_keccak)))
-#define ZSKEIN (memcpy(&ctx_skein, &z_skein, sizeof(z_skein)))
-#define ZHAMSI (memcpy(&ctx_hamsi, &z_hamsi, sizeof(z_hamsi)))
-#define ZFUGUE (memcpy(&ctx_fugue, &z_fugue, sizeof(z_fugue)))
 template<typename T1>
 inline uint256 Hash9(const T1 pbegin, const T1 pend)
 
@@ -16,6 +16,7 @@
 #include "util.h"
 #include "ui_interface.h"
 #include "checkpoints.h"
+#include "kernel.h"
 #include "anonsend-relay.h"
 #include "activemasternode.h"
 #include "masternode-payments.h"
@@ -23,6 +24,7 @@
 #include "masternodeman.h"
 #include "masternodeconfig.h"
 #include "spork.h"
+#include "fasttx.h"
 #include "smessage.h"
 
 #ifdef ENABLE_WALLET
@@ -131,6 +133,11 @@ void Shutdown()
         if (pwalletMain)
             pwalletMain->SetBestChain(CBlockLocator(pindexBest));
 #endif
+        if (pindexBest && GetBoolArg("-blockindexsnapshot", true))
+        {
+            CTxDB txdb("r");
+            txdb.WriteBlockIndexSnapshot();
+        }
     }
 #ifdef ENABLE_WALLET
     if (pwalletMain)
@@ -194,6 +201,15 @@ std::string HelpMessage()
     strUsage += "  -datadir=<dir>         " + _("Specify data directory") + "\n";
     strUsage += "  -wallet=<dir>          " + _("Specify wallet file (within data directory)") + "\n";
     strUsage += "  -dbcache=<n>           " + _("Set database cache size in megabytes (default: 100)") + "\n";
+    strUsage += "  -dbwritebuffer=<n>     " + _("Set LevelDB write buffer size in megabytes (default: 4)") + "\n";
+    strUsage += "  -dbmaxopenfiles=<n>    " + _("Limit the number of files LevelDB keeps open (default: 64)") + "\n";
+    strUsage += "  -dbblocksize=<n>       " + _("Set LevelDB block size in kilobytes (default: 4)") + "\n";
+    strUsage += "  -dbcompression         " + _("Compress LevelDB blocks with snappy (default: 1)") + "\n";
+    strUsage += "  -dbbulkload            " + _("Use bulk-load LevelDB settings (default: 1 for a new database, -loadblock, bootstrap.dat or -reindexaddr)") + "\n";
+    strUsage += "  -dbbulkwritebuffer=<n> " + _("Set LevelDB write buffer size in megabytes while bulk loading (default: 64)") + "\n";
+    strUsage += "  -dbcompactblocks=<n>   " + _("Compact LevelDB every <n> blocks while bulk loading, 0 = only at the end (default: 50000)") + "\n";
+    strUsage += "  -maxsigcachesize=<n>   " + strprintf(_("Limit size of signature cache to <n> megabytes (default: %u)"), DEFAULT_MAX_SIG_CACHE_SIZE) + "\n";
+    strUsage += "  -par=<n>               " + strprintf(_("Set the number of script and FastTx vote verification threads (up to %d, 0 = auto, <0 = leave that many cores free, default: %d)"), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS) + "\n";
     strUsage += "  -dblogsize=<n>         " + _("Set database disk log size in megabytes (default: 100)") + "\n";
     strUsage += "  -timeout=<n>           " + _("Specify connection timeout in milliseconds (default: 5000)") + "\n";
     strUsage += "  -proxy=<ip:port>       " + _("Connect through SOCKS5 proxy") + "\n";
@@ -225,6 +241,7 @@ std::string HelpMessage()
 #endif
     strUsage += "  -paytxfee=<amt>        " + _("Fee per KB to add to transactions you send") + "\n";
     strUsage += "  -mininput=<amt>        " + _("When creating transactions, ignore inputs with value less than this (default: 0.01)") + "\n";
+    strUsage += "  -stakethreads=<n>      " + strprintf(_("Set the number of threads searching for stake kernels (up to %d, 0 = auto, <0 = leave that many cores free, default: %d)"), MAX_STAKE_SEARCH_THREADS, DEFAULT_STAKE_SEARCH_THREADS) + "\n";
     if (fHaveGUI)
         strUsage += "  -server                " + _("Accept command line and JSON-RPC commands") + "\n";
 #if !defined(WIN32)
@@ -268,6 +285,10 @@ std::string HelpMessage()
     strUsage += "  -checkblocks=<n>       " + _("How many blocks to check at startup (default: 500, 0 = all)") + "\n";
     strUsage += "  -checklevel=<n>        " + _("How thorough the block verification is (0-6, default: 1)") + "\n";
     strUsage += "  -loadblock=<file>      " + _("Imports blocks from external blk000?.dat file") + "\n";
+    strUsage += "  -stopafterblockimport  " + _("Stop running after importing blocks from disk (default: 0)") + "\n";
+    strUsage += "  -benchmark             " + _("Show benchmark information (default: 0)") + "\n";
+    strUsage += "  -blockindexsnapshot    " + _("Write the block index to a snapshot file at shutdown and load it at the next startup (default: 1)") + "\n";
+    strUsage += "  -mmapblocks            " + strprintf(_("Read blocks through memory mapped block files (default: %u)"), DEFAULT_MMAP_BLOCK_FILES) + "\n";
     strUsage += "  -maxorphanblocks=<n>   " + strprintf(_("Keep at most <n> unconnectable blocks in memory (default: %u)"), DEFAULT_MAX_ORPHAN_BLOCKS) + "\n";
 
     strUsage += "\n" + _("Block creation options:") + "\n";
@@ -504,6 +525,27 @@ bool AppInit2(boost::thread_group& threadGroup)
 
     fConfChange = GetBoolArg("-confchange", false);
 
+    fBenchmark = GetBoolArg("-benchmark", false);
+    fMapBlockFiles = GetBoolArg("-mmapblocks", DEFAULT_MMAP_BLOCK_FILES);
+
+    // -par=0 means autodetect, but nScriptCheckThreads==0 means no concurrency
+    nScriptCheckThreads = GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
+    if (nScriptCheckThreads <= 0)
+        nScriptCheckThreads += boost::thread::hardware_concurrency();
+    if (nScriptCheckThreads <= 1)
+        nScriptCheckThreads = 0;
+    else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
+        nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
+
+    // Same convention as -par, nStakeSearchThreads==0 means the staking thread searches alone
+    nStakeSearchThreads = GetArg("-stakethreads", DEFAULT_STAKE_SEARCH_THREADS);
+    if (nStakeSearchThreads <= 0)
+        nStakeSearchThreads += boost::thread::hardware_concurrency();
+    if (nStakeSearchThreads <= 1)
+        nStakeSearchThreads = 0;
+    else if (nStakeSearchThreads > MAX_STAKE_SEARCH_THREADS)
+        nStakeSearchThreads = MAX_STAKE_SEARCH_THREADS;
+
 #ifdef ENABLE_WALLET
     if (mapArgs.count("-mininput"))
     {
@@ -543,10 +585,20 @@ bool AppInit2(boost::thread_group& threadGroup)
     LogPrintf("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
     LogPrintf("MarteX version %s (%s)\n", FormatFullVersion(), CLIENT_DATE);
     LogPrintf("Using OpenSSL version %s\n", SSLeay_version(SSLEAY_VERSION));
+    LogPrintf("Using SHA256 implementation %s\n", SHA256Implementation());
     if (!fLogTimestamps)
         LogPrintf("Startup time: %s\n", DateTimeStrFormat("%x %H:%M:%S", GetTime()));
     LogPrintf("Default data directory %s\n", GetDefaultDataDir().string());
     LogPrintf("Used data directory %s\n", strDataDir);
+
+    if (nScriptCheckThreads) {
+        LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadScriptCheck);
+        // FastTx consensus votes are verified by a pool of the same size
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadConsensusVoteCheck);
+    }
     std::ostringstream strErrors;
 
     if (mapArgs.count("-masternodepaymentskey")) // masternode payments priv key
@@ -848,7 +900,7 @@ bool AppInit2(boost::thread_group& threadGroup)
     {
         string strMatch = mapArgs["-printblock"];
         int nFound = 0;
-        for (map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.begin(); mi != mapBlockIndex.end(); ++mi)
+        for (BlockMap::iterator mi = mapBlockIndex.begin(); mi != mapBlockIndex.end(); ++mi)
         {
             uint256 hash = (*mi).first;
             if (strncmp(hash.ToString().c_str(), strMatch.c_str(), strMatch.size()) == 0)
@@ -1119,20 +1171,58 @@ bool AppInit2(boost::thread_group& threadGroup)
     RandAddSeedPerfmon();
 
     // reindex addresses found in blockchain
-    if(GetBoolArg("-reindexaddr", false))
     {
-        uiInterface.InitMessage(_("Rebuilding address index..."));
-        CBlockIndex *pblockAddrIndex = pindexBest;
-	CTxDB txdbAddr("rw");
-	while(pblockAddrIndex)
-	{
-	    uiInterface.InitMessage(strprintf("Rebuilding address index, block %i", pblockAddrIndex->nHeight));
-	    bool ReadFromDisk(const CBlockIndex* pindex, bool fReadTransactions=true);
-	    CBlock pblockAddr;
-	    if(pblockAddr.ReadFromDisk(pblockAddrIndex, true))
-	        pblockAddr.RebuildAddressIndex(txdbAddr);
-	    pblockAddrIndex = pblockAddrIndex->pprev;
-	}
+        CTxDB txdbAddr("rw");
+        int nAddrIndexVersion;
+        txdbAddr.ReadAddrIndexVersion(nAddrIndexVersion);
+        bool fAddrIndexArg = GetBoolArg("-addrindex", false);
+        bool fReindexAddr = GetBoolArg("-reindexaddr", false);
+        if (!fAddrIndexArg)
+        {
+            // blocks connected from now on are not indexed
+            if (nAddrIndexVersion != 0)
+                txdbAddr.EraseAddrIndexVersion();
+        }
+        else if (nAddrIndexVersion != ADDR_INDEX_VERSION && !fReindexAddr)
+        {
+            LogPrintf("Address index is missing or has an old layout (version %d), rebuilding it\n", nAddrIndexVersion);
+            fReindexAddr = true;
+        }
+
+        if (fReindexAddr)
+        {
+            uiInterface.InitMessage(_("Rebuilding address index..."));
+            txdbAddr.EraseAddrIndexVersion();
+            if (!txdbAddr.EraseLegacyAddrIndex())
+                return InitError(_("Error erasing the old address index"));
+
+            bool fComplete = true;
+            CBlockIndex *pblockAddrIndex = pindexBest;
+            while(pblockAddrIndex)
+            {
+                uiInterface.InitMessage(strprintf("Rebuilding address index, block %i", pblockAddrIndex->nHeight));
+                CBlock pblockAddr;
+                if(pblockAddr.ReadFromDisk(pblockAddrIndex, true))
+                {
+                    txdbAddr.TxnBegin();
+                    if (!pblockAddr.UpdateAddressIndex(txdbAddr, pblockAddrIndex->nHeight))
+                    {
+                        txdbAddr.TxnAbort();
+                        LogPrintf("Rebuilding address index failed at block %i\n", pblockAddrIndex->nHeight);
+                        fComplete = false;
+                    }
+                    else
+                        txdbAddr.TxnCommit();
+                }
+                else
+                    fComplete = false;
+                pblockAddrIndex = pblockAddrIndex->pprev;
+            }
+
+            // an incomplete index is rebuilt again at the next start
+            if (fComplete && fAddrIndexArg)
+                txdbAddr.WriteAddrIndexVersion(ADDR_INDEX_VERSION);
+        }
     }
 
     //// debug print
@@ -1157,7 +1247,14 @@ bool AppInit2(boost::thread_group& threadGroup)
     if (!GetBoolArg("-staking", true))
         LogPrintf("Staking disabled\n");
     else if (pwalletMain)
+    {
         threadGroup.create_thread(boost::bind(&ThreadStakeMiner, pwalletMain));
+        if (nStakeSearchThreads) {
+            LogPrintf("Using %u threads for stake kernel search\n", nStakeSearchThreads);
+            for (int i=0; i<nStakeSearchThreads-1; i++)
+                threadGroup.create_thread(&ThreadStakeSearch);
+        }
+    }
 #endif
 
     // ********************************************************* Step 12: finished
@@ -5,6 +5,9 @@
 
 #include <boost/assign/list_of.hpp>
 
+#include "arith_uint256.h"
+#include "checkqueue.h"
+#include "crypto/sha256.h"
 #include "kernel.h"
 #include "txdb.h"
 
@@ -205,6 +208,31 @@ uint256 ComputeStakeModifierV2(const CBlockIndex* pindexPrev, const uint256& ker
     return Hash(ss.begin(), ss.end());
 }
 
+// Append raw bytes to a kernel hash buffer
+static inline unsigned char* KernelWrite(unsigned char* pch, const void* pv, size_t nSize)
+{
+    memcpy(pch, pv, nSize);
+    return pch + nSize;
+}
+
+// Stake target of a coin: the base target of nBits times the coin value.
+// A product past 256 bits is met by any hash, so saturate instead of letting
+// it wrap.
+static bool GetKernelTarget(unsigned int nBits, int64_t nValueIn, arith_uint256& bnTarget)
+{
+    bool fNegative, fOverflow;
+    bnTarget.SetCompact(nBits, &fNegative, &fOverflow);
+    if (fNegative || fOverflow || bnTarget == 0)
+        return false;
+
+    arith_uint256 bnWeight((uint64_t)nValueIn);
+    if (bnTarget.bits() + bnWeight.bits() > 256 && bnTarget > ~arith_uint256(0) / bnWeight)
+        bnTarget = ~arith_uint256(0);
+    else
+        bnTarget *= bnWeight;
+    return true;
+}
+
 // MarteX kernel protocol
 // coinstake must meet hash target according to the protocol:
 // kernel (input 0) must meet the formula
@@ -227,41 +255,45 @@ uint256 ComputeStakeModifierV2(const CBlockIndex* pindexPrev, const uint256& ker
 //   quantities so as to generate blocks faster, degrading the system back into
 //   a proof-of-work situation.
 //
-bool CheckStakeKernelHash(CBlockIndex* pindexPrev, unsigned int nBits, unsigned int nTimeBlockFrom, const CTransaction& txPrev, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake, uint256& targetProofOfStake, bool fPrintProofOfStake)
+static bool CheckStakeKernelHash(CBlockIndex* pindexPrev, unsigned int nBits, unsigned int nTimeBlockFrom, unsigned int nTimeTxPrev, int64_t nValueIn, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake, uint256& targetProofOfStake, bool fPrintProofOfStake)
 {
-    if (nTimeTx < txPrev.nTime)  // Transaction timestamp violation
+    if (nTimeTx < nTimeTxPrev)  // Transaction timestamp violation
         return error("CheckStakeKernelHash() : nTime violation");
 
-    if(!IsProtocolV3(txPrev.nTime)){
+    if(!IsProtocolV3(nTimeTxPrev)){
         if (nTimeBlockFrom + nStakeMinAge > nTimeTx) // Min age requirement
             return error("CheckStakeKernelHash() : min age violation");
     }
 
-    // Base target
-    CBigNum bnTarget;
-    bnTarget.SetCompact(nBits);
+    // Base target weighted by the value of the coin
+    arith_uint256 bnTarget;
+    if (!GetKernelTarget(nBits, nValueIn, bnTarget))
+        return error("CheckStakeKernelHash() : invalid nBits %08x", nBits);
 
-    // Weighted target
-    int64_t nValueIn = txPrev.vout[prevout.n].nValue;
-    CBigNum bnWeight = CBigNum(nValueIn);
-    bnTarget *= bnWeight;
-
-    targetProofOfStake = bnTarget.getuint256();
+    targetProofOfStake = ArithToUint256(bnTarget);
 
     uint64_t nStakeModifier = pindexPrev->nStakeModifier;
     uint256 bnStakeModifierV2 = pindexPrev->bnStakeModifierV2;
     int nStakeModifierHeight = pindexPrev->nHeight;
     int64_t nStakeModifierTime = pindexPrev->nTime;
 
-    // Calculate hash
-    CDataStream ss(SER_GETHASH, 0);
+    // Calculate hash over the same bytes CDataStream would serialize, built
+    // on the stack since this runs for every coin and timestamp tried
+    unsigned char pchKernel[sizeof(bnStakeModifierV2) + 4 * sizeof(uint32_t) + sizeof(prevout.hash)];
+    unsigned char* pch = pchKernel;
 
     if (IsProtocolV3(nTimeTx))
-        ss << bnStakeModifierV2;
+        pch = KernelWrite(pch, bnStakeModifierV2.begin(), sizeof(bnStakeModifierV2));
     else
-        ss << nStakeModifier << nTimeBlockFrom;
-    ss << txPrev.nTime << prevout.hash << prevout.n << nTimeTx;
-    hashProofOfStake = Hash(ss.begin(), ss.end());
+    {
+        pch = KernelWrite(pch, &nStakeModifier, sizeof(nStakeModifier));
+        pch = KernelWrite(pch, &nTimeBlockFrom, sizeof(nTimeBlockFrom));
+    }
+    pch = KernelWrite(pch, &nTimeTxPrev, sizeof(nTimeTxPrev));
+    pch = KernelWrite(pch, prevout.hash.begin(), sizeof(prevout.hash));
+    pch = KernelWrite(pch, &prevout.n, sizeof(prevout.n));
+    pch = KernelWrite(pch, &nTimeTx, sizeof(nTimeTx));
+    hashProofOfStake = Hash(pchKernel, pch);
 
     if (fPrintProofOfStake)
     {
@@ -271,12 +303,12 @@ bool CheckStakeKernelHash(CBlockIndex* pindexPrev, unsigned int nBits, unsigned
             DateTimeStrFormat(nTimeBlockFrom));
         LogPrintf("CheckStakeKernelHash() : check modifier=0x%016x nTimeBlockFrom=%u nTimeTxPrev=%u nPrevout=%u nTimeTx=%u hashProof=%s\n",
             nStakeModifier,
-            nTimeBlockFrom, txPrev.nTime, prevout.n, nTimeTx,
+            nTimeBlockFrom, nTimeTxPrev, prevout.n, nTimeTx,
             hashProofOfStake.ToString());
     }
 
     // Now check if proof-of-stake hash meets target protocol
-    if (CBigNum(hashProofOfStake) > bnTarget){
+    if (UintToArith256(hashProofOfStake) > bnTarget){
          return false;
     }
 
@@ -288,13 +320,18 @@ bool CheckStakeKernelHash(CBlockIndex* pindexPrev, unsigned int nBits, unsigned
             DateTimeStrFormat(nTimeBlockFrom));
         LogPrintf("CheckStakeKernelHash() : pass modifier=0x%016x nTimeBlockFrom=%u nTimeTxPrev=%u nPrevout=%u nTimeTx=%u hashProof=%s\n",
             nStakeModifier,
-            nTimeBlockFrom, txPrev.nTime, prevout.n, nTimeTx,
+            nTimeBlockFrom, nTimeTxPrev, prevout.n, nTimeTx,
             hashProofOfStake.ToString());
     }
 
     return true;
 }
 
+bool CheckStakeKernelHash(CBlockIndex* pindexPrev, unsigned int nBits, unsigned int nTimeBlockFrom, const CTransaction& txPrev, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake, uint256& targetProofOfStake, bool fPrintProofOfStake)
+{
+    return CheckStakeKernelHash(pindexPrev, nBits, nTimeBlockFrom, txPrev.nTime, txPrev.vout[prevout.n].nValue, prevout, nTimeTx, hashProofOfStake, targetProofOfStake, fPrintProofOfStake);
+}
+
 // Check kernel hash target and coinstake signature
 bool CheckProofOfStake(CBlockIndex* pindexPrev, const CTransaction& tx, unsigned int nBits, uint256& hashProofOfStake, uint256& targetProofOfStake)
 {
@@ -340,35 +377,254 @@ bool CheckCoinStakeTimestamp(int nHeight, int64_t nTimeBlock, int64_t nTimeTx)
         return (nTimeBlock == nTimeTx) && ((nTimeTx & STAKE_TIMESTAMP_MASK) == 0);
 }
 
-bool CheckKernel(CBlockIndex* pindexPrev, unsigned int nBits, int64_t nTime, const COutPoint& prevout, int64_t* pBlockTime)
+bool GetStakeCandidate(CTxDB& txdb, const CBlockIndex* pindexPrev, const COutPoint& prevout, CStakeCandidate& candidate)
 {
-    uint256 hashProofOfStake, targetProofOfStake;
-
-    CTxDB txdb("r");
     CTransaction txPrev;
     CTxIndex txindex;
     if (!txPrev.ReadFromDisk(txdb, prevout, txindex))
         return false;
+    if (prevout.n >= txPrev.vout.size())
+        return false;
 
     // Read block header
     CBlock block;
     if (!block.ReadFromDisk(txindex.pos.nFile, txindex.pos.nBlockPos, false))
         return false;
 
+    int nDepth;
+    candidate.nTimeTxPrev = txPrev.nTime;
+    candidate.nTimeBlockFrom = block.GetBlockTime();
+    candidate.nValue = txPrev.vout[prevout.n].nValue;
+    candidate.fMinConfirmations = !IsConfirmedInNPrevBlocks(txindex, pindexPrev, nStakeMinConfirmations - 1, nDepth);
+    return true;
+}
+
+bool CheckKernel(CBlockIndex* pindexPrev, unsigned int nBits, int64_t nTime, const COutPoint& prevout, const CStakeCandidate& candidate)
+{
+    uint256 hashProofOfStake, targetProofOfStake;
+
     if (IsProtocolV3(nTime))
     {
-        int nDepth;
-        if (IsConfirmedInNPrevBlocks(txindex, pindexPrev, nStakeMinConfirmations - 1, nDepth))
+        if (!candidate.fMinConfirmations)
             return false;
     }
     else
     {
-        if (block.GetBlockTime() + nStakeMinAge > nTime)
+        if (candidate.nTimeBlockFrom + nStakeMinAge > nTime)
             return false; // only count coins meeting min age requirement
     }
 
+    return CheckStakeKernelHash(pindexPrev, nBits, candidate.nTimeBlockFrom, candidate.nTimeTxPrev, candidate.nValue, prevout, nTime, hashProofOfStake, targetProofOfStake, false);
+}
+
+bool CheckKernel(CBlockIndex* pindexPrev, unsigned int nBits, int64_t nTime, const COutPoint& prevout, int64_t* pBlockTime)
+{
+    CTxDB txdb("r");
+    CStakeCandidate candidate;
+    if (!GetStakeCandidate(txdb, pindexPrev, prevout, candidate))
+        return false;
+
     if (pBlockTime)
-        *pBlockTime = block.GetBlockTime();
+        *pBlockTime = candidate.nTimeBlockFrom;
+
+    return CheckKernel(pindexPrev, nBits, nTime, prevout, candidate);
+}
+
+int nStakeSearchThreads = 0;
+
+// Protocol v3 kernel: bnStakeModifierV2, txPrev.nTime and the first 28 bytes
+// of prevout.hash fill the first SHA-256 block, which is the same for every
+// timestamp tried. The rest of prevout.hash, prevout.n and nTimeTx follow.
+static const size_t KERNEL_V3_TAIL_SIZE = 12;
+
+// Search nTimeTx - n for 0 <= n < nCount, latest first, for a kernel of one
+// coin. The shared first block is compressed once and the timestamps are
+// hashed KERNEL_SEARCH_BATCH at a time.
+static bool SearchKernel(CBlockIndex* pindexPrev, unsigned int nBits, unsigned int nTimeTx, unsigned int nCount,
+                         const COutPoint& prevout, const CStakeCandidate& candidate, unsigned int& nOffsetRet)
+{
+    arith_uint256 bnTarget;
+    if (!GetKernelTarget(nBits, candidate.nValue, bnTarget))
+        return false;
+
+    unsigned char pchPrefix[64];
+    memcpy(pchPrefix, pindexPrev->bnStakeModifierV2.begin(), 32);
+    memcpy(pchPrefix + 32, &candidate.nTimeTxPrev, 4);
+    memcpy(pchPrefix + 36, prevout.hash.begin(), 28);
+    uint32_t midstate[8];
+    CSHA256 sha;
+    sha.Write(pchPrefix, sizeof(pchPrefix));
+    sha.Midstate(midstate);
+
+    unsigned char pchTails[KERNEL_SEARCH_BATCH * KERNEL_V3_TAIL_SIZE];
+    unsigned char pchHashes[KERNEL_SEARCH_BATCH * 32];
+    unsigned int vOffsets[KERNEL_SEARCH_BATCH];
+    unsigned int n = 0;
+    while (n < nCount)
+    {
+        int nBatch = 0;
+        for (; n < nCount && nBatch < KERNEL_SEARCH_BATCH; n++)
+        {
+            unsigned int nTime = nTimeTx - n;
+            if (nTime < candidate.nTimeTxPrev)
+            {
+                // Earlier timestamps only violate the tx time as well
+                n = nCount;
+                break;
+            }
+            if (!IsProtocolV3(nTime))
+            {
+                // Older kernels hash another layout; check them one at a
+                // time once the pending batch is done, keeping the order
+                if (nBatch > 0)
+                    break;
+                if (CheckKernel(pindexPrev, nBits, nTime, prevout, candidate))
+                {
+                    nOffsetRet = n;
+                    return true;
+                }
+                continue;
+            }
+            if (!candidate.fMinConfirmations)
+                continue;
+            if (!IsProtocolV3(candidate.nTimeTxPrev) && candidate.nTimeBlockFrom + nStakeMinAge > nTime)
+                continue;
+
+            unsigned char* pchTail = pchTails + nBatch * KERNEL_V3_TAIL_SIZE;
+            memcpy(pchTail, prevout.hash.begin() + 28, 4);
+            memcpy(pchTail + 4, &prevout.n, 4);
+            memcpy(pchTail + 8, &nTime, 4);
+            vOffsets[nBatch++] = n;
+        }
+        if (nBatch == 0)
+            continue;
+
+        SHA256DTailLanes(midstate, pchTails, KERNEL_V3_TAIL_SIZE, nBatch, pchHashes);
+        for (int i = 0; i < nBatch; i++)
+        {
+            uint256 hashProofOfStake;
+            memcpy(hashProofOfStake.begin(), pchHashes + i * 32, 32);
+            if (UintToArith256(hashProofOfStake) <= bnTarget)
+            {
+                nOffsetRet = vOffsets[i];
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/** Stake search shared by the kernel checks of one SearchStakeKernels() call */
+struct CKernelSearch
+{
+    CBlockIndex* pindexPrev;
+    unsigned int nBits;
+    unsigned int nTimeTx;
+    unsigned int nCount;
+    const std::vector<std::pair<COutPoint, CStakeCandidate> >* pvCandidates;
+
+    boost::mutex mutex;
+    size_t nIndex;          // first candidate found to have a kernel so far
+    unsigned int nOffset;
+};
+
+/** Search the timestamps of one candidate, as a CCheckQueue job */
+class CKernelCheck
+{
+private:
+    CKernelSearch* psearch;
+    size_t nIndex;
+
+public:
+    CKernelCheck() : psearch(NULL), nIndex(0) {}
+    CKernelCheck(CKernelSearch* psearchIn, size_t nIndexIn) : psearch(psearchIn), nIndex(nIndexIn) {}
+
+    bool operator()()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(psearch->mutex);
+            if (psearch->nIndex < nIndex)
+                return true; // an earlier candidate already has a kernel
+        }
+        // pindexBest is written under cs_main, which the search does not
+        // hold; the active chain has its own lock
+        if (psearch->pindexPrev != chainActive.Tip())
+            return true; // stale, the caller gives up on this round
+
+        const std::pair<COutPoint, CStakeCandidate>& candidate = (*psearch->pvCandidates)[nIndex];
+        unsigned int nOffset;
+        if (SearchKernel(psearch->pindexPrev, psearch->nBits, psearch->nTimeTx, psearch->nCount, candidate.first, candidate.second, nOffset))
+        {
+            boost::unique_lock<boost::mutex> lock(psearch->mutex);
+            if (nIndex < psearch->nIndex)
+            {
+                psearch->nIndex = nIndex;
+                psearch->nOffset = nOffset;
+            }
+        }
+        return true;
+    }
+
+    void swap(CKernelCheck& check)
+    {
+        std::swap(psearch, check.psearch);
+        std::swap(nIndex, check.nIndex);
+    }
+};
+
+static CCheckQueue<CKernelCheck> kernelcheckqueue(1);
+static CCriticalSection cs_kernelcheckqueue;
+
+void ThreadStakeSearch()
+{
+    RenameThread("MarteX-stakesrch");
+    kernelcheckqueue.Thread();
+}
+
+bool SearchStakeKernels(CBlockIndex* pindexPrev, unsigned int nBits, unsigned int nTimeTx, unsigned int nCount,
+                        const std::vector<std::pair<COutPoint, CStakeCandidate> >& vCandidates, size_t nStart,
+                        size_t& nIndexRet, unsigned int& nOffsetRet)
+{
+    if (nStakeSearchThreads == 0 || vCandidates.size() < nStart + 2)
+    {
+        for (size_t i = nStart; i < vCandidates.size() && pindexPrev == chainActive.Tip(); i++)
+        {
+            boost::this_thread::interruption_point();
+            if (SearchKernel(pindexPrev, nBits, nTimeTx, nCount, vCandidates[i].first, vCandidates[i].second, nOffsetRet))
+            {
+                nIndexRet = i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    CKernelSearch search;
+    search.pindexPrev = pindexPrev;
+    search.nBits = nBits;
+    search.nTimeTx = nTimeTx;
+    search.nCount = nCount;
+    search.pvCandidates = &vCandidates;
+    search.nIndex = vCandidates.size();
+    search.nOffset = 0;
+
+    // The queue hands out jobs last in first out; queue the candidates in
+    // reverse so the ones the caller prefers are searched first
+    std::vector<CKernelCheck> vChecks;
+    vChecks.reserve(vCandidates.size() - nStart);
+    for (size_t i = vCandidates.size(); i > nStart; i--)
+        vChecks.push_back(CKernelCheck(&search, i - 1));
 
-    return CheckStakeKernelHash(pindexPrev, nBits, block.GetBlockTime(), txPrev, prevout, nTime, hashProofOfStake, targetProofOfStake);
+    {
+        LOCK(cs_kernelcheckqueue);
+        CCheckQueueControl<CKernelCheck> control(&kernelcheckqueue);
+        control.Add(vChecks);
+        control.Wait();
+    }
+
+    if (search.nIndex == vCandidates.size() || pindexPrev != chainActive.Tip())
+        return false;
+    nIndexRet = search.nIndex;
+    nOffsetRet = search.nOffset;
+    return true;
 }
@@ -6,6 +6,8 @@
 
 #include "main.h"
 
+class CTxDB;
+
 // To decrease granularity of timestamp
 // Supposed to be 2^n-1
 static const int STAKE_TIMESTAMP_MASK = 15;
@@ -37,4 +39,43 @@ int64_t GetWeight(int64_t nIntervalBeginning, int64_t nIntervalEnd);
 // Convenient for searching a kernel
 bool CheckKernel(CBlockIndex* pindexPrev, unsigned int nBits, int64_t nTime, const COutPoint& prevout, int64_t* pBlockTime = NULL);
 
+/** Everything the kernel hash needs to know about a staked coin besides the
+ *  timestamp being tried. Depends on the chain tip it was looked up for. */
+struct CStakeCandidate
+{
+    unsigned int nTimeTxPrev;   // timestamp of the transaction being spent
+    unsigned int nTimeBlockFrom; // timestamp of the block containing it
+    int64_t nValue;
+    bool fMinConfirmations;     // at least nStakeMinConfirmations deep on top of pindexPrev
+
+    CStakeCandidate() : nTimeTxPrev(0), nTimeBlockFrom(0), nValue(0), fMinConfirmations(false) {}
+};
+
+// Read the kernel inputs of prevout from disk, relative to pindexPrev
+bool GetStakeCandidate(CTxDB& txdb, const CBlockIndex* pindexPrev, const COutPoint& prevout, CStakeCandidate& candidate);
+
+// CheckKernel() for a coin whose inputs were already looked up; only hashes
+bool CheckKernel(CBlockIndex* pindexPrev, unsigned int nBits, int64_t nTime, const COutPoint& prevout, const CStakeCandidate& candidate);
+
+/** Maximum number of threads searching for stake kernels, including the staking thread */
+static const int MAX_STAKE_SEARCH_THREADS = 8;
+/** -stakethreads default, 0 = one per core */
+static const int DEFAULT_STAKE_SEARCH_THREADS = 0;
+/** Timestamps hashed together per coin during a kernel search */
+static const int KERNEL_SEARCH_BATCH = 16;
+
+/** Threads searching for stake kernels, including the staking thread; 0 = the staking thread alone */
+extern int nStakeSearchThreads;
+
+void ThreadStakeSearch();
+
+// Search the timestamps nTimeTx - n, 0 <= n < nCount, of the candidates from
+// nStart on for a stake kernel, spread over the stake search threads.
+// Returns the first candidate with a kernel and the offset of its latest
+// timestamp meeting the target. Gives up once pindexPrev is no longer the
+// tip of chainActive, which the workers can read without cs_main.
+bool SearchStakeKernels(CBlockIndex* pindexPrev, unsigned int nBits, unsigned int nTimeTx, unsigned int nCount,
+                        const std::vector<std::pair<COutPoint, CStakeCandidate> >& vCandidates, size_t nStart,
+                        size_t& nIndexRet, unsigned int& nOffsetRet);
+
 #endif // PPCOIN_KERNEL_H
@@ -0,0 +1,65 @@
+// Copyright (c) 2014-2018 The MarteX developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_LEVELDBBATCH_H
+#define BITCOIN_LEVELDBBATCH_H
+
+#include <string>
+#include <utility>
+
+#include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <leveldb/write_batch.h>
+
+/** A leveldb::WriteBatch together with an index of the writes queued in it.
+ *  Readers that must see their own uncommitted writes look keys up in the
+ *  index instead of iterating the whole batch, so a lookup costs the same
+ *  however many writes are pending.
+ */
+class CLevelDBBatch : private boost::noncopyable
+{
+private:
+    leveldb::WriteBatch batch;
+
+    // key -> (deleted, value) of the last write queued for that key
+    typedef boost::unordered_map<std::string, std::pair<bool, std::string> > PendingMap;
+    PendingMap mapPending;
+
+public:
+    void Put(const std::string& key, const std::string& value)
+    {
+        batch.Put(key, value);
+        std::pair<bool, std::string>& entry = mapPending[key];
+        entry.first = false;
+        entry.second = value;
+    }
+
+    void Delete(const std::string& key)
+    {
+        batch.Delete(key);
+        std::pair<bool, std::string>& entry = mapPending[key];
+        entry.first = true;
+        entry.second.clear();
+    }
+
+    /** Returns true if a write for key is pending. A pending put sets value
+        and deleted = false, a pending delete leaves value alone and sets
+        deleted = true. */
+    bool Lookup(const std::string& key, std::string* value, bool* deleted) const
+    {
+        PendingMap::const_iterator it = mapPending.find(key);
+        if (it == mapPending.end())
+            return false;
+        *deleted = it->second.first;
+        if (!*deleted)
+            *value = it->second.second;
+        return true;
+    }
+
+    size_t size() const { return mapPending.size(); }
+
+    leveldb::WriteBatch* GetWriteBatch() { return &batch; }
+};
+
+#endif // BITCOIN_LEVELDBBATCH_H
@@ -6,10 +6,12 @@
 #include "main.h"
 
 #include "addrman.h"
+#include "arith_uint256.h"
 #include "alert.h"
 #include "blocksizecalculator.h"
 #include "chainparams.h"
 #include "checkpoints.h"
+#include "checkqueue.h"
 #include "db.h"
 #include "init.h"
 #include "kernel.h"
@@ -47,7 +49,8 @@ CCriticalSection cs_main;
 
 CTxMemPool mempool;
 
-map<uint256, CBlockIndex*> mapBlockIndex;
+BlockMap mapBlockIndex;
+CSlabArena<CBlockIndex> arenaBlockIndex;
 set<pair<COutPoint, unsigned int> > setStakeSeen;
 
 CBlockIndex* pindexGenesisBlock = NULL;
@@ -56,11 +59,17 @@ uint256 nBestChainTrust = 0;
 uint256 nBestInvalidTrust = 0;
 uint256 hashBestChain = 0;
 CBlockIndex* pindexBest = NULL;
+CChain chainActive;
 int64_t nTimeBestReceived = 0;
 bool fImporting = false;
 bool fReindex = false;
+int nScriptCheckThreads = 0;
+bool fBenchmark = false;
+bool fMapBlockFiles = DEFAULT_MMAP_BLOCK_FILES;
 bool fAddrIndex = false;
 bool fHaveGUI = false;
+boost::atomic<uint64_t> nTxHashRequests(0);
+boost::atomic<uint64_t> nTxHashComputations(0);
 
 struct COrphanBlock {
     uint256 hashBlock;
@@ -326,6 +335,7 @@ void RegisterNodeSignals(CNodeSignals& nodeSignals)
     nodeSignals.GetHeight.connect(&GetHeight);
     nodeSignals.ProcessMessages.connect(&ProcessMessages);
     nodeSignals.SendMessages.connect(&SendMessages);
+    nodeSignals.FlushMessages.connect(&ProcessQueuedConsensusVotes);
     nodeSignals.InitializeNode.connect(&InitializeNode);
     nodeSignals.FinalizeNode.connect(&FinalizeNode);
 }
@@ -335,6 +345,7 @@ void UnregisterNodeSignals(CNodeSignals& nodeSignals)
     nodeSignals.GetHeight.disconnect(&GetHeight);
     nodeSignals.ProcessMessages.disconnect(&ProcessMessages);
     nodeSignals.SendMessages.disconnect(&SendMessages);
+    nodeSignals.FlushMessages.disconnect(&ProcessQueuedConsensusVotes);
     nodeSignals.InitializeNode.disconnect(&InitializeNode);
     nodeSignals.FinalizeNode.disconnect(&FinalizeNode);
 }
@@ -424,9 +435,44 @@ unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans)
 // CTransaction and CTxIndex
 //
 
+CMutableTransaction::CMutableTransaction() : nVersion(CTransaction::CURRENT_VERSION), nTime(GetAdjustedTime()), nLockTime(0) {}
+CMutableTransaction::CMutableTransaction(const CTransaction& tx) : nVersion(tx.nVersion), nTime(tx.nTime), vin(tx.vin), vout(tx.vout), nLockTime(tx.nLockTime) {}
+
+uint256 CMutableTransaction::GetHash() const
+{
+    return SerializeHash(*this);
+}
+
+void CTransaction::UpdateHash() const
+{
+    *const_cast<uint256*>(&hash) = SerializeHash(*this);
+    nTxHashComputations.fetch_add(1, boost::memory_order_relaxed);
+}
+
+CTransaction::CTransaction() : hash(0), nVersion(CTransaction::CURRENT_VERSION), nTime(GetAdjustedTime()), vin(), vout(), nLockTime(0), nDoS(0) { }
+
+CTransaction::CTransaction(const CMutableTransaction& tx) : nVersion(tx.nVersion), nTime(tx.nTime), vin(tx.vin), vout(tx.vout), nLockTime(tx.nLockTime), nDoS(0)
+{
+    UpdateHash();
+}
+
+CTransaction::CTransaction(const CTransaction& tx) : hash(tx.hash), nVersion(tx.nVersion), nTime(tx.nTime), vin(tx.vin), vout(tx.vout), nLockTime(tx.nLockTime), nDoS(tx.nDoS) { }
+
+CTransaction& CTransaction::operator=(const CTransaction& tx)
+{
+    *const_cast<int*>(&nVersion) = tx.nVersion;
+    *const_cast<unsigned int*>(&nTime) = tx.nTime;
+    *const_cast<std::vector<CTxIn>*>(&vin) = tx.vin;
+    *const_cast<std::vector<CTxOut>*>(&vout) = tx.vout;
+    *const_cast<unsigned int*>(&nLockTime) = tx.nLockTime;
+    *const_cast<uint256*>(&hash) = tx.hash;
+    nDoS = tx.nDoS;
+    return *this;
+}
+
 bool CTransaction::ReadFromDisk(CTxDB& txdb, const uint256& hash, CTxIndex& txindexRet)
 {
-    SetNull();
+    *this = CTransaction();
     if (!txdb.ReadTxIndex(hash, txindexRet))
         return false;
     if (!ReadFromDisk(txindexRet.pos))
@@ -440,7 +486,7 @@ bool CTransaction::ReadFromDisk(CTxDB& txdb, COutPoint prevout, CTxIndex& txinde
         return false;
     if (prevout.n >= vout.size())
     {
-        SetNull();
+        *this = CTransaction();
         return false;
     }
     return true;
@@ -714,7 +760,7 @@ int CMerkleTx::SetMerkleBranch(const CBlock* pblock)
     }
 
     // Is the tx in a block that's in the main chain
-    map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+    BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
     if (mi == mapBlockIndex.end())
         return 0;
     CBlockIndex* pindex = (*mi).second;
@@ -887,6 +933,7 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CTransaction &tx, bool fLimitFree,
     }
     }
 
+    CTxMemPoolEntry entry;
     {
         CTxDB txdb("r");
 
@@ -934,6 +981,21 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CTransaction &tx, bool fLimitFree,
         int64_t nFees = tx.GetValueIn(mapInputs)-tx.GetValueOut();
         unsigned int nSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
 
+        // Input age for block assembly priority; inputs still in the memory
+        // pool have no confirmations yet
+        double dInputPriority = 0;
+        int64_t nValueInChain = 0;
+        BOOST_FOREACH(const CTxIn& txin, tx.vin)
+        {
+            if (pool.exists(txin.prevout.hash))
+                continue;
+            const CTxIndex& txindex = mapInputs[txin.prevout.hash].first;
+            int64_t nValueIn = mapInputs[txin.prevout.hash].second.vout[txin.prevout.n].nValue;
+            dInputPriority += (double)nValueIn * txindex.GetDepthInMainChain();
+            nValueInChain += nValueIn;
+        }
+        entry = CTxMemPoolEntry(nFees, nSize, dInputPriority, nValueInChain, nBestHeight);
+
         // Don't accept it if it can't get into a block
         // but prioritise dstx and don't check fees for it
         if(mapAnonsendBroadcastTxes.count(hash)) {
@@ -998,10 +1060,11 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CTransaction &tx, bool fLimitFree,
     }
 
     // Store transaction in memory
-    pool.addUnchecked(hash, tx);
+    pool.addUnchecked(hash, tx, entry);
     setValidatedTx.insert(hash);
 
     SyncWithWallets(tx, NULL);
+    mnodeman.SyncTransaction(tx, true);
 
     LogPrint("mempool", "AcceptToMemoryPool : accepted %s (poolsz %u)\n",
            hash.ToString(),
@@ -1161,7 +1224,7 @@ int CMerkleTx::GetDepthInMainChainINTERNAL(CBlockIndex* &pindexRet) const
     AssertLockHeld(cs_main);
 
     // Find the block it claims to be in
-    map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+    BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
     if (mi == mapBlockIndex.end())
         return 0;
     CBlockIndex* pindex = (*mi).second;
@@ -1186,7 +1249,7 @@ int CMerkleTx::GetTransactionLockSignatures() const
     if(!fEnableFastTx) return -1;
 
     //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
+    TxLockMap::iterator i = mapTxLocks.find(GetHash());
     if (i != mapTxLocks.end()){
         return (*i).second.CountSignatures();
     }
@@ -1199,7 +1262,7 @@ bool CMerkleTx::IsTransactionLockTimedOut() const
     if(!fEnableFastTx) return -1;
 
     //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
+    TxLockMap::iterator i = mapTxLocks.find(GetHash());
     if (i != mapTxLocks.end()){
         return GetTime() > (*i).second.nTimeout;
     }
@@ -1293,7 +1356,7 @@ int GetInputAgeIX(uint256 nTXHash, CTxIn& vin)
     if(nResult < 0) nResult = 0;
 
     if (nResult < 6){
-        std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(nTXHash);
+        TxLockMap::iterator i = mapTxLocks.find(nTXHash);
         if (i != mapTxLocks.end()){
             sigs = (*i).second.CountSignatures();
         }
@@ -1309,7 +1372,7 @@ int GetIXConfirmations(uint256 nTXHash)
 {
     int sigs = 0;
 
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(nTXHash);
+    TxLockMap::iterator i = mapTxLocks.find(nTXHash);
     if (i != mapTxLocks.end()){
         sigs = (*i).second.CountSignatures();
     }
@@ -1327,7 +1390,7 @@ int CTxIndex::GetDepthInMainChain() const
     if (!block.ReadFromDisk(pos.nFile, pos.nBlockPos, false))
         return 0;
     // Find the block in the index
-    map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(block.GetHash());
+    BlockMap::iterator mi = mapBlockIndex.find(block.GetHash());
     if (mi == mapBlockIndex.end())
         return 0;
     CBlockIndex* pindex = (*mi).second;
@@ -1383,22 +1446,90 @@ bool GetTransaction(const uint256 &hash, CTransaction &tx, uint256 &hashBlock)
 // CBlock and CBlockIndex
 //
 
-static CBlockIndex* pblockindexFBBHLast;
+void CChain::SetTip(CBlockIndex* pindex)
+{
+    LOCK(cs);
+    if (pindex == NULL)
+    {
+        vChain.clear();
+        return;
+    }
+    vChain.resize(pindex->nHeight + 1);
+    while (pindex && vChain[pindex->nHeight] != pindex)
+    {
+        vChain[pindex->nHeight] = pindex;
+        pindex = pindex->pprev;
+    }
+}
+
+CBlockIndex* CChain::FindFork(CBlockIndex* pindex) const
+{
+    LOCK(cs);
+    if (pindex->nHeight > Height())
+        pindex = pindex->GetAncestor(Height());
+    while (pindex && !Contains(pindex))
+        pindex = pindex->pprev;
+    return pindex;
+}
+
+/** Turn the lowest '1' bit in the binary representation of a number into a '0'. */
+static inline int InvertLowestOne(int n) { return n & (n - 1); }
+
+/** Compute what height to jump back to with the pskip pointer. */
+static inline int GetSkipHeight(int nHeight)
+{
+    if (nHeight < 2)
+        return 0;
+
+    // Determine which height to jump back to. Any number strictly lower than
+    // nHeight is acceptable, but the following expression seems to perform
+    // well in simulations (max 110 steps to go back up to 2**18 blocks).
+    return (nHeight & 1) ? InvertLowestOne(InvertLowestOne(nHeight - 1)) + 1 : InvertLowestOne(nHeight);
+}
+
+CBlockIndex* CBlockIndex::GetAncestor(int nHeightIn)
+{
+    if (nHeightIn > nHeight || nHeightIn < 0)
+        return NULL;
+
+    CBlockIndex* pindexWalk = this;
+    int nHeightWalk = nHeight;
+    while (nHeightWalk > nHeightIn)
+    {
+        int nHeightSkip = GetSkipHeight(nHeightWalk);
+        int nHeightSkipPrev = GetSkipHeight(nHeightWalk - 1);
+        if (pindexWalk->pskip != NULL &&
+            (nHeightSkip == nHeightIn ||
+             (nHeightSkip > nHeightIn && !(nHeightSkipPrev < nHeightSkip - 2 &&
+                                           nHeightSkipPrev >= nHeightIn))))
+        {
+            // Only follow pskip if pprev->pskip isn't better than pskip->pprev.
+            pindexWalk = pindexWalk->pskip;
+            nHeightWalk = nHeightSkip;
+        }
+        else
+        {
+            pindexWalk = pindexWalk->pprev;
+            nHeightWalk--;
+        }
+    }
+    return pindexWalk;
+}
+
+const CBlockIndex* CBlockIndex::GetAncestor(int nHeightIn) const
+{
+    return const_cast<CBlockIndex*>(this)->GetAncestor(nHeightIn);
+}
+
+void CBlockIndex::BuildSkip()
+{
+    if (pprev)
+        pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
+}
+
 CBlockIndex* FindBlockByHeight(int nHeight)
 {
-    CBlockIndex *pblockindex;
-    if (nHeight < nBestHeight / 2)
-        pblockindex = pindexGenesisBlock;
-    else
-        pblockindex = pindexBest;
-    if (pblockindexFBBHLast && abs(nHeight - pblockindex->nHeight) > abs(nHeight - pblockindexFBBHLast->nHeight))
-        pblockindex = pblockindexFBBHLast;
-    while (pblockindex->nHeight > nHeight)
-        pblockindex = pblockindex->pprev;
-    while (pblockindex->nHeight < nHeight)
-        pblockindex = pblockindex->pnext;
-    pblockindexFBBHLast = pblockindex;
-    return pblockindex;
+    return chainActive[nHeight];
 }
 
 bool CBlock::ReadFromDisk(const CBlockIndex* pindex, bool fReadTransactions)
@@ -1408,7 +1539,11 @@ bool CBlock::ReadFromDisk(const CBlockIndex* pindex, bool fReadTransactions)
         *this = pindex->GetBlockHeader();
         return true;
     }
-    if (!ReadFromDisk(pindex->nFile, pindex->nBlockPos, fReadTransactions))
+    // Blocks already indexed below the last checkpoint had their proof-of-work
+    // checked when they were accepted; the hash comparison below still
+    // catches a block that does not match its index entry
+    bool fCheckPoW = pindex->nHeight > Checkpoints::GetTotalBlocksEstimate();
+    if (!ReadFromDisk(pindex->nFile, pindex->nBlockPos, fReadTransactions, fCheckPoW))
         return false;
     if (GetHash() != pindex->GetBlockHash())
         return error("CBlock::ReadFromDisk() : GetHash() doesn't match index");
@@ -1551,6 +1686,12 @@ int64_t GetProofOfStakeReward(const CBlockIndex* pindexPrev, int64_t nCoinAge, i
     return nSubsidy + nFees;
 }
 
+// Proof-of-work or proof-of-stake target limit of the active chain
+static const arith_uint256& GetTargetLimit(bool fProofOfStake)
+{
+    return fProofOfStake ? Params().ProofOfStakeTargetLimit() : Params().ProofOfWorkTargetLimit();
+}
+
 // ppcoin: find last block index up to pindex
 const CBlockIndex* GetLastBlockIndex(const CBlockIndex* pindex, bool fProofOfStake)
 {
@@ -1562,7 +1703,7 @@ const CBlockIndex* GetLastBlockIndex(const CBlockIndex* pindex, bool fProofOfSta
 unsigned int Terminal_Velocity_RateX(const CBlockIndex* pindexLast, bool fProofOfStake)
 {
        // Terminal-Velocity-RateX, v10-Beta-R4, written by Jonathan Dan Zaretsky - cryptocoderz@gmail.com
-       const CBigNum bnTerminalVelocity = fProofOfStake ? Params().ProofOfStakeLimit() : Params().ProofOfWorkLimit();
+       const arith_uint256 bnTerminalVelocity = GetTargetLimit(fProofOfStake);
        // Define values
        double VLF1 = 0;
        double VLF2 = 0;
@@ -1649,12 +1790,12 @@ unsigned int Terminal_Velocity_RateX(const CBlockIndex* pindexLast, bool fProofO
        else if(prevPoW > prevPoS && fProofOfStake){if((prevPoW-prevPoS) > 3) TerminalAverage /= 3;}
        if(TerminalAverage < 0.5) TerminalAverage = 0.5;} // limit skew to halving
        // Retarget
-       CBigNum bnOld;
-       CBigNum bnNew;
+       arith_uint256 bnOld;
+       arith_uint256 bnNew;
        TerminalFactor *= TerminalAverage;
        difficultyfactor = TerminalFactor;
        bnOld.SetCompact(BlockVelocityType->nBits);
-       bnNew = bnOld / difficultyfactor;
+       bnNew = bnOld / arith_uint256(difficultyfactor);
        bnNew *= 10000;
        // Limit
        if (bnNew > bnTerminalVelocity)
@@ -1698,7 +1839,7 @@ unsigned int GetNextTargetRequired_legacy(const CBlockIndex* pindexLast, bool fP
 
 static unsigned int GetNextTargetRequired_new(const CBlockIndex* pindexLast, bool fProofOfStake)
 {
-    CBigNum bnTargetLimit = fProofOfStake ? Params().ProofOfStakeLimit() : Params().ProofOfWorkLimit();
+    arith_uint256 bnTargetLimit = GetTargetLimit(fProofOfStake);
 
     if (pindexLast == NULL)
         return bnTargetLimit.GetCompact(); // genesis block
@@ -1718,13 +1859,24 @@ static unsigned int GetNextTargetRequired_new(const CBlockIndex* pindexLast, boo
     // retarget with exponential moving toward target spacing
     // Includes MartexCoin fix for wrong retargeting difficulty by Mammix2
 
-    CBigNum bnNew;
-    bnNew.SetCompact(pindexPrev->nBits);
+    arith_uint256 bnPrev;
+    bnPrev.SetCompact(pindexPrev->nBits);
     int64_t nInterval = nTargetTimespan / nTargetSpacing;
-    bnNew *= ((nInterval - 1) * nTargetSpacing + nActualSpacing + nActualSpacing);
-    bnNew /= ((nInterval + 1) * nTargetSpacing);
+    arith_uint256 bnMul((nInterval - 1) * nTargetSpacing + nActualSpacing + nActualSpacing);
+    arith_uint256 bnDiv((nInterval + 1) * nTargetSpacing);
+
+    // bnPrev * bnMul / bnDiv, split as quot * bnMul + rem * bnMul / bnDiv so
+    // that a long gap between blocks cannot overflow 256 bits. If quot * bnMul
+    // could need 255 bits or more, the result is far above any target limit.
+    arith_uint256 bnNew;
+    arith_uint256 bnQuot = bnPrev / bnDiv;
+    arith_uint256 bnRem = bnPrev - bnQuot * bnDiv;
+    if (bnQuot.bits() + bnMul.bits() > 255)
+        bnNew = bnTargetLimit;
+    else
+        bnNew = bnQuot * bnMul + bnRem * bnMul / bnDiv;
 
-    if (bnNew <= 0 || bnNew > bnTargetLimit)
+    if (bnNew == 0 || bnNew > bnTargetLimit)
         bnNew = bnTargetLimit;
 
     return bnNew.GetCompact();
@@ -1733,7 +1885,7 @@ static unsigned int GetNextTargetRequired_new(const CBlockIndex* pindexLast, boo
 
 unsigned int DarkGravityWave(const CBlockIndex* pindexLast, bool fProofOfStake)
 {
-        const CBigNum nProofOfWorkLimit = fProofOfStake ? Params().ProofOfStakeLimit() : Params().ProofOfWorkLimit();
+        const arith_uint256 nProofOfWorkLimit = GetTargetLimit(fProofOfStake);
         const CBlockIndex *BlockLastSolved = pindexLast;
         const CBlockIndex *BlockLastSolved_lgf = GetLastBlockIndex(pindexLast, fProofOfStake);
         const CBlockIndex *BlockReading = pindexLast;
@@ -1747,8 +1899,8 @@ unsigned int DarkGravityWave(const CBlockIndex* pindexLast, bool fProofOfStake)
         int64_t PastBlocksMin = 7;
         int64_t PastBlocksMax = 24;
         int64_t CountBlocks = 0;
-        CBigNum PastDifficultyAverage;
-        CBigNum PastDifficultyAveragePrev;
+        arith_uint256 PastDifficultyAverage;
+        arith_uint256 PastDifficultyAveragePrev;
 
         if (BlockLastSolved == NULL || BlockLastSolved->nHeight == 0 || BlockLastSolved->nHeight < PastBlocksMax) {
             return nProofOfWorkLimit.GetCompact();
@@ -1760,7 +1912,7 @@ unsigned int DarkGravityWave(const CBlockIndex* pindexLast, bool fProofOfStake)
 
             if(CountBlocks <= PastBlocksMin) {
                 if (CountBlocks == 1) { PastDifficultyAverage.SetCompact(BlockReading->nBits); }
-                else { PastDifficultyAverage = ((PastDifficultyAveragePrev * CountBlocks) + (CBigNum().SetCompact(BlockReading->nBits))) / (CountBlocks + 1); }
+                else { PastDifficultyAverage = ((PastDifficultyAveragePrev * arith_uint256(CountBlocks)) + (arith_uint256().SetCompact(BlockReading->nBits))) / arith_uint256(CountBlocks + 1); }
                 PastDifficultyAveragePrev = PastDifficultyAverage;
             }
 
@@ -1782,7 +1934,7 @@ unsigned int DarkGravityWave(const CBlockIndex* pindexLast, bool fProofOfStake)
             }
         }
 
-        CBigNum bnNew(PastDifficultyAverage);
+        arith_uint256 bnNew(PastDifficultyAverage);
 
         int64_t _nTargetTimespan = CountBlocks * nTargetSpacing;
 
@@ -1792,8 +1944,8 @@ unsigned int DarkGravityWave(const CBlockIndex* pindexLast, bool fProofOfStake)
             nActualTimespan = _nTargetTimespan*3;
 
         // Retarget
-        bnNew *= nActualTimespan;
-        bnNew /= _nTargetTimespan;
+        bnNew *= arith_uint256(nActualTimespan);
+        bnNew /= arith_uint256(_nTargetTimespan);
 
         if (bnNew > nProofOfWorkLimit){
             bnNew = nProofOfWorkLimit;
@@ -1822,15 +1974,16 @@ unsigned int GetNextTargetRequired(const CBlockIndex* pindexLast, bool fProofOfS
 
 bool CheckProofOfWork(uint256 hash, unsigned int nBits)
 {
-    CBigNum bnTarget;
-    bnTarget.SetCompact(nBits);
+    bool fNegative, fOverflow;
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(nBits, &fNegative, &fOverflow);
 
     // Check range
-    if (bnTarget <= 0 || bnTarget > Params().ProofOfWorkLimit())
+    if (fNegative || fOverflow || bnTarget == 0 || bnTarget > GetTargetLimit(false))
         return error("CheckProofOfWork() : nBits below minimum work");
 
     // Check proof of work matches claimed amount
-    if (hash > bnTarget.getuint256())
+    if (UintToArith256(hash) > bnTarget)
         return error("CheckProofOfWork() : hash doesn't match nBits");
 
     return true;
@@ -2029,8 +2182,22 @@ int64_t CTransaction::GetValueIn(const MapPrevTx& inputs) const
 
 }
 
+bool CScriptCheck::operator()() const {
+    const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
+    if (!VerifyScript(scriptSig, scriptPubKey, *ptxTo, nIn, nFlags, nHashType))
+        return error("CScriptCheck() : %s VerifySignature failed", ptxTo->GetHash().ToString());
+    return true;
+}
+
+static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+
+void ThreadScriptCheck() {
+    RenameThread("MarteX-scriptch");
+    scriptcheckqueue.Thread();
+}
+
 bool CTransaction::ConnectInputs(CTxDB& txdb, MapPrevTx inputs, map<uint256, CTxIndex>& mapTestPool, const CDiskTxPos& posThisTx,
-    const CBlockIndex* pindexBlock, bool fBlock, bool fMiner, unsigned int flags, bool fValidateSig)
+    const CBlockIndex* pindexBlock, bool fBlock, bool fMiner, unsigned int flags, bool fValidateSig, std::vector<CScriptCheck> *pvChecks)
 {
     // Take over previous transactions' spent pointers
     // fBlock is true when this is called from AcceptBlock when a new best-block is added to the blockchain
@@ -2097,8 +2264,14 @@ bool CTransaction::ConnectInputs(CTxDB& txdb, MapPrevTx inputs, map<uint256, CTx
                 // still computed and checked, and any change will be caught at the next checkpoint.
                 if (!(fBlock && !IsInitialBlockDownload()))
                 {
+                    // Defer the check to the script-checking threads when
+                    // the caller collects them (ConnectBlock)
+                    if (pvChecks)
+                    {
+                        pvChecks->push_back(CScriptCheck(txPrev, *this, i, flags, 0));
+                    }
                     // Verify signature
-                    if (!VerifySignature(txPrev, *this, i, flags, 0))
+                    else if (!VerifySignature(txPrev, *this, i, flags, 0))
                     {
                         if (flags & STANDARD_NOT_MANDATORY_VERIFY_FLAGS) {
                             // Check whether the failure was caused by a
@@ -2162,6 +2335,9 @@ bool CTransaction::ConnectInputs(CTxDB& txdb, MapPrevTx inputs, map<uint256, CTx
 
 bool CBlock::DisconnectBlock(CTxDB& txdb, CBlockIndex* pindex)
 {
+    if (GetBoolArg("-addrindex", false) && !UpdateAddressIndex(txdb, pindex->nHeight, true))
+        return error("DisconnectBlock() : UpdateAddressIndex failed");
+
     // Disconnect in reverse order
     for (int i = vtx.size()-1; i >= 0; i--)
         if (!vtx[i].DisconnectInputs(txdb))
@@ -2218,7 +2394,39 @@ bool static BuildAddrIndex(const CScript &script, std::vector<uint160>& addrIds)
     }
 }
 
-bool FindTransactionsByDestination(const CTxDestination &dest, std::vector<uint256> &vtxhash) {
+// Collect the address ids a transaction touches: those of every output of
+// the transactions it spends and those of its own outputs.
+bool static GetAddrIndexIds(CTxDB& txdb, CTransaction& tx, std::set<uint160>& setAddrIds)
+{
+    if (!tx.IsCoinBase())
+    {
+        MapPrevTx mapInputs;
+        map<uint256, CTxIndex> mapQueuedChangesT;
+        bool fInvalid;
+        if (!tx.FetchInputs(txdb, mapQueuedChangesT, true, false, mapInputs, fInvalid))
+            return false;
+
+        for (MapPrevTx::const_iterator mi = mapInputs.begin(); mi != mapInputs.end(); ++mi)
+        {
+            BOOST_FOREACH(const CTxOut &atxout, (*mi).second.second.vout)
+            {
+                std::vector<uint160> addrIds;
+                if (BuildAddrIndex(atxout.scriptPubKey, addrIds))
+                    setAddrIds.insert(addrIds.begin(), addrIds.end());
+            }
+        }
+    }
+
+    BOOST_FOREACH(const CTxOut &atxout, tx.vout)
+    {
+        std::vector<uint160> addrIds;
+        if (BuildAddrIndex(atxout.scriptPubKey, addrIds))
+            setAddrIds.insert(addrIds.begin(), addrIds.end());
+    }
+    return true;
+}
+
+bool FindTransactionsByDestination(const CTxDestination &dest, std::vector<uint256> &vtxhash, int nSkip, unsigned int nCount) {
     uint160 addrid = 0;
     const CKeyID *pkeyid = boost::get<CKeyID>(&dest);
     if (pkeyid)
@@ -2236,7 +2444,7 @@ bool FindTransactionsByDestination(const CTxDestination &dest, std::vector<uint2
 
     LOCK(cs_main);
     CTxDB txdb("r");
-    if(!txdb.ReadAddrIndex(addrid, vtxhash))
+    if(!txdb.ReadAddrIndex(addrid, vtxhash, nSkip, nCount))
     {
         LogPrintf("FindTransactionsByDestination(): txdb.ReadAddrIndex failed\n");
         return false;
@@ -2244,50 +2452,25 @@ bool FindTransactionsByDestination(const CTxDestination &dest, std::vector<uint2
     return true;
 }
 
-void CBlock::RebuildAddressIndex(CTxDB& txdb)
+bool CBlock::UpdateAddressIndex(CTxDB& txdb, int nHeight, bool fErase)
 {
-    BOOST_FOREACH(CTransaction& tx, vtx)
+    for (unsigned int i = 0; i < vtx.size(); i++)
     {
+        CTransaction& tx = vtx[i];
         uint256 hashTx = tx.GetHash();
-        // inputs
-        if(!tx.IsCoinBase())
-        {
-            MapPrevTx mapInputs;
-            map<uint256, CTxIndex> mapQueuedChangesT;
-            bool fInvalid;
-            if (!tx.FetchInputs(txdb, mapQueuedChangesT, true, false, mapInputs, fInvalid))
-                return;
 
-            MapPrevTx::const_iterator mi;
-            for(MapPrevTx::const_iterator mi = mapInputs.begin(); mi != mapInputs.end(); ++mi)
-            {
-                BOOST_FOREACH(const CTxOut &atxout, (*mi).second.second.vout)
-                {
-                    std::vector<uint160> addrIds;
-                    if(BuildAddrIndex(atxout.scriptPubKey, addrIds))
-                    {
-                        BOOST_FOREACH(uint160 addrId, addrIds)
-                        {
-                            if(!txdb.WriteAddrIndex(addrId, hashTx))
-                                LogPrintf("RebuildAddressIndex(): txins WriteAddrIndex failed addrId: %s txhash: %s\n", addrId.ToString().c_str(), hashTx.ToString().c_str());
-                        }
-                    }
-                }
-            }
-        }
-        // outputs
-        BOOST_FOREACH(const CTxOut &atxout, tx.vout) {
-            std::vector<uint160> addrIds;
-            if(BuildAddrIndex(atxout.scriptPubKey, addrIds))
-            {
-                BOOST_FOREACH(uint160 addrId, addrIds)
-                {
-                    if(!txdb.WriteAddrIndex(addrId, hashTx))
-                        LogPrintf("RebuildAddressIndex(): txouts WriteAddrIndex failed addrId: %s txhash: %s\n", addrId.ToString().c_str(), hashTx.ToString().c_str());
-                }
-            }
+        std::set<uint160> setAddrIds;
+        if (!GetAddrIndexIds(txdb, tx, setAddrIds))
+            return false;
+
+        BOOST_FOREACH(const uint160& addrId, setAddrIds)
+        {
+            bool fOk = fErase ? txdb.EraseAddrIndex(addrId, nHeight, i) : txdb.WriteAddrIndex(addrId, nHeight, i, hashTx);
+            if (!fOk)
+                LogPrintf("UpdateAddressIndex(): %s failed addrId: %s txhash: %s\n", fErase ? "EraseAddrIndex" : "WriteAddrIndex", addrId.ToString(), hashTx.ToString());
         }
     }
+    return true;
 }
 
 bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
@@ -2319,6 +2502,11 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
     MAX_BLOCK_SIGOPS = MAX_BLOCK_SIZE/50;
     MAX_TX_SIGOPS = MAX_BLOCK_SIGOPS/5;
 
+    int64_t nStart = GetTimeMicros();
+    uint64_t nHashRequestsStart = nTxHashRequests.load(boost::memory_order_relaxed);
+    uint64_t nHashComputationsStart = nTxHashComputations.load(boost::memory_order_relaxed);
+    CCheckQueueControl<CScriptCheck> control(nScriptCheckThreads ? &scriptcheckqueue : NULL);
+
     BOOST_FOREACH(CTransaction& tx, vtx)
     {
         uint256 hashTx = tx.GetHash();
@@ -2363,13 +2551,30 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
 		nFlags |= SCRIPT_VERIFY_CHECKSEQUENCEVERIFY;
             }
 
-            if (!tx.ConnectInputs(txdb, mapInputs, mapQueuedChanges, posThisTx, pindex, true, false, flags))
+            std::vector<CScriptCheck> vChecks;
+            if (!tx.ConnectInputs(txdb, mapInputs, mapQueuedChanges, posThisTx, pindex, true, false, flags, true, nScriptCheckThreads ? &vChecks : NULL))
                 return false;
+            control.Add(vChecks);
         }
 
         mapQueuedChanges[hashTx] = CTxIndex(posThisTx, tx.vout.size());
     }
 
+    int64_t nTime = GetTimeMicros() - nStart;
+    if (fBenchmark)
+        LogPrintf("- Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin)\n", (unsigned)vtx.size(), 0.001 * nTime, 0.001 * nTime / vtx.size(), nInputs <= 1 ? 0 : 0.001 * nTime / (nInputs-1));
+
+    if (!control.Wait())
+        return DoS(100, error("ConnectBlock() : script verification failed"));
+    int64_t nTime2 = GetTimeMicros() - nStart;
+    if (fBenchmark)
+    {
+        LogPrintf("- Verify %u txins: %.2fms (%.3fms/txin)\n", nInputs - 1, 0.001 * nTime2, nInputs <= 1 ? 0 : 0.001 * nTime2 / (nInputs-1));
+        uint64_t nHashRequests = nTxHashRequests.load(boost::memory_order_relaxed) - nHashRequestsStart;
+        uint64_t nHashComputations = nTxHashComputations.load(boost::memory_order_relaxed) - nHashComputationsStart;
+        LogPrintf("- Tx hashes: %u requested, %u computed (%u saved)\n", nHashRequests, nHashComputations, nHashRequests > nHashComputations ? nHashRequests - nHashComputations : 0);
+    }
+
     if (IsProofOfWork())
     {
         int64_t nReward = GetProofOfWorkReward(pindex->nHeight, nFees);
@@ -2408,54 +2613,9 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck)
             return error("ConnectBlock() : UpdateTxIndex failed");
     }
 
-    if(GetBoolArg("-addrindex", false))
-    {
-        // Write Address Index
-        BOOST_FOREACH(CTransaction& tx, vtx)
-        {
-            uint256 hashTx = tx.GetHash();
-            // inputs
-            if(!tx.IsCoinBase())
-            {
-                MapPrevTx mapInputs;
-                map<uint256, CTxIndex> mapQueuedChangesT;
-                bool fInvalid;
-                if (!tx.FetchInputs(txdb, mapQueuedChangesT, true, false, mapInputs, fInvalid))
-                    return false;
-
-                MapPrevTx::const_iterator mi;
-                for(MapPrevTx::const_iterator mi = mapInputs.begin(); mi != mapInputs.end(); ++mi)
-                {
-                    BOOST_FOREACH(const CTxOut &atxout, (*mi).second.second.vout)
-                    {
-                        std::vector<uint160> addrIds;
-                        if(BuildAddrIndex(atxout.scriptPubKey, addrIds))
-                        {
-                            BOOST_FOREACH(uint160 addrId, addrIds)
-                            {
-                                if(!txdb.WriteAddrIndex(addrId, hashTx))
-                                    LogPrintf("ConnectBlock(): txins WriteAddrIndex failed addrId: %s txhash: %s\n", addrId.ToString().c_str(), hashTx.ToString().c_str());
-                            }
-                        }
-                    }
-                }
-            }
-
-            // outputs
-            BOOST_FOREACH(const CTxOut &atxout, tx.vout)
-            {
-                std::vector<uint160> addrIds;
-                if(BuildAddrIndex(atxout.scriptPubKey, addrIds))
-                {
-                    BOOST_FOREACH(uint160 addrId, addrIds)
-                    {
-                        if(!txdb.WriteAddrIndex(addrId, hashTx))
-                            LogPrintf("ConnectBlock(): txouts WriteAddrIndex failed addrId: %s txhash: %s\n", addrId.ToString().c_str(), hashTx.ToString().c_str());
-                    }
-                }
-            }
-        }
-    }
+    // Write Address Index
+    if (GetBoolArg("-addrindex", false) && !UpdateAddressIndex(txdb, pindex->nHeight))
+        return false;
 
     // Update block index on disk without changing it in memory.
     // The memory index structure will be changed after the db commits.
@@ -2482,18 +2642,9 @@ bool static Reorganize(CTxDB& txdb, CBlockIndex* pindexNew)
     LogPrintf("REORGANIZE\n");
 
     // Find the fork
-    CBlockIndex* pfork = pindexBest;
-    CBlockIndex* plonger = pindexNew;
-    while (pfork != plonger)
-    {
-        while (plonger->nHeight > pfork->nHeight)
-            if (!(plonger = plonger->pprev))
-                return error("Reorganize() : plonger->pprev is null");
-        if (pfork == plonger)
-            break;
-        if (!(pfork = pfork->pprev))
-            return error("Reorganize() : pfork->pprev is null");
-    }
+    CBlockIndex* pfork = chainActive.FindFork(pindexNew);
+    if (!pfork)
+        return error("Reorganize() : no fork with the active chain");
 
     // List of what to disconnect
     vector<CBlockIndex*> vDisconnect;
@@ -2511,6 +2662,7 @@ bool static Reorganize(CTxDB& txdb, CBlockIndex* pindexNew)
 
     // Disconnect shorter branch
     list<CTransaction> vResurrect;
+    vector<CTransaction> vDisconnected;
     BOOST_FOREACH(CBlockIndex* pindex, vDisconnect)
     {
         CBlock block;
@@ -2519,6 +2671,8 @@ bool static Reorganize(CTxDB& txdb, CBlockIndex* pindexNew)
         if (!block.DisconnectBlock(txdb, pindex))
             return error("Reorganize() : DisconnectBlock %s failed", pindex->GetBlockHash().ToString());
 
+        vDisconnected.insert(vDisconnected.end(), block.vtx.begin(), block.vtx.end());
+
         // Queue memory transactions to resurrect.
         // We only do this for blocks after the last checkpoint (reorganisation before that
         // point should only happen with -reindex/-loadblock, or a misbehaving peer.
@@ -2562,6 +2716,13 @@ bool static Reorganize(CTxDB& txdb, CBlockIndex* pindexNew)
         if (pindex->pprev)
             pindex->pprev->pnext = pindex;
 
+    // Masternode collaterals the disconnected branch spent are unspent again,
+    // unless the longer branch spends them too
+    BOOST_FOREACH(const CTransaction& tx, vDisconnected)
+        mnodeman.SyncTransaction(tx, false);
+    BOOST_FOREACH(const CTransaction& tx, vDelete)
+        mnodeman.SyncTransaction(tx, true);
+
     // Resurrect memory transactions that were in the disconnected branch
     BOOST_FOREACH(CTransaction& tx, vResurrect)
         AcceptToMemoryPool(mempool, tx, false, NULL);
@@ -2598,7 +2759,10 @@ bool CBlock::SetBestChainInner(CTxDB& txdb, CBlockIndex *pindexNew)
 
     // Delete redundant memory transactions
     BOOST_FOREACH(CTransaction& tx, vtx)
+    {
         mempool.remove(tx);
+        mnodeman.SyncTransaction(tx, true);
+    }
 
     return true;
 }
@@ -2679,12 +2843,14 @@ bool CBlock::SetBestChain(CTxDB& txdb, CBlockIndex* pindexNew)
     // New best block
     hashBestChain = hash;
     pindexBest = pindexNew;
-    pblockindexFBBHLast = NULL;
+    chainActive.SetTip(pindexNew);
     nBestHeight = pindexBest->nHeight;
     nBestChainTrust = pindexNew->nChainTrust;
     nTimeBestReceived = GetTime();
     mempool.AddTransactionsUpdated(1);
 
+    txdb.CompactBulkLoad(fIsInitialDownload || fImporting);
+
     uint256 nBestBlockTrust = pindexBest->nHeight != 0 ? (pindexBest->nChainTrust - pindexBest->pprev->nChainTrust) : pindexBest->nChainTrust;
 
     LogPrintf("SetBestChain: new best=%s  height=%d  trust=%s  blocktrust=%d  date=%s\n",
@@ -2791,7 +2957,7 @@ bool CBlock::AddToBlockIndex(unsigned int nFile, unsigned int nBlockPos, const u
         return error("AddToBlockIndex() : %s already exists", hash.ToString());
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(nFile, nBlockPos, *this);
+    CBlockIndex* pindexNew = new (arenaBlockIndex.Allocate()) CBlockIndex(nFile, nBlockPos, *this);
      {
           LOCK(cs_nBlockSequenceId);
           pindexNew->nSequenceId = nBlockSequenceId++;
@@ -2799,11 +2965,12 @@ bool CBlock::AddToBlockIndex(unsigned int nFile, unsigned int nBlockPos, const u
     if (!pindexNew)
         return error("AddToBlockIndex() : new CBlockIndex failed");
     pindexNew->phashBlock = &hash;
-    map<uint256, CBlockIndex*>::iterator miPrev = mapBlockIndex.find(hashPrevBlock);
+    BlockMap::iterator miPrev = mapBlockIndex.find(hashPrevBlock);
     if (miPrev != mapBlockIndex.end())
     {
         pindexNew->pprev = (*miPrev).second;
         pindexNew->nHeight = pindexNew->pprev->nHeight + 1;
+        pindexNew->BuildSkip();
     }
 
     // ppcoin: compute chain trust score
@@ -2825,7 +2992,7 @@ bool CBlock::AddToBlockIndex(unsigned int nFile, unsigned int nBlockPos, const u
     pindexNew->bnStakeModifierV2 = ComputeStakeModifierV2(pindexNew->pprev, IsProofOfWork() ? hash : vtx[1].vin[0].prevout.hash);
 
     // Add to mapBlockIndex
-    map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
+    BlockMap::iterator mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
     if (pindexNew->IsProofOfStake())
         setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
     pindexNew->phashBlock = &((*mi).first);
@@ -3021,11 +3188,11 @@ bool CBlock::CheckBlock(bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckSig) c
 
     // Check for duplicate txids. This is caught by ConnectInputs(),
     // but catching it earlier avoids a potential DoS attack:
-    set<uint256> uniqueTx;
+    vector<uint256> vTxid;
+    vTxid.reserve(vtx.size());
     BOOST_FOREACH(const CTransaction& tx, vtx)
-    {
-        uniqueTx.insert(tx.GetHash());
-    }
+        vTxid.push_back(tx.GetHash());
+    set<uint256> uniqueTx(vTxid.begin(), vTxid.end());
     if (uniqueTx.size() != vtx.size())
         return DoS(100, error("CheckBlock() : duplicate transaction"));
 
@@ -3038,7 +3205,8 @@ bool CBlock::CheckBlock(bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckSig) c
         return DoS(100, error("CheckBlock() : out-of-bounds SigOpCount"));
 
     // Check merkle root
-    if (fCheckMerkleRoot && hashMerkleRoot != BuildMerkleTree())
+    // (reduces vTxid in place, so it is not usable after this)
+    if (fCheckMerkleRoot && hashMerkleRoot != ComputeMerkleRoot(vTxid))
         return DoS(100, error("CheckBlock() : hashMerkleRoot mismatch"));
 
 
@@ -3061,7 +3229,7 @@ bool CBlock::AcceptBlock()
         return error("AcceptBlock() : block already in mapBlockIndex");
 
     // Get prev block index
-    map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashPrevBlock);
+    BlockMap::iterator mi = mapBlockIndex.find(hashPrevBlock);
     if (mi == mapBlockIndex.end())
         return DoS(10, error("AcceptBlock() : prev block not found"));
     CBlockIndex* pindexPrev = (*mi).second;
@@ -3387,7 +3555,7 @@ bool CBlock::SignBlock(CWallet& wallet, int64_t nFees)
     static int64_t nLastCoinStakeSearchTime = GetAdjustedTime(); // startup timestamp
 
     CKey key;
-    CTransaction txCoinStake;
+    CMutableTransaction txCoinStake;
     txCoinStake.nTime &= ~STAKE_TIMESTAMP_MASK;
 
     int64_t nSearchTime = txCoinStake.nTime; // search to current time
@@ -3401,7 +3569,9 @@ bool CBlock::SignBlock(CWallet& wallet, int64_t nFees)
             {
                 // make sure coinstake would meet timestamp protocol
                 //    as it would be the same as the block timestamp
-                vtx[0].nTime = nTime = txCoinStake.nTime;
+                CMutableTransaction txCoinBase(vtx[0]);
+                txCoinBase.nTime = nTime = txCoinStake.nTime;
+                vtx[0] = txCoinBase;
 
                 // we have to make sure that we have no future timestamps in
                 //    our transactions set
@@ -3489,6 +3659,50 @@ FILE* OpenBlockFile(unsigned int nFile, unsigned int nBlockPos, const char* pszM
     return file;
 }
 
+// Mapped block files, least recently used evicted first
+struct CMappedBlockFileEntry
+{
+    boost::shared_ptr<CMappedFile> pmap;
+    uint64_t nLastUsed;
+};
+static CCriticalSection cs_mapMappedBlockFiles;
+static map<unsigned int, CMappedBlockFileEntry> mapMappedBlockFiles;
+static uint64_t nMappedBlockFileUses = 0;
+
+boost::shared_ptr<CMappedFile> GetMappedBlockFile(unsigned int nFile, unsigned int nPos)
+{
+    if ((nFile < 1) || (nFile == (unsigned int) -1))
+        return boost::shared_ptr<CMappedFile>();
+
+    LOCK(cs_mapMappedBlockFiles);
+    map<unsigned int, CMappedBlockFileEntry>::iterator it = mapMappedBlockFiles.find(nFile);
+    if (it != mapMappedBlockFiles.end() && it->second.pmap->size() > nPos)
+    {
+        it->second.nLastUsed = ++nMappedBlockFileUses;
+        return it->second.pmap;
+    }
+
+    // Not mapped yet, or the file has grown since: (re)map it. Readers still
+    // holding the previous mapping keep it alive until they are done.
+    boost::shared_ptr<CMappedFile> pmap(CMappedFile::Open(BlockFilePath(nFile)));
+    if (!pmap || pmap->size() <= nPos)
+        return boost::shared_ptr<CMappedFile>();
+
+    if (it == mapMappedBlockFiles.end() && mapMappedBlockFiles.size() >= MAX_MAPPED_BLOCK_FILES)
+    {
+        map<unsigned int, CMappedBlockFileEntry>::iterator itOldest = mapMappedBlockFiles.begin();
+        for (map<unsigned int, CMappedBlockFileEntry>::iterator mi = mapMappedBlockFiles.begin(); mi != mapMappedBlockFiles.end(); ++mi)
+            if (mi->second.nLastUsed < itOldest->second.nLastUsed)
+                itOldest = mi;
+        mapMappedBlockFiles.erase(itOldest);
+    }
+
+    CMappedBlockFileEntry& entry = mapMappedBlockFiles[nFile];
+    entry.pmap = pmap;
+    entry.nLastUsed = ++nMappedBlockFileUses;
+    return pmap;
+}
+
 static unsigned int nCurrentBlockFile = 1;
 
 FILE* AppendBlockFile(unsigned int& nFileRet)
@@ -3551,7 +3765,7 @@ void PrintBlockTree()
     AssertLockHeld(cs_main);
     // pre-compute tree structure
     map<CBlockIndex*, vector<CBlockIndex*> > mapNext;
-    for (map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.begin(); mi != mapBlockIndex.end(); ++mi)
+    for (BlockMap::iterator mi = mapBlockIndex.begin(); mi != mapBlockIndex.end(); ++mi)
     {
         CBlockIndex* pindex = (*mi).second;
         mapNext[pindex->pprev].push_back(pindex);
@@ -3677,7 +3891,7 @@ bool LoadExternalBlockFile(FILE* fileIn)
                    __PRETTY_FUNCTION__);
         }
     }
-    LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+    LogPrintf("Loaded %i blocks from external file in %dms (%d script verification threads)\n", nLoaded, GetTimeMillis() - nStart, std::max(nScriptCheckThreads, 1));
     return nLoaded > 0;
 }
 
@@ -3717,6 +3931,11 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
             RenameOver(pathBootstrap, pathBootstrapOld);
         }
     }
+
+    if (GetBoolArg("-stopafterblockimport", false)) {
+        LogPrintf("Stopping after block import\n");
+        StartShutdown();
+    }
 }
 
 
@@ -3846,7 +4065,7 @@ void static ProcessGetData(CNode* pfrom)
             if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
             {
                 // Send block from disk
-                map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(inv.hash);
+                BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
                 if (mi != mapBlockIndex.end())
                 {
                     CBlock block;
@@ -4280,7 +4499,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
         if (locator.IsNull())
         {
             // If locator is null, return the hashStop block
-            map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashStop);
+            BlockMap::iterator mi = mapBlockIndex.find(hashStop);
             if (mi == mapBlockIndex.end())
                 return true;
             pindex = (*mi).second;
@@ -13,9 +13,16 @@
 #include "script.h"
 #include "scrypt.h"
 #include "hashblock.h"
+#include "merkle.h"
+#include "mappedfile.h"
+#include "arena.h"
 
 #include <list>
 
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
 #define START_MASTERNODE_PAYMENTS_TESTNET 1495238400 // Sat, 20 May 2017 00:00:00 GMT
 #define START_MASTERNODE_PAYMENTS 1495238400         // Sat, 20 May 2017 00:00:00 GMT
 
@@ -41,6 +48,7 @@ class CKeyItem;
 class CNode;
 class CReserveKey;
 class CWallet;
+class CScriptCheck;
 
 /** The maximum allowed multiple for the computed block size */
 static const unsigned int MAX_BLOCK_SIZE_INCREASE_MULTIPLE = 2;
@@ -90,6 +98,14 @@ static const unsigned int LOCKTIME_THRESHOLD = 500000000; // Tue Nov  5 00:53:20
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 128;
 /** Timeout in seconds before considering a block download peer unresponsive. */
 static const unsigned int BLOCK_DOWNLOAD_TIMEOUT = 60;
+/** Maximum number of script-checking threads allowed */
+static const int MAX_SCRIPTCHECK_THREADS = 16;
+/** -par default (number of script-checking threads, 0 = auto) */
+static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of block files kept memory mapped for reading */
+static const unsigned int MAX_MAPPED_BLOCK_FILES = 16;
+/** -mmapblocks default: only map block files where address space is plentiful */
+static const bool DEFAULT_MMAP_BLOCK_FILES = sizeof(void*) >= 8;
 /** Defaults to yes, adaptively increase/decrease max/min/priority along with the re-calculated block size **/
 static const unsigned int DEFAULT_SCALE_BLOCK_SIZE_OPTIONS = 1;
 /** PoS Reward */
@@ -206,10 +222,18 @@ const std::string FOUNDATION_T = "mvcNScAif4qiBLKyaVZxXnN2C84dxowq6d";
 const std::string mMVCDEV = "04090B3ABA2B1FAFD0B07104E6FDDB83E8101C0F15019BE8F90AC179B43C9C05BA03D2F80D6BF14298CFB91E8D1A7D26B98D8EF14B502603235299356CAD2E4436";
 const std::string tMVCDEV = "04cff7ee668d09f694e8012299327f568acd5aa5075ef47133c4b6df318d558916989db7a012dc54b17a48ed63364fc18c09e2c878355e07a1745956649224a7ab";
 
+/** Block hashes are already uniformly distributed; the low 64 bits make a fine bucket hash */
+struct BlockHasher
+{
+    size_t operator()(const uint256& hash) const { return hash.Get64(); }
+};
+typedef boost::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
+
 extern CScript COINBASE_FLAGS;
 extern CCriticalSection cs_main;
 extern CTxMemPool mempool;
-extern std::map<uint256, CBlockIndex*> mapBlockIndex;
+extern BlockMap mapBlockIndex;
+extern CSlabArena<CBlockIndex> arenaBlockIndex;
 extern std::set<std::pair<COutPoint, unsigned int> > setStakeSeen;
 extern CBlockIndex* pindexGenesisBlock;
 extern unsigned int nNodeLifespan;
@@ -225,6 +249,9 @@ extern const std::string strMessageMagic;
 extern int64_t nTimeBestReceived;
 extern bool fImporting;
 extern bool fReindex;
+extern int nScriptCheckThreads;
+extern bool fBenchmark;
+extern bool fMapBlockFiles;
 struct COrphanBlock;
 extern std::map<uint256, COrphanBlock*> mapOrphanBlocks;
 extern bool fHaveGUI;
@@ -256,6 +283,9 @@ void SyncWithWallets(const CTransaction& tx, const CBlock* pblock = NULL, bool f
 /** Ask wallets to resend their transactions */
 void ResendWalletTransactions(bool fForce = false);
 
+/** Run an instance of the script checking thread */
+void ThreadScriptCheck();
+
 /** Register with a network node to receive its signals */
 void RegisterNodeSignals(CNodeSignals& nodeSignals);
 /** Unregister a network node */
@@ -267,6 +297,32 @@ bool ProcessBlock(CNode* pfrom, CBlock* pblock);
 bool CheckDiskSpace(uint64_t nAdditionalBytes=0);
 FILE* OpenBlockFile(unsigned int nFile, unsigned int nBlockPos, const char* pszMode="rb");
 FILE* AppendBlockFile(unsigned int& nFileRet);
+/** Get a read-only mapping of block file nFile that extends past offset nPos, or NULL if unavailable */
+boost::shared_ptr<CMappedFile> GetMappedBlockFile(unsigned int nFile, unsigned int nPos);
+
+/** Deserialize obj from block file nFile at offset nPos through the mapped
+    block file cache. Returns false if the data could not be mapped, in which
+    case the caller should fall back to OpenBlockFile(). */
+template<typename T>
+bool ReadMappedBlockFile(unsigned int nFile, unsigned int nPos, int nType, T& obj)
+{
+    boost::shared_ptr<CMappedFile> pmap = GetMappedBlockFile(nFile, nPos);
+    // A second attempt covers data appended since the file was mapped
+    for (int nTry = 0; pmap && nTry < 2; nTry++)
+    {
+        CSpanStream stream(pmap->begin() + nPos, pmap->end(), nType, CLIENT_VERSION);
+        try {
+            stream >> obj;
+            return true;
+        }
+        catch (std::ios_base::failure &e) {
+            if (!stream.eof())
+                throw;
+        }
+        pmap = GetMappedBlockFile(nFile, pmap->size());
+    }
+    return false;
+}
 bool LoadBlockIndex(bool fAllowNew=true);
 void PrintBlockTree();
 CBlockIndex* FindBlockByHeight(int nHeight);
@@ -295,7 +351,7 @@ bool AcceptableInputs(CTxMemPool& pool, const CTransaction &txo, bool fLimitFree
                         bool* pfMissingInputs, bool fRejectMartexFee=false, bool isDSTX=false);
 
 
-bool FindTransactionsByDestination(const CTxDestination &dest, std::vector<uint256> &vtxhash);
+bool FindTransactionsByDestination(const CTxDestination &dest, std::vector<uint256> &vtxhash, int nSkip, unsigned int nCount);
 
 int GetInputAge(CTxIn& vin);
 int GetInputAgeIX(uint256 nTXHash, CTxIn& vin);
@@ -378,61 +434,74 @@ int64_t GetMinFee(const CTransaction& tx, unsigned int nBytes, bool fAllowFree,
 
 
 
+struct CMutableTransaction;
+
+/** Transaction hash memoization counters: GetHash() calls, and hashes
+ *  actually computed. Without the memoized hash every call was a full
+ *  serialization and double SHA-256; -benchmark logs both per block and
+ *  GetHash() calls are only counted with -benchmark. */
+extern boost::atomic<uint64_t> nTxHashRequests;
+extern boost::atomic<uint64_t> nTxHashComputations;
+
 /** The basic transaction that is broadcasted on the network and contained in
  * blocks.  A transaction can contain multiple inputs and outputs.
+ *
+ * The fields are const so the hash, computed once when the transaction is
+ * built or deserialized, can never go stale: build and edit transactions as
+ * a CMutableTransaction and convert it when done.
  */
 class CTransaction
 {
+private:
+    /** Memory only */
+    const uint256 hash;
+    void UpdateHash() const;
+
 public:
     static const int CURRENT_VERSION=1;
-    int nVersion;
-    unsigned int nTime;
-    std::vector<CTxIn> vin;
-    std::vector<CTxOut> vout;
-    unsigned int nLockTime;
+    const int nVersion;
+    const unsigned int nTime;
+    const std::vector<CTxIn> vin;
+    const std::vector<CTxOut> vout;
+    const unsigned int nLockTime;
 
     // Denial-of-service detection:
     mutable int nDoS;
     bool DoS(int nDoSIn, bool fIn) const { nDoS += nDoSIn; return fIn; }
 
-    CTransaction()
-    {
-        SetNull();
-    }
+    /** Construct a CTransaction that qualifies as IsNull() */
+    CTransaction();
 
-    CTransaction(int nVersion, unsigned int nTime, const std::vector<CTxIn>& vin, const std::vector<CTxOut>& vout, unsigned int nLockTime)
-        : nVersion(nVersion), nTime(nTime), vin(vin), vout(vout), nLockTime(nLockTime), nDoS(0)
-    {
-    }
+    /** Convert a CMutableTransaction into a CTransaction. */
+    CTransaction(const CMutableTransaction& tx);
+
+    CTransaction(const CTransaction& tx);
+    CTransaction& operator=(const CTransaction& tx);
 
     IMPLEMENT_SERIALIZE
     (
-        READWRITE(this->nVersion);
+        READWRITE(*const_cast<int*>(&this->nVersion));
         nVersion = this->nVersion;
-        READWRITE(nTime);
-        READWRITE(vin);
-        READWRITE(vout);
-        READWRITE(nLockTime);
+        READWRITE(*const_cast<unsigned int*>(&nTime));
+        READWRITE(*const_cast<std::vector<CTxIn>*>(&vin));
+        READWRITE(*const_cast<std::vector<CTxOut>*>(&vout));
+        READWRITE(*const_cast<unsigned int*>(&nLockTime));
+        if (fRead)
+            UpdateHash();
     )
 
-    void SetNull()
-    {
-        nVersion = CTransaction::CURRENT_VERSION;
-        nTime = GetAdjustedTime();
-        vin.clear();
-        vout.clear();
-        nLockTime = 0;
-        nDoS = 0;  // Denial-of-service prevention
-    }
-
     bool IsNull() const
     {
         return (vin.empty() && vout.empty());
     }
 
-    uint256 GetHash() const
+    const uint256& GetHash() const
     {
-        return SerializeHash(*this);
+        // only counted under -benchmark, an atomic add on every call
+        // would bounce the counter's cache line between threads
+        if (fBenchmark)
+            nTxHashRequests.fetch_add(1, boost::memory_order_relaxed);
+        return hash;
     }
 
     bool IsCoinBase() const
@@ -476,6 +545,17 @@ public:
 
     bool ReadFromDisk(CDiskTxPos pos, FILE** pfileRet=NULL)
     {
+        if (fMapBlockFiles && !pfileRet)
+        {
+            try {
+                if (ReadMappedBlockFile(pos.nFile, pos.nTxPos, SER_DISK, *this))
+                    return true;
+            }
+            catch (std::exception &e) {
+                return error("%s() : deserialize error", __PRETTY_FUNCTION__);
+            }
+        }
+
         CAutoFile filein = CAutoFile(OpenBlockFile(pos.nFile, 0, pfileRet ? "rb+" : "rb"), SER_DISK, CLIENT_VERSION);
         if (!filein)
             return error("CTransaction::ReadFromDisk() : OpenBlockFile failed");
@@ -566,13 +646,76 @@ public:
      */
     bool ConnectInputs(CTxDB& txdb, MapPrevTx inputs,
                        std::map<uint256, CTxIndex>& mapTestPool, const CDiskTxPos& posThisTx,
-                       const CBlockIndex* pindexBlock, bool fBlock, bool fMiner, unsigned int flags = STANDARD_SCRIPT_VERIFY_FLAGS, bool fValidateSig = true);
+                       const CBlockIndex* pindexBlock, bool fBlock, bool fMiner, unsigned int flags = STANDARD_SCRIPT_VERIFY_FLAGS, bool fValidateSig = true,
+                       std::vector<CScriptCheck> *pvChecks = NULL);
     bool CheckTransaction() const;
     bool GetCoinAge(CTxDB& txdb, const CBlockIndex* pindexPrev, uint64_t& nCoinAge) const;
 
     const CTxOut& GetOutputFor(const CTxIn& input, const MapPrevTx& inputs) const;
 };
 
+/** A mutable version of CTransaction, for building and signing. */
+struct CMutableTransaction
+{
+    int nVersion;
+    unsigned int nTime;
+    std::vector<CTxIn> vin;
+    std::vector<CTxOut> vout;
+    unsigned int nLockTime;
+
+    CMutableTransaction();
+    CMutableTransaction(const CTransaction& tx);
+
+    IMPLEMENT_SERIALIZE
+    (
+        READWRITE(this->nVersion);
+        nVersion = this->nVersion;
+        READWRITE(nTime);
+        READWRITE(vin);
+        READWRITE(vout);
+        READWRITE(nLockTime);
+    )
+
+    /** Compute the hash of this CMutableTransaction. This is computed on the
+        fly, as opposed to GetHash() in CTransaction, which uses a cached result. */
+    uint256 GetHash() const;
+
+    std::string ToString() const
+    {
+        return CTransaction(*this).ToString();
+    }
+};
+
+
+/** Closure representing one script verification.
+ *  Note that this stores references to the spending transaction
+ */
+class CScriptCheck
+{
+private:
+    CScript scriptPubKey;
+    const CTransaction *ptxTo;
+    unsigned int nIn;
+    unsigned int nFlags;
+    int nHashType;
+
+public:
+    CScriptCheck() : ptxTo(0), nIn(0), nFlags(0), nHashType(0) {}
+    CScriptCheck(const CTransaction& txFromIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, int nHashTypeIn) :
+        scriptPubKey(txFromIn.vout[txToIn.vin[nInIn].prevout.n].scriptPubKey),
+        ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), nHashType(nHashTypeIn) { }
+
+    bool operator()() const;
+
+    void swap(CScriptCheck &check) {
+        scriptPubKey.swap(check.scriptPubKey);
+        std::swap(ptxTo, check.ptxTo);
+        std::swap(nIn, check.nIn);
+        std::swap(nFlags, check.nFlags);
+        std::swap(nHashType, check.nHashType);
+    }
+};
+
 
 
 
@@ -780,6 +923,30 @@ public:
     mutable int nDoS;
     bool DoS(int nDoSIn, bool fIn) const { nDoS += nDoSIn; return fIn; }
 
+private:
+    // memory only: memoized block hashes, valid only while the header still
+    // matches the copy they were computed from (header fields are public and
+    // get mutated directly, e.g. by the miner). Like vMerkleTree the cache is
+    // not synchronised: const GetHash() writes it, so a block used from more
+    // than one thread must be hashed before it is shared and keep its header
+    // unchanged afterwards, or only be touched under the lock that guards it.
+    static const size_t HEADER_SIZE = 80;
+    mutable unsigned char pchHashedHeader[HEADER_SIZE];
+    mutable uint256 hashCached;
+    mutable uint256 hashPoWCached;
+    mutable bool fHashCached;
+    mutable bool fPoWHashCached;
+
+    void SyncHashCache() const
+    {
+        if (memcmp(pchHashedHeader, BEGIN(nVersion), HEADER_SIZE) != 0)
+        {
+            memcpy(pchHashedHeader, BEGIN(nVersion), HEADER_SIZE);
+            fHashCached = fPoWHashCached = false;
+        }
+    }
+
+public:
     CBlock()
     {
         SetNull();
@@ -820,6 +987,8 @@ public:
         vchBlockSig.clear();
         vMerkleTree.clear();
         nDoS = 0;
+        memset(pchHashedHeader, 0, HEADER_SIZE);
+        fHashCached = fPoWHashCached = false;
     }
 
     bool IsNull() const
@@ -829,15 +998,41 @@ public:
 
     uint256 GetHash() const
     {
-        if (nVersion > 6)
-            return Hash(BEGIN(nVersion), END(nNonce));
-        else
+        if (nVersion <= 6)
             return GetPoWHash();
+
+        SyncHashCache();
+        if (!fHashCached)
+        {
+            hashCached = Hash(BEGIN(nVersion), END(nNonce));
+            fHashCached = true;
+        }
+        return hashCached;
     }
 
     uint256 GetPoWHash() const
     {
-     return Hash9(BEGIN(nVersion), END(nNonce));
+        SyncHashCache();
+        if (!fPoWHashCached)
+        {
+            hashPoWCached = CHash9Engine::ThreadEngine().Hash(BEGIN(nVersion), HEADER_SIZE);
+            fPoWHashCached = true;
+        }
+        return hashPoWCached;
+    }
+
+    /** Seed the hash cache with a block hash already known for this header
+        (e.g. from the block index), so GetHash() need not recompute it */
+    void SetCachedHash(const uint256& hash) const
+    {
+        SyncHashCache();
+        hashCached = hash;
+        fHashCached = true;
+        if (nVersion <= 6)
+        {
+            hashPoWCached = hash;
+            fPoWHashCached = true;
+        }
     }
 
     int64_t GetBlockTime() const
@@ -886,17 +1081,7 @@ public:
         vMerkleTree.clear();
         BOOST_FOREACH(const CTransaction& tx, vtx)
             vMerkleTree.push_back(tx.GetHash());
-        int j = 0;
-        for (int nSize = vtx.size(); nSize > 1; nSize = (nSize + 1) / 2)
-        {
-            for (int i = 0; i < nSize; i += 2)
-            {
-                int i2 = std::min(i+1, nSize-1);
-                vMerkleTree.push_back(Hash(BEGIN(vMerkleTree[j+i]),  END(vMerkleTree[j+i]),
-                                           BEGIN(vMerkleTree[j+i2]), END(vMerkleTree[j+i2])));
-            }
-            j += nSize;
-        }
+        ComputeMerkleTree(vMerkleTree);
         return (vMerkleTree.empty() ? 0 : vMerkleTree.back());
     }
 
@@ -958,27 +1143,34 @@ public:
         return true;
     }
 
-    bool ReadFromDisk(unsigned int nFile, unsigned int nBlockPos, bool fReadTransactions=true)
+    bool ReadFromDisk(unsigned int nFile, unsigned int nBlockPos, bool fReadTransactions=true, bool fCheckPoW=true)
     {
         SetNull();
 
-        // Open history file to read
-        CAutoFile filein = CAutoFile(OpenBlockFile(nFile, nBlockPos, "rb"), SER_DISK, CLIENT_VERSION);
-        if (!filein)
-            return error("CBlock::ReadFromDisk() : OpenBlockFile failed");
+        int nType = SER_DISK;
         if (!fReadTransactions)
-            filein.nType |= SER_BLOCKHEADERONLY;
+            nType |= SER_BLOCKHEADERONLY;
 
-        // Read block
+        // Read block, straight from the mapped block file when possible
         try {
-            filein >> *this;
+            if (!fMapBlockFiles || !ReadMappedBlockFile(nFile, nBlockPos, nType, *this))
+            {
+                SetNull();
+
+                // Open history file to read
+                CAutoFile filein = CAutoFile(OpenBlockFile(nFile, nBlockPos, "rb"), SER_DISK, CLIENT_VERSION);
+                if (!filein)
+                    return error("CBlock::ReadFromDisk() : OpenBlockFile failed");
+                filein.nType = nType;
+                filein >> *this;
+            }
         }
         catch (std::exception &e) {
             return error("%s() : deserialize or I/O error", __PRETTY_FUNCTION__);
         }
 
         // Check the header
-        if (fReadTransactions && IsProofOfWork() && !CheckProofOfWork(GetPoWHash(), nBits))
+        if (fCheckPoW && fReadTransactions && IsProofOfWork() && !CheckProofOfWork(GetPoWHash(), nBits))
             return error("CBlock::ReadFromDisk() : errors in block header");
 
         return true;
@@ -1018,7 +1210,7 @@ public:
     bool AcceptBlock();
     bool SignBlock(CWallet& keystore, int64_t nFees);
     bool CheckBlockSignature() const;
-    void RebuildAddressIndex(CTxDB& txdb);
+    bool UpdateAddressIndex(CTxDB& txdb, int nHeight, bool fErase = false);
 
 private:
     bool SetBestChainInner(CTxDB& txdb, CBlockIndex *pindexNew);
@@ -1075,6 +1267,8 @@ public:
     const uint256* phashBlock;
     CBlockIndex* pprev;
     CBlockIndex* pnext;
+    // (memory only) pointer to an ancestor further back, see GetAncestor()
+    CBlockIndex* pskip;
     unsigned int nFile;
     unsigned int nBlockPos;
     uint256 nChainTrust; // ppcoin: trust score of block chain
@@ -1114,6 +1308,7 @@ public:
         phashBlock = NULL;
         pprev = NULL;
         pnext = NULL;
+        pskip = NULL;
         nFile = 0;
         nBlockPos = 0;
         nHeight = 0;
@@ -1140,6 +1335,7 @@ public:
         phashBlock = NULL;
         pprev = NULL;
         pnext = NULL;
+        pskip = NULL;
         nFile = nFileIn;
         nBlockPos = nBlockPosIn;
         nHeight = 0;
@@ -1180,6 +1376,8 @@ public:
         block.nTime          = nTime;
         block.nBits          = nBits;
         block.nNonce         = nNonce;
+        if (phashBlock)
+            block.SetCachedHash(*phashBlock);
         return block;
     }
 
@@ -1196,6 +1394,14 @@ public:
         return *phashBlock;
     }
 
+    /** Set pskip; pprev and its pskip must already be set */
+    void BuildSkip();
+
+    /** Ancestor of this block at nHeightIn, found through the pskip
+        pointers in O(log n) steps, or NULL if out of range */
+    CBlockIndex* GetAncestor(int nHeightIn);
+    const CBlockIndex* GetAncestor(int nHeightIn) const;
+
     int64_t GetBlockTime() const
     {
         return (int64_t)nTime;
@@ -1290,6 +1496,73 @@ public:
 
 
 
+/** The active chain as a vector of block index pointers indexed by height,
+ *  giving constant time lookups by height and cheap membership tests.
+ *  Kept in step with pindexBest. Height lookups are also made without
+ *  cs_main (RPC, masternode code), so every access takes the chain's own
+ *  lock; the CBlockIndex entries it returns are never freed.
+ */
+class CChain
+{
+private:
+    mutable CCriticalSection cs;
+    std::vector<CBlockIndex*> vChain;
+
+public:
+    /** Genesis block of this chain, or NULL if empty */
+    CBlockIndex* Genesis() const
+    {
+        LOCK(cs);
+        return vChain.size() > 0 ? vChain[0] : NULL;
+    }
+
+    /** Tip of this chain, or NULL if empty */
+    CBlockIndex* Tip() const
+    {
+        LOCK(cs);
+        return vChain.size() > 0 ? vChain[vChain.size() - 1] : NULL;
+    }
+
+    /** Block at height nHeight in this chain, or NULL if out of range */
+    CBlockIndex* operator[](int nHeight) const
+    {
+        LOCK(cs);
+        if (nHeight < 0 || nHeight >= (int)vChain.size())
+            return NULL;
+        return vChain[nHeight];
+    }
+
+    /** Whether pindex is part of this chain */
+    bool Contains(const CBlockIndex* pindex) const
+    {
+        return (*this)[pindex->nHeight] == pindex;
+    }
+
+    /** Successor of pindex in this chain, or NULL if pindex is the tip or not in the chain */
+    CBlockIndex* Next(const CBlockIndex* pindex) const
+    {
+        LOCK(cs);
+        if (Contains(pindex))
+            return (*this)[pindex->nHeight + 1];
+        return NULL;
+    }
+
+    /** Height of the tip, -1 if empty */
+    int Height() const
+    {
+        LOCK(cs);
+        return vChain.size() - 1;
+    }
+
+    /** Make pindex the tip, replacing entries only back to the fork point */
+    void SetTip(CBlockIndex* pindex);
+
+    /** Last block of this chain that is an ancestor of pindex */
+    CBlockIndex* FindFork(CBlockIndex* pindex) const;
+};
+
+extern CChain chainActive;
+
 /** Used to marshal pointers into hashes for db storage. */
 class CDiskBlockIndex : public CBlockIndex
 {
@@ -1407,7 +1680,7 @@ public:
 
     explicit CBlockLocator(uint256 hashBlock)
     {
-        std::map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+        BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
         if (mi != mapBlockIndex.end())
             Set((*mi).second);
     }
@@ -1443,8 +1716,7 @@ public:
             vHave.push_back(pindex->GetBlockHash());
 
             // Exponentially larger steps back
-            for (int i = 0; pindex && i < nStep; i++)
-                pindex = pindex->pprev;
+            pindex = pindex->GetAncestor(pindex->nHeight - nStep);
             if (vHave.size() > 10)
                 nStep *= 2;
         }
@@ -1458,7 +1730,7 @@ public:
         int nStep = 1;
         BOOST_FOREACH(const uint256& hash, vHave)
         {
-            std::map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hash);
+            BlockMap::iterator mi = mapBlockIndex.find(hash);
             if (mi != mapBlockIndex.end())
             {
                 CBlockIndex* pindex = (*mi).second;
@@ -1477,7 +1749,7 @@ public:
         // Find the first block the caller has in the main chain
         BOOST_FOREACH(const uint256& hash, vHave)
         {
-            std::map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hash);
+            BlockMap::iterator mi = mapBlockIndex.find(hash);
             if (mi != mapBlockIndex.end())
             {
                 CBlockIndex* pindex = (*mi).second;
@@ -1493,7 +1765,7 @@ public:
         // Find the first block the caller has in the main chain
         BOOST_FOREACH(const uint256& hash, vHave)
         {
-            std::map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hash);
+            BlockMap::iterator mi = mapBlockIndex.find(hash);
             if (mi != mapBlockIndex.end())
             {
                 CBlockIndex* pindex = (*mi).second;
@@ -0,0 +1,48 @@
+// Copyright (c) 2014-2018 The MarteX developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "mappedfile.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CMappedFile::~CMappedFile()
+{
+#ifndef WIN32
+    if (pData)
+        munmap((void*)pData, nSize);
+#endif
+}
+
+CMappedFile* CMappedFile::Open(const boost::filesystem::path& path)
+{
+#ifdef WIN32
+    // Callers fall back to stdio
+    return NULL;
+#else
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || (uint64_t)st.st_size > (uint64_t)(size_t)-1)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    size_t nSize = (size_t)st.st_size;
+    void* p = mmap(NULL, nSize, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps its own reference to the file
+    close(fd);
+    if (p == MAP_FAILED)
+        return NULL;
+
+    return new CMappedFile((const char*)p, nSize);
+#endif
+}
@@ -0,0 +1,36 @@
+// Copyright (c) 2014-2018 The MarteX developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_MAPPEDFILE_H
+#define BITCOIN_MAPPEDFILE_H
+
+#include <stddef.h>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+
+/** Read-only memory mapping of a whole file.
+ *  The mapping is a snapshot of the file length at Open() time; data
+ *  appended later is only visible through a new mapping.
+ */
+class CMappedFile : private boost::noncopyable
+{
+private:
+    const char* pData;
+    size_t nSize;
+
+    CMappedFile(const char* pDataIn, size_t nSizeIn) : pData(pDataIn), nSize(nSizeIn) {}
+
+public:
+    ~CMappedFile();
+
+    /** Map the file at path. Returns NULL if the file is empty, cannot be
+        opened or mapping is not supported on this platform. */
+    static CMappedFile* Open(const boost::filesystem::path& path);
+
+    const char* begin() const { return pData; }
+    const char* end() const   { return pData + nSize; }
+    size_t size() const       { return nSize; }
+};
+
+#endif
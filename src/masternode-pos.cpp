@@ -58,7 +58,6 @@ void ProcessMessageMasternodePOS(CNode* pfrom, std::string& strCommand, CDataStr
     if (strCommand == "mnse") //Masternode Scanning Error
     {
 
-        CDataStream vMsg(vRecv);
         CMasternodeScanningError mnse;
         vRecv >> mnse;
 
@@ -12,9 +12,6 @@
 CCriticalSection cs_masternodes;
 // keep track of the scanning errors I've seen
 map<uint256, int> mapSeenMasternodeScanningErrors;
-// cache block hashes as we calculate them
-std::map<int64_t, uint256> mapCacheBlockHashes;
-
 
 struct CompareValueOnly
 {
@@ -33,31 +30,15 @@ bool GetBlockHash(uint256& hash, int nBlockHeight)
     if(nBlockHeight == 0)
         nBlockHeight = pindexBest->nHeight;
 
-    if(mapCacheBlockHashes.count(nBlockHeight)){
-        hash = mapCacheBlockHashes[nBlockHeight];
-        return true;
-    }
-
     const CBlockIndex *BlockLastSolved = pindexBest;
-    const CBlockIndex *BlockReading = pindexBest;
 
     if (BlockLastSolved == NULL || BlockLastSolved->nHeight == 0 || pindexBest->nHeight+1 < nBlockHeight) return false;
 
-    int nBlocksAgo = 0;
-    if(nBlockHeight > 0) nBlocksAgo = (pindexBest->nHeight+1)-nBlockHeight;
-    assert(nBlocksAgo >= 0);
-
-    int n = 0;
-    for (unsigned int i = 1; BlockReading && BlockReading->nHeight > 0; i++) {
-        if(n >= nBlocksAgo){
-            hash = BlockReading->GetBlockHash();
-            mapCacheBlockHashes[nBlockHeight] = hash;
-            return true;
-        }
-        n++;
-
-        if (BlockReading->pprev == NULL) { assert(BlockReading); break; }
-        BlockReading = BlockReading->pprev;
+    // the hash of the block before nBlockHeight, genesis excluded
+    const CBlockIndex *BlockReading = chainActive[nBlockHeight - 1];
+    if (BlockReading && BlockReading->nHeight > 0) {
+        hash = BlockReading->GetBlockHash();
+        return true;
     }
 
     return false;
@@ -89,6 +70,7 @@ CMasternode::CMasternode()
     nLastScanningErrorBlockHeight = 0;
     //mark last paid as current for new entries
     nLastPaid = GetAdjustedTime();
+    collateralSpent = false;
 }
 
 CMasternode::CMasternode(const CMasternode& other)
@@ -117,6 +99,7 @@ CMasternode::CMasternode(const CMasternode& other)
     nLastScanningErrorBlockHeight = other.nLastScanningErrorBlockHeight;
     nLastPaid = other.nLastPaid;
     nLastPaid = GetAdjustedTime();
+    collateralSpent = other.collateralSpent;
 }
 
 CMasternode::CMasternode(CService newAddr, CTxIn newVin, CPubKey newPubkey, std::vector<unsigned char> newSig, int64_t newSigTime, CPubKey newPubkey2, int protocolVersionIn, CScript newDonationAddress, int newDonationPercentage)
@@ -143,6 +126,7 @@ CMasternode::CMasternode(CService newAddr, CTxIn newVin, CPubKey newPubkey, std:
     lastVote = 0;
     nScanningErrorCount = 0;
     nLastScanningErrorBlockHeight = 0;
+    collateralSpent = false;
 }
 
 //
@@ -175,9 +159,11 @@ void CMasternode::Check()
     TRY_LOCK(cs_main, lockRecv);
     if(!lockRecv) return;
 
-    //once spent, stop doing the checks
-    if(activeState == MASTERNODE_VIN_SPENT) return;
-
+    //spends of the vin are tracked by CMasternodeMan, see SyncTransaction
+    if(collateralSpent && !unitTest){
+        activeState = MASTERNODE_VIN_SPENT;
+        return;
+    }
 
     if(!UpdatedWithin(MASTERNODE_REMOVAL_SECONDS)){
         activeState = MASTERNODE_REMOVE;
@@ -189,18 +175,17 @@ void CMasternode::Check()
         return;
     }
 
-    if(!unitTest){
-        CValidationState state;
-        CTransaction tx = CTransaction();
-        CTxOut vout = CTxOut(ANONSEND_POOL_MAX, anonSendPool.collateralPubKey);
-        tx.vin.push_back(vin);
-        tx.vout.push_back(vout);
-
-	if(!AcceptableInputs(mempool, tx, false, NULL)){
-            activeState = MASTERNODE_VIN_SPENT;
-            return;
-        }
-    }
-
     activeState = MASTERNODE_ENABLED; // OK
+}
+
+void CMasternode::CheckCollateral()
+{
+    if(unitTest) return;
+
+    CMutableTransaction tx;
+    CTxOut vout = CTxOut(ANONSEND_POOL_MAX, anonSendPool.collateralPubKey);
+    tx.vin.push_back(vin);
+    tx.vout.push_back(vout);
+
+    collateralSpent = !AcceptableInputs(mempool, tx, false, NULL);
 }
\ No newline at end of file
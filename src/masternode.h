@@ -39,7 +39,6 @@ using namespace std;
 class CMasternode;
 
 extern CCriticalSection cs_masternodes;
-extern map<int64_t, uint256> mapCacheBlockHashes;
 
 bool GetBlockHash(uint256& hash, int nBlockHeight);
 
@@ -84,6 +83,7 @@ public:
     int nScanningErrorCount;
     int nLastScanningErrorBlockHeight;
     int64_t nLastPaid;
+    bool collateralSpent; // set by CMasternodeMan when the vin is spent, not serialized
 
 
     CMasternode();
@@ -120,6 +120,7 @@ public:
         swap(first.nScanningErrorCount, second.nScanningErrorCount);
         swap(first.nLastScanningErrorBlockHeight, second.nLastScanningErrorBlockHeight);
         swap(first.nLastPaid, second.nLastPaid);
+        swap(first.collateralSpent, second.collateralSpent);
     }
 
     CMasternode& operator=(CMasternode from)
@@ -195,6 +196,10 @@ public:
 
     void Check();
 
+    // Look the vin up in the UTXO set and mempool and set collateralSpent.
+    // Requires cs_main.
+    void CheckCollateral();
+
     bool UpdatedWithin(int seconds)
     {
         // LogPrintf("UpdatedWithin %d, %d --  %d \n", GetAdjustedTime() , lastTimeSeen, (GetAdjustedTime() - lastTimeSeen) < seconds);
@@ -207,7 +212,7 @@ public:
         lastTimeSeen = 0;
     }
 
-    bool IsEnabled()
+    bool IsEnabled() const
     {
         return activeState == MASTERNODE_ENABLED;
     }
@@ -224,7 +229,7 @@ public:
         return cacheInputAge+(pindexBest->nHeight-cacheInputAgeBlock);
     }
 
-    std::string Status() {
+    std::string Status() const {
         std::string strStatus = "ACTIVE";
 
         if(activeState == CMasternode::MASTERNODE_ENABLED) strStatus   = "ENABLED";
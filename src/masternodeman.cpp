@@ -7,26 +7,20 @@
 #include "addrman.h"
 #include <boost/lexical_cast.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/tuple/tuple_comparison.hpp>
+#include <boost/unordered_set.hpp>
 
 
 /** Masternode manager */
 CMasternodeMan mnodeman;
 CCriticalSection cs_process_message;
 
-struct CompareValueOnly
+struct CompareScoreDescending
 {
-    bool operator()(const pair<int64_t, CTxIn>& t1,
-                    const pair<int64_t, CTxIn>& t2) const
+    bool operator()(const pair<unsigned int, CTxIn>& t1,
+                    const pair<unsigned int, CTxIn>& t2) const
     {
-        return t1.first < t2.first;
-    }
-};
-struct CompareValueOnlyMN
-{
-    bool operator()(const pair<int64_t, CMasternode>& t1,
-                    const pair<int64_t, CMasternode>& t2) const
-    {
-        return t1.first < t2.first;
+        return t1.first > t2.first;
     }
 };
 
@@ -189,6 +183,10 @@ void DumpMasternodes()
 
 CMasternodeMan::CMasternodeMan() {
     nDsqCount = 0;
+    nListVersion = 0;
+    nLastReconcile = 0;
+    nSnapshotVersion = -1;
+    nSnapshotTime = 0;
 }
 
 bool CMasternodeMan::Add(CMasternode &mn)
@@ -203,7 +201,10 @@ bool CMasternodeMan::Add(CMasternode &mn)
     if (pmn == NULL)
     {
         LogPrint("masternode", "CMasternodeMan: Adding new masternode %s - %i now\n", mn.addr.ToString().c_str(), size() + 1);
-        vMasternodes.push_back(mn);
+        MasternodeIt it = listMasternodes.insert(listMasternodes.end(), mn);
+        mapByVin.insert(make_pair(mn.vin.prevout, it));
+        IndexPubKey(it);
+        ListChanged();
         return true;
     }
 
@@ -231,22 +232,28 @@ void CMasternodeMan::Check()
 {
     LOCK(cs);
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes)
+    BOOST_FOREACH(CMasternode& mn, listMasternodes)
+    {
+        int prevState = mn.activeState;
         mn.Check();
+        if (mn.activeState != prevState)
+            ListChanged();
+    }
 }
 
 void CMasternodeMan::CheckAndRemove()
 {
     LOCK(cs);
 
+    ReconcileCollaterals();
     Check();
 
     //remove inactive
-    vector<CMasternode>::iterator it = vMasternodes.begin();
-    while(it != vMasternodes.end()){
+    MasternodeIt it = listMasternodes.begin();
+    while(it != listMasternodes.end()){
         if((*it).activeState == CMasternode::MASTERNODE_REMOVE || (*it).activeState == CMasternode::MASTERNODE_VIN_SPENT || (*it).protocolVersion < nMasternodeMinProtocol){
             LogPrint("masternode", "CMasternodeMan: Removing inactive masternode %s - %i now\n", (*it).addr.ToString().c_str(), size() - 1);
-            it = vMasternodes.erase(it);
+            Erase(it++);
         } else {
             ++it;
         }
@@ -287,19 +294,127 @@ void CMasternodeMan::CheckAndRemove()
 void CMasternodeMan::Clear()
 {
     LOCK(cs);
-    vMasternodes.clear();
+    listMasternodes.clear();
+    mapByVin.clear();
+    mapByPubKey.clear();
+    mapRankTables.clear();
+    ListChanged();
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
     nDsqCount = 0;
 }
 
+void CMasternodeMan::RebuildIndexes()
+{
+    LOCK(cs);
+
+    mapByVin.clear();
+    mapByPubKey.clear();
+    for (MasternodeIt it = listMasternodes.begin(); it != listMasternodes.end(); ++it)
+    {
+        mapByVin.insert(make_pair(it->vin.prevout, it));
+        IndexPubKey(it);
+    }
+    ListChanged();
+
+    // loaded entries have not been looked up yet
+    nLastReconcile = 0;
+}
+
+void CMasternodeMan::IndexPubKey(MasternodeIt it)
+{
+    mapByPubKey.insert(make_pair(it->pubkey2, it));
+}
+
+void CMasternodeMan::UnindexPubKey(MasternodeIt it)
+{
+    typedef boost::unordered_multimap<CPubKey, MasternodeIt, CPubKeyHasher>::iterator PubKeyIt;
+    std::pair<PubKeyIt, PubKeyIt> range = mapByPubKey.equal_range(it->pubkey2);
+    for (PubKeyIt mi = range.first; mi != range.second; ++mi)
+    {
+        if (mi->second == it)
+        {
+            mapByPubKey.erase(mi);
+            return;
+        }
+    }
+}
+
+void CMasternodeMan::Erase(MasternodeIt it)
+{
+    AssertLockHeld(cs);
+
+    mapByVin.erase(it->vin.prevout);
+    UnindexPubKey(it);
+    listMasternodes.erase(it);
+    ListChanged();
+}
+
+void CMasternodeMan::SetPubKey(CMasternode* pmn, const CPubKey& pubkey2)
+{
+    LOCK(cs);
+
+    boost::unordered_map<COutPoint, MasternodeIt, COutPointHasher>::iterator mi = mapByVin.find(pmn->vin.prevout);
+    if (mi == mapByVin.end() || &*mi->second != pmn)
+        return;
+
+    UnindexPubKey(mi->second);
+    pmn->pubkey2 = pubkey2;
+    IndexPubKey(mi->second);
+}
+
+void CMasternodeMan::ReconcileCollaterals(bool fForce)
+{
+    LOCK(cs);
+
+    if(!fForce && GetTime() - nLastReconcile < MASTERNODES_RECONCILE_SECONDS) return;
+
+    TRY_LOCK(cs_main, lockMain);
+    if(!lockMain) return;
+
+    int nChanged = 0;
+    BOOST_FOREACH(CMasternode& mn, listMasternodes)
+    {
+        bool fSpent = mn.collateralSpent;
+        mn.CheckCollateral();
+        if(mn.collateralSpent != fSpent) nChanged++;
+    }
+    nLastReconcile = GetTime();
+
+    if(nChanged > 0)
+    {
+        LogPrint("masternode", "CMasternodeMan::ReconcileCollaterals - %d of %d collaterals changed state\n", nChanged, size());
+        ListChanged();
+    }
+}
+
+void CMasternodeMan::SyncTransaction(const CTransaction& tx, bool fSpent)
+{
+    if(tx.IsCoinBase()) return;
+
+    LOCK(cs);
+
+    if(mapByVin.empty()) return;
+
+    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+    {
+        CMasternode* pmn = Find(txin);
+        if(pmn == NULL || pmn->collateralSpent == fSpent) continue;
+
+        LogPrint("masternode", "CMasternodeMan::SyncTransaction - collateral of %s %s by %s\n", pmn->addr.ToString(), fSpent ? "spent" : "unspent", tx.GetHash().ToString());
+        pmn->collateralSpent = fSpent;
+        pmn->Check();
+        ListChanged();
+    }
+}
+
 int CMasternodeMan::CountEnabled(int protocolVersion)
 {
     int i = 0;
     protocolVersion = protocolVersion == -1 ? masternodePayments.GetMinMasternodePaymentsProto() : protocolVersion;
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+    BOOST_FOREACH(CMasternode& mn, listMasternodes) {
         mn.Check();
         if(mn.protocolVersion < protocolVersion || !mn.IsEnabled()) continue;
         i++;
@@ -312,7 +427,7 @@ int CMasternodeMan::CountMasternodesAboveProtocol(int protocolVersion)
 {
     int i = 0;
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+    BOOST_FOREACH(CMasternode& mn, listMasternodes) {
         mn.Check();
         if(mn.protocolVersion < protocolVersion || !mn.IsEnabled()) continue;
         i++;
@@ -342,12 +457,10 @@ CMasternode *CMasternodeMan::Find(const CTxIn &vin)
 {
     LOCK(cs);
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes)
-    {
-        if(mn.vin.prevout == vin.prevout)
-            return &mn;
-    }
-    return NULL;
+    boost::unordered_map<COutPoint, MasternodeIt, COutPointHasher>::iterator mi = mapByVin.find(vin.prevout);
+    if(mi == mapByVin.end())
+        return NULL;
+    return &*mi->second;
 }
 
 CMasternode* CMasternodeMan::FindOldestNotInVec(const std::vector<CTxIn> &vVins, int nMinimumAge)
@@ -356,21 +469,18 @@ CMasternode* CMasternodeMan::FindOldestNotInVec(const std::vector<CTxIn> &vVins,
 
     CMasternode *pOldestMasternode = NULL;
 
-    BOOST_FOREACH(CMasternode &mn, vMasternodes)
+    boost::unordered_set<COutPoint, COutPointHasher> setExclude;
+    BOOST_FOREACH(const CTxIn& vin, vVins)
+        setExclude.insert(vin.prevout);
+
+    BOOST_FOREACH(CMasternode &mn, listMasternodes)
     {   
         mn.Check();
         if(!mn.IsEnabled()) continue;
 
-        if(mn.GetMasternodeInputAge() < nMinimumAge) continue;
+        if(setExclude.count(mn.vin.prevout)) continue;
 
-        bool found = false;
-        BOOST_FOREACH(const CTxIn& vin, vVins)
-            if(mn.vin.prevout == vin.prevout)
-            {   
-                found = true;
-                break;
-            }
-        if(found) continue;
+        if(mn.GetMasternodeInputAge() < nMinimumAge) continue;
 
         if(pOldestMasternode == NULL || pOldestMasternode->SecondsSincePayment() < mn.SecondsSincePayment())
         {
@@ -387,19 +497,19 @@ CMasternode *CMasternodeMan::FindRandom()
 
     if(size() == 0) return NULL;
 
-    return &vMasternodes[GetRandInt(vMasternodes.size())];
+    MasternodeIt it = listMasternodes.begin();
+    std::advance(it, GetRandInt(listMasternodes.size()));
+    return &*it;
 }
 
 CMasternode *CMasternodeMan::Find(const CPubKey &pubKeyMasternode)
 {
     LOCK(cs);
 
-    BOOST_FOREACH(CMasternode& mn, vMasternodes)
-    {
-        if(mn.pubkey2 == pubKeyMasternode)
-            return &mn;
-    }
-    return NULL;
+    boost::unordered_multimap<CPubKey, MasternodeIt, CPubKeyHasher>::iterator mi = mapByPubKey.find(pubKeyMasternode);
+    if(mi == mapByPubKey.end())
+        return NULL;
+    return &*mi->second;
 }
 
 CMasternode *CMasternodeMan::FindRandomNotInVec(std::vector<CTxIn> &vecToExclude, int protocolVersion)
@@ -414,18 +524,14 @@ CMasternode *CMasternodeMan::FindRandomNotInVec(std::vector<CTxIn> &vecToExclude
 
     int rand = GetRandInt(nCountEnabled - vecToExclude.size());
     LogPrintf("CMasternodeMan::FindRandomNotInVec - rand %d\n", rand);
-    bool found;
 
-    BOOST_FOREACH(CMasternode &mn, vMasternodes) {
+    boost::unordered_set<COutPoint, COutPointHasher> setExclude;
+    BOOST_FOREACH(const CTxIn& usedVin, vecToExclude)
+        setExclude.insert(usedVin.prevout);
+
+    BOOST_FOREACH(CMasternode &mn, listMasternodes) {
         if(mn.protocolVersion < protocolVersion || !mn.IsEnabled()) continue;
-        found = false;
-        BOOST_FOREACH(CTxIn &usedVin, vecToExclude) {
-            if(mn.vin.prevout == usedVin.prevout) {
-                found = true;
-                break;
-            }
-        }
-        if(found) continue;
+        if(setExclude.count(mn.vin.prevout)) continue;
         if(--rand < 1) {
             return &mn;
         }
@@ -434,41 +540,40 @@ CMasternode *CMasternodeMan::FindRandomNotInVec(std::vector<CTxIn> &vecToExclude
     return NULL;
 }
 
-CMasternode* CMasternodeMan::GetCurrentMasterNode(int mod, int64_t nBlockHeight, int minProtocol)
+CMasternodeSnapshot CMasternodeMan::GetFullMasternodeVector()
 {
-    unsigned int score = 0;
-    CMasternode* winner = NULL;
-
-    // scan for winner
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-        mn.Check();
-        if(mn.protocolVersion < minProtocol || !mn.IsEnabled()) continue;
+    LOCK(cs);
 
-        // calculate the score for each masternode
-        uint256 n = mn.CalculateScore(mod, nBlockHeight);
-        unsigned int n2 = 0;
-        memcpy(&n2, &n, sizeof(n2));
+    Check();
 
-        // determine the winner
-        if(n2 > score){
-            score = n2;
-            winner = &mn;
-        }
+    // callers only display the list, so a few seconds old copy is fine and
+    // saves copying it again for every caller
+    if(!pSnapshot || nSnapshotVersion != nListVersion || GetTime() - nSnapshotTime >= MASTERNODES_SNAPSHOT_SECONDS)
+    {
+        pSnapshot.reset(new std::vector<CMasternode>(listMasternodes.begin(), listMasternodes.end()));
+        nSnapshotVersion = nListVersion;
+        nSnapshotTime = GetTime();
     }
 
-    return winner;
+    return pSnapshot;
 }
 
-int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
+const CMasternodeRankTable* CMasternodeMan::GetRankTable(int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
 {
-    std::vector<pair<unsigned int, CTxIn> > vecMasternodeScores;
+    AssertLockHeld(cs);
 
     //make sure we know about this block
     uint256 hash = 0;
-    if(!GetBlockHash(hash, nBlockHeight)) return -1;
+    if(!GetBlockHash(hash, nBlockHeight)) return NULL;
 
-    // scan for winner
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+    RankTableKey key(nBlockHeight, minProtocol, fOnlyActive);
+    std::map<RankTableKey, CMasternodeRankTable>::iterator it = mapRankTables.find(key);
+    if (it != mapRankTables.end() && it->second.hashBlock == hash && it->second.nListVersion == nListVersion &&
+        GetTime() - it->second.nTimeBuilt < MASTERNODES_RANK_CACHE_SECONDS)
+        return &it->second;
+
+    std::vector<pair<unsigned int, CTxIn> > vecMasternodeScores;
+    BOOST_FOREACH(CMasternode& mn, listMasternodes) {
 
         if(mn.protocolVersion < minProtocol) continue;
         if(fOnlyActive) {
@@ -483,51 +588,71 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, in
         vecMasternodeScores.push_back(make_pair(n2, mn.vin));
     }
 
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareValueOnly());
+    // stable, so equal scores keep list order and the first of them wins
+    stable_sort(vecMasternodeScores.begin(), vecMasternodeScores.end(), CompareScoreDescending());
 
-    int rank = 0;
-    BOOST_FOREACH (PAIRTYPE(unsigned int, CTxIn)& s, vecMasternodeScores){
-        rank++;
-        if(s.second == vin) {
-            return rank;
-        }
+    if (it == mapRankTables.end())
+    {
+        // forget the lowest heights first
+        if (mapRankTables.size() >= MASTERNODES_RANK_CACHE_SIZE)
+            mapRankTables.erase(mapRankTables.begin());
+        it = mapRankTables.insert(make_pair(key, CMasternodeRankTable())).first;
     }
 
-    return -1;
+    CMasternodeRankTable& table = it->second;
+    table.hashBlock = hash;
+    table.nListVersion = nListVersion;
+    table.nTimeBuilt = GetTime();
+    table.vRanked.clear();
+    table.mapRank.clear();
+    for (unsigned int i = 0; i < vecMasternodeScores.size(); i++)
+    {
+        table.vRanked.push_back(vecMasternodeScores[i].second);
+        table.mapRank.insert(make_pair(vecMasternodeScores[i].second.prevout, (int)i + 1));
+    }
+
+    return &table;
 }
 
-std::vector<pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int64_t nBlockHeight, int minProtocol)
+CMasternode* CMasternodeMan::GetCurrentMasterNode(int mod, int64_t nBlockHeight, int minProtocol)
 {
-    std::vector<pair<unsigned int, CMasternode> > vecMasternodeScores;
-    std::vector<pair<int, CMasternode> > vecMasternodeRanks;
+    LOCK(cs);
 
-    //make sure we know about this block
-    uint256 hash = 0;
-    if(!GetBlockHash(hash, nBlockHeight)) return vecMasternodeRanks;
+    if(nBlockHeight == 0 && pindexBest != NULL)
+        nBlockHeight = pindexBest->nHeight;
 
-    // scan for winner
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+    // the winner is the highest scoring enabled masternode
+    const CMasternodeRankTable* pTable = GetRankTable(nBlockHeight, minProtocol, true);
+    if (pTable == NULL || pTable->vRanked.empty())
+        return NULL;
 
-        mn.Check();
+    return Find(pTable->vRanked[0]);
+}
 
-        if(mn.protocolVersion < minProtocol) continue;
-        if(!mn.IsEnabled()) {
-            continue;
-        }
+int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
+{
+    LOCK(cs);
 
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        unsigned int n2 = 0;
-        memcpy(&n2, &n, sizeof(n2));
+    const CMasternodeRankTable* pTable = GetRankTable(nBlockHeight, minProtocol, fOnlyActive);
+    if (pTable == NULL) return -1;
 
-        vecMasternodeScores.push_back(make_pair(n2, mn));
-    }
+    return pTable->GetRank(vin);
+}
 
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareValueOnlyMN());
+std::vector<pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int64_t nBlockHeight, int minProtocol)
+{
+    LOCK(cs);
+
+    std::vector<pair<int, CMasternode> > vecMasternodeRanks;
 
-    int rank = 0;
-    BOOST_FOREACH (PAIRTYPE(unsigned int, CMasternode)& s, vecMasternodeScores){
-        rank++;
-        vecMasternodeRanks.push_back(make_pair(rank, s.second));
+    const CMasternodeRankTable* pTable = GetRankTable(nBlockHeight, minProtocol, true);
+    if (pTable == NULL) return vecMasternodeRanks;
+
+    for (unsigned int i = 0; i < pTable->vRanked.size(); i++)
+    {
+        CMasternode* pmn = Find(pTable->vRanked[i]);
+        if (pmn != NULL)
+            vecMasternodeRanks.push_back(make_pair((int)i + 1, *pmn));
     }
 
     return vecMasternodeRanks;
@@ -535,35 +660,13 @@ std::vector<pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int64_t
 
 CMasternode* CMasternodeMan::GetMasternodeByRank(int nRank, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
 {
-    std::vector<pair<unsigned int, CTxIn> > vecMasternodeScores;
-
-    // scan for winner
-    BOOST_FOREACH(CMasternode& mn, vMasternodes) {
-
-        if(mn.protocolVersion < minProtocol) continue;
-        if(fOnlyActive) {
-            mn.Check();
-            if(!mn.IsEnabled()) continue;
-        }
-
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        unsigned int n2 = 0;
-        memcpy(&n2, &n, sizeof(n2));
-
-        vecMasternodeScores.push_back(make_pair(n2, mn.vin));
-    }
-
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareValueOnly());
+    LOCK(cs);
 
-    int rank = 0;
-    BOOST_FOREACH (PAIRTYPE(unsigned int, CTxIn)& s, vecMasternodeScores){
-        rank++;
-        if(rank == nRank) {
-            return Find(s.second);
-        }
-    }
+    const CMasternodeRankTable* pTable = GetRankTable(nBlockHeight, minProtocol, fOnlyActive);
+    if (pTable == NULL || nRank < 1 || nRank > (int)pTable->vRanked.size())
+        return NULL;
 
-    return NULL;
+    return Find(pTable->vRanked[nRank - 1]);
 }
 
 void CMasternodeMan::ProcessMasternodeConnections()
@@ -679,7 +782,7 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
 
                 if(pmn->sigTime < sigTime){ //take the newest entry
                     LogPrintf("dsee - Got updated entry for %s\n", addr.ToString().c_str());
-                    pmn->pubkey2 = pubkey2;
+                    SetPubKey(pmn, pubkey2);
                     pmn->sigTime = sigTime;
                     pmn->sig = vchSig;
                     pmn->protocolVersion = protocolVersion;
@@ -687,6 +790,7 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
                     pmn->donationAddress = donationAddress;
                     pmn->donationPercentage = donationPercentage;
                     pmn->Check();
+                    ListChanged();
                     if(pmn->IsEnabled())
                         mnodeman.RelayMasternodeEntry(vin, addr, vchSig, sigTime, pubkey, pubkey2, count, current, lastUpdated, protocolVersion, donationAddress, donationPercentage);
                 }
@@ -706,10 +810,10 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         LogPrint("masternode", "dsee - Got NEW masternode entry %s\n", addr.ToString().c_str());
 
         // make sure it's still unspent
-        //  - this is checked later by .check() in many places and by ThreadCheckAnonSendPool()
+        //  - later spends are picked up by SyncTransaction() and ReconcileCollaterals()
 
         CValidationState state;
-        CTransaction tx = CTransaction();
+        CMutableTransaction tx;
         CTxOut vout = CTxOut(ANONSEND_POOL_MAX, anonSendPool.collateralPubKey);
         tx.vin.push_back(vin);
         tx.vout.push_back(vout);
@@ -731,13 +835,14 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
             // verify that sig time is legit in past
             // should be at least not earlier than block when 50,000 MarteX tx got MASTERNODE_MIN_CONFIRMATIONS
             uint256 hashBlock = 0;
-            GetTransaction(vin.prevout.hash, tx, hashBlock);
-            map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+            CTransaction txVin;
+            GetTransaction(vin.prevout.hash, txVin, hashBlock);
+            BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
            if (mi != mapBlockIndex.end() && (*mi).second)
             {
                 CBlockIndex* pMNIndex = (*mi).second; // block for 50,000 MarteX tx -> 1 confirmation
                 CBlockIndex* pConfIndex = FindBlockByHeight((pMNIndex->nHeight + MASTERNODE_MIN_CONFIRMATIONS - 1)); // block where tx got MASTERNODE_MIN_CONFIRMATIONS
-                if(pConfIndex->GetBlockTime() > sigTime)
+                if(pConfIndex && pConfIndex->GetBlockTime() > sigTime)
                 {
                     LogPrintf("dsee - Bad sigTime %d for masternode %20s %105s (%i conf block is at %d)\n",
                               sigTime, addr.ToString(), vin.ToString(), MASTERNODE_MIN_CONFIRMATIONS, pConfIndex->GetBlockTime());
@@ -824,7 +929,11 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
 
                 if(!pmn->UpdatedWithin(MASTERNODE_MIN_DSEEP_SECONDS))
                 {
-                    if(stop) pmn->Disable();
+                    if(stop) {
+                        pmn->Disable();
+                        pmn->Check();
+                        ListChanged();
+                    }
                     else
                     {
                         pmn->UpdateLastSeen();
@@ -915,7 +1024,7 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         int count = this->size();
         int i = 0;
 
-        BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+        BOOST_FOREACH(CMasternode& mn, listMasternodes) {
 
             if(mn.addr.IsRFC1918()) continue; //local network
 
@@ -956,13 +1065,10 @@ void CMasternodeMan::Remove(CTxIn vin)
 {
     LOCK(cs);
 
-    vector<CMasternode>::iterator it = vMasternodes.begin();
-    while(it != vMasternodes.end()){
-        if((*it).vin == vin){
-            LogPrint("masternode", "CMasternodeMan: Removing Masternode %s - %i now\n", (*it).addr.ToString().c_str(), size() - 1);
-            vMasternodes.erase(it);
-            break;
-        }
+    boost::unordered_map<COutPoint, MasternodeIt, COutPointHasher>::iterator mi = mapByVin.find(vin.prevout);
+    if(mi != mapByVin.end()){
+        LogPrint("masternode", "CMasternodeMan: Removing Masternode %s - %i now\n", mi->second->addr.ToString().c_str(), size() - 1);
+        Erase(mi->second);
     }
 }
 
@@ -970,7 +1076,7 @@ std::string CMasternodeMan::ToString() const
 {
     std::ostringstream info;
 
-    info << "masternodes: " << (int)vMasternodes.size() <<
+    info << "masternodes: " << (int)listMasternodes.size() <<
             ", peers who asked us for masternode list: " << (int)mAskedUsForMasternodeList.size() <<
             ", peers we asked for masternode list: " << (int)mWeAskedForMasternodeList.size() <<
             ", entries in Masternode list we asked for: " << (int)mWeAskedForMasternodeListEntry.size() <<
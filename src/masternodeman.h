@@ -17,8 +17,17 @@
 #include "main.h"
 #include "masternode.h"
 
+#include <list>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
 #define MASTERNODES_DUMP_SECONDS               (15*60)
 #define MASTERNODES_DSEG_SECONDS               (3*60*60)
+#define MASTERNODES_RANK_CACHE_SECONDS         (60)
+#define MASTERNODES_RANK_CACHE_SIZE            (32)
+#define MASTERNODES_RECONCILE_SECONDS          (10*60)
+#define MASTERNODES_SNAPSHOT_SECONDS           (5)
 
 using namespace std;
 
@@ -28,6 +37,41 @@ extern CMasternodeMan mnodeman;
 
 void DumpMasternodes();
 
+/** Masternode pubkeys hashed by the start of their x coordinate */
+struct CPubKeyHasher
+{
+    size_t operator()(const CPubKey& key) const
+    {
+        size_t n = 0;
+        if (key.size() > sizeof(n))
+            memcpy(&n, key.begin() + 1, sizeof(n));
+        return n;
+    }
+};
+
+/** Read-only copy of the masternode list, shared by everyone who asks for
+ *  it until it goes stale */
+typedef boost::shared_ptr<const std::vector<CMasternode> > CMasternodeSnapshot;
+
+/** Masternodes of one block height ordered by score, highest first */
+class CMasternodeRankTable
+{
+public:
+    uint256 hashBlock;      // block the scores were calculated from
+    int nListVersion;       // CMasternodeMan list version it was built at
+    int64_t nTimeBuilt;
+
+    std::vector<CTxIn> vRanked; // vRanked[i] has rank i + 1
+    boost::unordered_map<COutPoint, int, COutPointHasher> mapRank;
+
+    // Rank of vin, or -1 if it is not ranked
+    int GetRank(const CTxIn& vin) const
+    {
+        boost::unordered_map<COutPoint, int, COutPointHasher>::const_iterator it = mapRank.find(vin.prevout);
+        return it == mapRank.end() ? -1 : it->second;
+    }
+};
+
 /** Access to the MN database (mncache.dat) */
 class CMasternodeDB
 {
@@ -56,8 +100,13 @@ private:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
 
-    // map to hold all MNs
-    std::vector<CMasternode> vMasternodes;
+    // all MNs, in the order they were added. List nodes never move, so a
+    // CMasternode* returned by Find() stays valid until that entry is removed
+    typedef std::list<CMasternode>::iterator MasternodeIt;
+    std::list<CMasternode> listMasternodes;
+    // indexes into listMasternodes by collateral and by masternode pubkey
+    boost::unordered_map<COutPoint, MasternodeIt, COutPointHasher> mapByVin;
+    boost::unordered_multimap<CPubKey, MasternodeIt, CPubKeyHasher> mapByPubKey;
     // who's asked for the masternode list and the last time
     std::map<CNetAddr, int64_t> mAskedUsForMasternodeList;
     // who we asked for the masternode list and the last time
@@ -65,6 +114,36 @@ private:
     // which masternodes we've asked for
     std::map<COutPoint, int64_t> mWeAskedForMasternodeListEntry;
 
+    // Rank tables by (height, min protocol, only active). A table is rebuilt
+    // when the list changed since, its block was reorganized away or it is
+    // older than MASTERNODES_RANK_CACHE_SECONDS, which bounds how long state
+    // changes made outside of CMasternodeMan go unnoticed.
+    typedef boost::tuple<int64_t, int, bool> RankTableKey;
+    std::map<RankTableKey, CMasternodeRankTable> mapRankTables;
+    int nListVersion;
+
+    const CMasternodeRankTable* GetRankTable(int64_t nBlockHeight, int minProtocol, bool fOnlyActive);
+    void ListChanged() { nListVersion++; }
+
+    // Spends are matched against mapByVin as transactions enter the mempool
+    // or the chain, so Check() only has to read CMasternode::collateralSpent.
+    // Every MASTERNODES_RECONCILE_SECONDS all collaterals are looked up again
+    // to catch what the notifications miss, like mempool transactions that
+    // were dropped.
+    int64_t nLastReconcile;
+
+    // GetFullMasternodeVector() result, rebuilt when the list changed or it
+    // is older than MASTERNODES_SNAPSHOT_SECONDS
+    CMasternodeSnapshot pSnapshot;
+    int nSnapshotVersion;
+    int64_t nSnapshotTime;
+
+    void RebuildIndexes();
+    void IndexPubKey(MasternodeIt it);
+    void UnindexPubKey(MasternodeIt it);
+    void Erase(MasternodeIt it);
+    void SetPubKey(CMasternode* pmn, const CPubKey& pubkey2);
+
 public:
     // keep track of dsq count to prevent masternodes from gaming anonsend queue
     int64_t nDsqCount;
@@ -73,16 +152,18 @@ public:
     (
         // serialized format:
         // * version byte (currently 0)
-        // * masternodes vector
+        // * masternodes vector (listMasternodes has the same encoding)
         {
                 LOCK(cs);
                 unsigned char nVersion = 0;
                 READWRITE(nVersion);
-                READWRITE(vMasternodes);
+                READWRITE(listMasternodes);
                 READWRITE(mAskedUsForMasternodeList);
                 READWRITE(mWeAskedForMasternodeList);
                 READWRITE(mWeAskedForMasternodeListEntry);
                 READWRITE(nDsqCount);
+                if (fRead)
+                    const_cast<CMasternodeMan*>(this)->RebuildIndexes();
         }
     )
 
@@ -104,6 +185,14 @@ public:
     // Clear masternode vector
     void Clear();
 
+    // Look up all collaterals in the UTXO set and mempool, at most every
+    // MASTERNODES_RECONCILE_SECONDS unless fForce
+    void ReconcileCollaterals(bool fForce = false);
+
+    // Mark the masternodes whose collateral tx spends as spent (fSpent), or
+    // as unspent again when tx was disconnected from the chain
+    void SyncTransaction(const CTransaction& tx, bool fSpent);
+
     int CountEnabled(int protocolVersion = -1);
 
     int CountMasternodesAboveProtocol(int protocolVersion);
@@ -126,7 +215,7 @@ public:
     // Get the current winner for this block
     CMasternode* GetCurrentMasterNode(int mod=1, int64_t nBlockHeight=0, int minProtocol=0);
 
-    std::vector<CMasternode> GetFullMasternodeVector() { Check(); return vMasternodes; }
+    CMasternodeSnapshot GetFullMasternodeVector();
 
     std::vector<pair<int, CMasternode> > GetMasternodeRanks(int64_t nBlockHeight, int minProtocol=0);
     int GetMasternodeRank(const CTxIn &vin, int64_t nBlockHeight, int minProtocol=0, bool fOnlyActive=true);
@@ -137,7 +226,7 @@ public:
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 
     // Return the number of (unique) masternodes
-    int size() { return vMasternodes.size(); }
+    int size() { return listMasternodes.size(); }
 
     std::string ToString() const;
 
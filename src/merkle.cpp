@@ -0,0 +1,48 @@
+// Copyright (c) 2014-2018 The MarteX developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "merkle.h"
+
+#include "crypto/sha256.h"
+
+#include <string.h>
+
+/** Hash the nSize entries at pLevel pairwise into pOut; pOut may alias
+ *  pLevel, since every pair is read before its digest is written. */
+static void HashLevel(const uint256* pLevel, size_t nSize, uint256* pOut)
+{
+    SHA256D64(pOut->begin(), pLevel->begin(), nSize / 2);
+    if (nSize & 1)
+    {
+        unsigned char pair[64];
+        memcpy(pair, pLevel[nSize - 1].begin(), 32);
+        memcpy(pair + 32, pLevel[nSize - 1].begin(), 32);
+        SHA256D64(pOut[nSize / 2].begin(), pair, 1);
+    }
+}
+
+uint256 ComputeMerkleRoot(std::vector<uint256>& vHashes)
+{
+    if (vHashes.empty())
+        return 0;
+    for (size_t nSize = vHashes.size(); nSize > 1; nSize = (nSize + 1) / 2)
+        HashLevel(&vHashes[0], nSize, &vHashes[0]);
+    return vHashes[0];
+}
+
+void ComputeMerkleTree(std::vector<uint256>& vTree)
+{
+    size_t nLeaves = vTree.size();
+    size_t nTotal = nLeaves;
+    for (size_t nSize = nLeaves; nSize > 1; nSize = (nSize + 1) / 2)
+        nTotal += (nSize + 1) / 2;
+    vTree.resize(nTotal);
+
+    size_t j = 0;
+    for (size_t nSize = nLeaves; nSize > 1; nSize = (nSize + 1) / 2)
+    {
+        HashLevel(&vTree[j], nSize, &vTree[j + nSize]);
+        j += nSize;
+    }
+}
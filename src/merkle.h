@@ -0,0 +1,28 @@
+// Copyright (c) 2014-2018 The MarteX developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_MERKLE_H
+#define BITCOIN_MERKLE_H
+
+#include "uint256.h"
+
+#include <vector>
+
+/** Merkle tree hashing. Each level is hashed as one batch of adjacent
+ *  64-byte pairs with SHA256D64(), which runs several pairs side by side on
+ *  the SIMD backends, instead of one Hash() call per pair. A level with an
+ *  odd number of entries pairs its last entry with itself, as
+ *  CBlock::BuildMerkleTree() always has.
+ */
+
+/** Merkle root of vHashes, computed in place: vHashes is overwritten with
+ *  the intermediate levels and needs no further allocation. Returns 0 for
+ *  an empty vector. */
+uint256 ComputeMerkleRoot(std::vector<uint256>& vHashes);
+
+/** Extend vTree, which holds the leaves, with the levels above them up to
+ *  the root, in the layout CBlock::vMerkleTree and GetMerkleBranch() use.
+ *  Reusing vTree's capacity, this allocates nothing either. */
+void ComputeMerkleTree(std::vector<uint256>& vTree);
+
+#endif // BITCOIN_MERKLE_H
@@ -55,51 +55,29 @@ void SHA256Transform(void* pstate, void* pinput, const void* pinit)
         ((uint32_t*)pstate)[i] = ctx.h[i];
 }
 
-// Some explaining would be appreciated
-class COrphan
-{
-public:
-    CTransaction* ptx;
-    set<uint256> setDependsOn;
-    double dPriority;
-    double dFeePerKb;
-
-    COrphan(CTransaction* ptxIn)
-    {
-        ptx = ptxIn;
-        dPriority = dFeePerKb = 0;
-    }
-};
-
-
 uint64_t nLastBlockTx = 0;
 uint64_t nLastBlockSize = 0;
 int64_t nLastCoinStakeSearchInterval = 0;
- 
-// We want to sort transactions by priority and fee, so:
-typedef boost::tuple<double, double, CTransaction*> TxPriority;
-class TxPriorityCompare
+
+// Outcome of FetchInputs/ConnectInputs for a memory pool transaction on top
+// of one tip. Those only depend on the tip and on which inputs are outputs
+// of transactions earlier in the block, so templates built on the same tip
+// only check transactions that were added to the pool since, or whose pool
+// parents changed.
+class CTemplateTxCheck
 {
-    bool byFee;
 public:
-    TxPriorityCompare(bool _byFee) : byFee(_byFee) { }
-    bool operator()(const TxPriority& a, const TxPriority& b)
-    {
-        if (byFee)
-        {
-            if (a.get<1>() == b.get<1>())
-                return a.get<0>() < b.get<0>();
-            return a.get<1>() < b.get<1>();
-        }
-        else
-        {
-            if (a.get<0>() == b.get<0>())
-                return a.get<1>() < b.get<1>();
-            return a.get<0>() < b.get<0>();
-        }
-    }
+    bool fValid;
+    int64_t nFees;
+    unsigned int nP2SHSigOps;
+    std::vector<bool> vInBlock;  // per input, spends a transaction of the block
 };
 
+// Checks made for templates on hashTemplateTip, guarded by cs_main
+static uint256 hashTemplateTip;
+static unsigned int nTemplateTxUpdated = 0;
+static map<uint256, CTemplateTxCheck> mapTemplateChecks;
+ 
 // CreateNewBlock: create new block (without proof-of-work/proof-of-stake)
 CBlock* CreateNewBlock(CReserveKey& reservekey, bool fProofOfStake, int64_t* pFees)
 {
@@ -112,7 +90,7 @@ CBlock* CreateNewBlock(CReserveKey& reservekey, bool fProofOfStake, int64_t* pFe
     int nHeight = pindexPrev->nHeight + 1;
 
     // Create coinbase tx
-    CTransaction txNew;
+    CMutableTransaction txNew;
     txNew.vin.resize(1);
     txNew.vin[0].prevout.SetNull();
     txNew.vout.resize(1);
@@ -251,80 +229,32 @@ CBlock* CreateNewBlock(CReserveKey& reservekey, bool fProofOfStake, int64_t* pFe
         LOCK2(cs_main, mempool.cs);
         CTxDB txdb("r");
         //> MXT <
-        // Priority order to process transactions
-        list<COrphan> vOrphan; // list memory doesn't move
-        map<uint256, vector<COrphan*> > mapDependers;
-
-        // This vector will be sorted into a priority queue:
-        vector<TxPriority> vecPriority;
-        vecPriority.reserve(mempool.mapTx.size());
-        for (map<uint256, CTransaction>::iterator mi = mempool.mapTx.begin(); mi != mempool.mapTx.end(); ++mi)
+        // The memory pool keeps transactions ordered by priority and by fee
+        // rate, with input values and ages cached at acceptance, so templates
+        // are assembled by walking those orderings instead of re-reading and
+        // re-sorting every input of every pool transaction.
+        mempool.UpdatePriorities(pindexPrev->nHeight);
+
+        // Input checks made for earlier templates stay valid on the same tip
+        if (hashTemplateTip != pindexPrev->GetBlockHash())
         {
-            CTransaction& tx = (*mi).second;
-            if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, nHeight))
-                continue;
-
-            COrphan* porphan = NULL;
-            double dPriority = 0;
-            int64_t nTotalIn = 0;
-            bool fMissingInputs = false;
-            BOOST_FOREACH(const CTxIn& txin, tx.vin)
-            {
-                // Read prev transaction
-                CTransaction txPrev;
-                CTxIndex txindex;
-                if (!txPrev.ReadFromDisk(txdb, txin.prevout, txindex))
-                {
-                    // This should never happen; all transactions in the memory
-                    // pool should connect to either transactions in the chain
-                    // or other transactions in the memory pool.
-                    if (!mempool.mapTx.count(txin.prevout.hash))
-                    {
-                        LogPrintf("ERROR: mempool transaction missing input\n");
-                        if (fDebug) assert("mempool transaction missing input" == 0);
-                        fMissingInputs = true;
-                        if (porphan)
-                            vOrphan.pop_back();
-                        break;
-                    }
-
-                    // Has to wait for dependencies
-                    if (!porphan)
-                    {
-                        // Use list for automatic deletion
-                        vOrphan.push_back(COrphan(&tx));
-                        porphan = &vOrphan.back();
-                    }
-                    mapDependers[txin.prevout.hash].push_back(porphan);
-                    porphan->setDependsOn.insert(txin.prevout.hash);
-                    nTotalIn += mempool.mapTx[txin.prevout.hash].vout[txin.prevout.n].nValue;
-                    continue;
-                }
-                int64_t nValueIn = txPrev.vout[txin.prevout.n].nValue;
-                nTotalIn += nValueIn;
-
-                int nConf = txindex.GetDepthInMainChain();
-                dPriority += (double)nValueIn * nConf;
-            }
-            if (fMissingInputs) continue;
-
-            // Priority is sum(valuein * age) / txsize
-            unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-            dPriority /= nTxSize;
-
-            // This is a more accurate fee-per-kilobyte than is used by the client code, because the
-            // client code rounds up the size to the nearest 1K. That's good, because it gives an
-            // incentive to create smaller transactions.
-            double dFeePerKb =  double(nTotalIn-tx.GetValueOut()) / (double(nTxSize)/1000.0);
-
-            if (porphan)
+            mapTemplateChecks.clear();
+            hashTemplateTip = pindexPrev->GetBlockHash();
+        }
+        else if (nTemplateTxUpdated != mempool.GetTransactionsUpdated())
+        {
+            // Forget the transactions that left the pool
+            map<uint256, CTemplateTxCheck>::iterator itCheck = mapTemplateChecks.begin();
+            while (itCheck != mapTemplateChecks.end())
             {
-                porphan->dPriority = dPriority;
-                porphan->dFeePerKb = dFeePerKb;
+                if (mempool.mapTx.count(itCheck->first))
+                    ++itCheck;
+                else
+                    mapTemplateChecks.erase(itCheck++);
             }
-            else
-                vecPriority.push_back(TxPriority(dPriority, dFeePerKb, &(*mi).second));
         }
+        nTemplateTxUpdated = mempool.GetTransactionsUpdated();
+        unsigned int nChecked = 0;
 
         // Collect transactions into block
         map<uint256, CTxIndex> mapTestPool;
@@ -333,21 +263,62 @@ CBlock* CreateNewBlock(CReserveKey& reservekey, bool fProofOfStake, int64_t* pFe
         int nBlockSigOps = 100;
         bool fSortedByFee = (nBlockPrioritySize <= 0);
 
-        TxPriorityCompare comparer(fSortedByFee);
-        std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
+        set<uint256> setConsidered;              // taken off an ordering, included or not
+        set<uint256> setInBlock;
+        map<uint256, vector<uint256> > mapDependers; // pool parent -> children waiting on it
+        deque<uint256> vReady;                   // children whose pool parents are all in the block
+        set<pair<double, uint256> >::reverse_iterator itPriority = mempool.setByPriority.rbegin();
+        set<pair<double, uint256> >::reverse_iterator itFeeRate = mempool.setByFeeRate.rbegin();
 
-        while (!vecPriority.empty())
+        while (true)
         {
-            // Take highest priority transaction off the priority queue:
-            double dPriority = vecPriority.front().get<0>();
-            double dFeePerKb = vecPriority.front().get<1>();
-            CTransaction& tx = *(vecPriority.front().get<2>());
+            // Take the next transaction: unblocked children first, then by
+            // priority until the priority area is full, then by fee rate
+            uint256 hash;
+            if (!vReady.empty())
+            {
+                hash = vReady.front();
+                vReady.pop_front();
+            }
+            else if (!fSortedByFee && itPriority != mempool.setByPriority.rend())
+                hash = (itPriority++)->second;
+            else if (itFeeRate != mempool.setByFeeRate.rend())
+            {
+                fSortedByFee = true;
+                hash = (itFeeRate++)->second;
+            }
+            else
+                break;
+
+            if (setConsidered.count(hash))
+                continue;
+            CTransaction& tx = mempool.mapTx[hash];
+            const CTxMemPoolEntry& entry = mempool.mapEntry[hash];
+            double dPriority = entry.GetPriority(pindexPrev->nHeight);
+            double dFeePerKb = entry.GetFeePerKb();
 
-            std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
-            vecPriority.pop_back();
+            if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, nHeight))
+            {
+                setConsidered.insert(hash);
+                continue;
+            }
+
+            // Has to wait for parents still in the memory pool
+            bool fWaiting = false;
+            BOOST_FOREACH(const CTxIn& txin, tx.vin)
+            {
+                if (mempool.mapTx.count(txin.prevout.hash) && !setInBlock.count(txin.prevout.hash))
+                {
+                    mapDependers[txin.prevout.hash].push_back(hash);
+                    fWaiting = true;
+                }
+            }
+            if (fWaiting)
+                continue;
+            setConsidered.insert(hash);
 
             // Size limits
-            unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+            unsigned int nTxSize = entry.nTxSize;
             if (nBlockSize + nTxSize >= nBlockMaxSize)
                 continue;
 
@@ -370,34 +341,60 @@ CBlock* CreateNewBlock(CReserveKey& reservekey, bool fProofOfStake, int64_t* pFe
                 ((nBlockSize + nTxSize >= nBlockPrioritySize) || (dPriority < COIN * 144 / 250)))
             {
                 fSortedByFee = true;
-                comparer = TxPriorityCompare(fSortedByFee);
-                std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
             }
 
-            // Connecting shouldn't fail due to dependency on other memory pool transactions
-            // because we're already processing them in order of dependency
-            map<uint256, CTxIndex> mapTestPoolTmp(mapTestPool);
-            MapPrevTx mapInputs;
-            bool fInvalid;
-            if (!tx.FetchInputs(txdb, mapTestPoolTmp, false, true, mapInputs, fInvalid))
+            // Only check the inputs if this tip hasn't seen the transaction
+            // with the same inputs coming from the block
+            vector<bool> vInBlock(tx.vin.size());
+            for (unsigned int i = 0; i < tx.vin.size(); i++)
+                vInBlock[i] = setInBlock.count(tx.vin[i].prevout.hash) != 0;
+            map<uint256, CTxIndex> mapTestPoolTmp;
+            bool fChecked = false;
+            map<uint256, CTemplateTxCheck>::iterator itCheck = mapTemplateChecks.find(hash);
+            if (itCheck == mapTemplateChecks.end() || itCheck->second.vInBlock != vInBlock)
+            {
+                CTemplateTxCheck check;
+                check.fValid = false;
+                check.nFees = 0;
+                check.nP2SHSigOps = 0;
+                check.vInBlock = vInBlock;
+
+                // Connecting shouldn't fail due to dependency on other memory pool transactions
+                // because we're already processing them in order of dependency
+                mapTestPoolTmp = mapTestPool;
+                MapPrevTx mapInputs;
+                bool fInvalid;
+                if (tx.FetchInputs(txdb, mapTestPoolTmp, false, true, mapInputs, fInvalid))
+                {
+                    check.nFees = tx.GetValueIn(mapInputs)-tx.GetValueOut();
+                    check.nP2SHSigOps = GetP2SHSigOpCount(tx, mapInputs);
+
+                    // Note that flags: we don't want to set mempool/IsStandard()
+                    // policy here, but we still have to ensure that the block we
+                    // create only contains transactions that are valid in new blocks.
+                    check.fValid = tx.ConnectInputs(txdb, mapInputs, mapTestPoolTmp, CDiskTxPos(1,1,1), pindexPrev, false, true, MANDATORY_SCRIPT_VERIFY_FLAGS);
+                }
+                mapTemplateChecks[hash] = check;
+                itCheck = mapTemplateChecks.find(hash);
+                fChecked = true;
+                nChecked++;
+            }
+            if (!itCheck->second.fValid)
                 continue;
 
-            int64_t nTxFees = tx.GetValueIn(mapInputs)-tx.GetValueOut();
+            int64_t nTxFees = itCheck->second.nFees;
 
-            nTxSigOps += GetP2SHSigOpCount(tx, mapInputs);
+            nTxSigOps += itCheck->second.nP2SHSigOps;
             if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS)
                 continue;
 
-            // Note that flags: we don't want to set mempool/IsStandard()
-            // policy here, but we still have to ensure that the block we
-            // create only contains transactions that are valid in new blocks.
-            if (!tx.ConnectInputs(txdb, mapInputs, mapTestPoolTmp, CDiskTxPos(1,1,1), pindexPrev, false, true, MANDATORY_SCRIPT_VERIFY_FLAGS))
-                continue;
-            mapTestPoolTmp[tx.GetHash()] = CTxIndex(CDiskTxPos(1,1,1), tx.vout.size());
-            swap(mapTestPool, mapTestPoolTmp);
+            if (fChecked)
+                swap(mapTestPool, mapTestPoolTmp);
+            mapTestPool[hash] = CTxIndex(CDiskTxPos(1,1,1), tx.vout.size());
 
             // Added
             pblock->vtx.push_back(tx);
+            setInBlock.insert(hash);
             nBlockSize += nTxSize;
             ++nBlockTx;
             nBlockSigOps += nTxSigOps;
@@ -409,22 +406,14 @@ CBlock* CreateNewBlock(CReserveKey& reservekey, bool fProofOfStake, int64_t* pFe
                        dPriority, dFeePerKb, tx.GetHash().ToString());
             }
 
-            // Add transactions that depend on this one to the priority queue
-            uint256 hash = tx.GetHash();
-            if (mapDependers.count(hash))
+            // Transactions that depend on this one may be ready now; the
+            // dependency check above re-queues any still waiting on others
+            map<uint256, vector<uint256> >::iterator itDependers = mapDependers.find(hash);
+            if (itDependers != mapDependers.end())
             {
-                BOOST_FOREACH(COrphan* porphan, mapDependers[hash])
-                {
-                    if (!porphan->setDependsOn.empty())
-                    {
-                        porphan->setDependsOn.erase(hash);
-                        if (porphan->setDependsOn.empty())
-                        {
-                            vecPriority.push_back(TxPriority(porphan->dPriority, porphan->dFeePerKb, porphan->ptx));
-                            std::push_heap(vecPriority.begin(), vecPriority.end(), comparer);
-                        }
-                    }
-                }
+                BOOST_FOREACH(const uint256& hashDepender, itDependers->second)
+                    vReady.push_back(hashDepender);
+                mapDependers.erase(itDependers);
             }
         }
 
@@ -452,8 +441,7 @@ CBlock* CreateNewBlock(CReserveKey& reservekey, bool fProofOfStake, int64_t* pFe
 	            txNew.vout[1].nValue = masternodePayment;
 	            txNew.vout[0].nValue = blockValue;
 
-	            pblock->vtx[0].vout[0].nValue = blockValue;
-	            pblock->vtx[0].vout[1].nValue = masternodePayment;
+	            pblock->vtx[0] = txNew;
 				
 	        }
 			else if (!fProofOfStake && bfoundationPay){  //miner + masternode + foundation
@@ -465,19 +453,21 @@ CBlock* CreateNewBlock(CReserveKey& reservekey, bool fProofOfStake, int64_t* pFe
 				txNew.vout[1].nValue = masternodePayment;
 				txNew.vout[2].nValue = foundationPayment;				
 
-				pblock->vtx[0].vout[0].nValue = blockValue;
-				pblock->vtx[0].vout[1].nValue = masternodePayment;
-				pblock->vtx[0].vout[2].nValue = foundationPayment;
+				pblock->vtx[0] = txNew;
 	        }
         }
         nLastBlockTx = nBlockTx;
         nLastBlockSize = nBlockSize;
 
         if (fDebug && GetBoolArg("-printpriority", false))
-            LogPrintf("CreateNewBlock(): total size %u\n", nBlockSize);
+            LogPrintf("CreateNewBlock(): total size %u, inputs checked for %u of %u transactions\n",
+                      nBlockSize, nChecked, (unsigned int)setConsidered.size());
 
         if (!fProofOfStake && (GetTime() <= REWARD_MN_POW_SWITCH_TIME))
-            pblock->vtx[0].vout[0].nValue = GetProofOfWorkReward(pindexPrev->nHeight + 1, nFees);
+        {
+            txNew.vout[0].nValue = GetProofOfWorkReward(pindexPrev->nHeight + 1, nFees);
+            pblock->vtx[0] = txNew;
+        }
 
         if (pFees)
             *pFees = nFees;
@@ -506,8 +496,11 @@ void IncrementExtraNonce(CBlock* pblock, CBlockIndex* pindexPrev, unsigned int&
     ++nExtraNonce;
 
     unsigned int nHeight = pindexPrev->nHeight+1; // Height first in coinbase required for block.version=2
-    pblock->vtx[0].vin[0].scriptSig = (CScript() << nHeight << CBigNum(nExtraNonce)) + COINBASE_FLAGS;
-    assert(pblock->vtx[0].vin[0].scriptSig.size() <= 100);
+    CMutableTransaction txCoinbase(pblock->vtx[0]);
+    txCoinbase.vin[0].scriptSig = (CScript() << nHeight << CBigNum(nExtraNonce)) + COINBASE_FLAGS;
+    assert(txCoinbase.vin[0].scriptSig.size() <= 100);
+
+    pblock->vtx[0] = txCoinbase;
 
     pblock->hashMerkleRoot = pblock->BuildMerkleTree();
 }
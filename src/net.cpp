@@ -63,6 +63,7 @@ map<CInv, CDataStream> mapRelay;
 deque<pair<int64_t, CInv> > vRelayExpiration;
 CCriticalSection cs_mapRelay;
 limitedmap<CInv, int64_t> mapAlreadyAskedFor(MAX_INV_SZ);
+CNetBufferPool netBufferPool;
 
 static deque<string> vOneShots;
 CCriticalSection cs_vOneShots;
@@ -576,22 +577,51 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes)
     return true;
 }
 
+void CNetBufferPool::Get(CSerializeData& data)
+{
+    LOCK(cs);
+    if (!vBuffers.empty())
+    {
+        data.swap(vBuffers.back());
+        vBuffers.pop_back();
+    }
+}
+
+void CNetBufferPool::Put(CSerializeData& data)
+{
+    if (data.capacity() == 0 || data.capacity() > MAX_BUFFER_SIZE)
+        return;
+    data.clear();
+    LOCK(cs);
+    if (vBuffers.size() < MAX_BUFFERS)
+    {
+        vBuffers.push_back(CSerializeData());
+        vBuffers.back().swap(data);
+    }
+}
+
 int CNetMessage::readHeader(const char *pch, unsigned int nBytes)
 {
-    // copy data to temporary parsing buffer
     unsigned int nRemaining = 24 - nHdrPos;
     unsigned int nCopy = std::min(nRemaining, nBytes);
 
-    memcpy(&hdrbuf[nHdrPos], pch, nCopy);
-    nHdrPos += nCopy;
+    // Parse a header that arrived in one piece straight from the receive
+    // buffer, otherwise collect it in hdrbuf first
+    const char *pchHdr = pch;
+    if (nHdrPos > 0 || nCopy < 24)
+    {
+        memcpy(&hdrbuf[nHdrPos], pch, nCopy);
+        nHdrPos += nCopy;
 
-    // if header incomplete, exit
-    if (nHdrPos < 24)
-        return nCopy;
+        // if header incomplete, exit
+        if (nHdrPos < 24)
+            return nCopy;
+        pchHdr = hdrbuf;
+    }
 
     // deserialize to CMessageHeader
     try {
-        hdrbuf >> hdr;
+        CSpanStream(pchHdr, pchHdr + 24, vRecv.nType, vRecv.nVersion) >> hdr;
     }
     catch (std::exception &e) {
         return -1;
@@ -603,6 +633,14 @@ int CNetMessage::readHeader(const char *pch, unsigned int nBytes)
 
     // switch state to reading message data
     in_data = true;
+    if (hdr.nMessageSize > 0)
+    {
+        CSerializeData data;
+        netBufferPool.Get(data);
+        vRecv.swap(data);
+        // Reserve up to 256 KiB ahead, but never more than the total message size.
+        vRecv.reserve(std::min(hdr.nMessageSize, (unsigned int)CNetBufferPool::MAX_BUFFER_SIZE));
+    }
 
     return nCopy;
 }
@@ -612,12 +650,9 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
     unsigned int nRemaining = hdr.nMessageSize - nDataPos;
     unsigned int nCopy = std::min(nRemaining, nBytes);
 
-    if (vRecv.size() < nDataPos + nCopy) {
-        // Allocate up to 256 KiB ahead, but never more than the total message size.
-        vRecv.resize(std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024));
-    }
-
-    memcpy(&vRecv[nDataPos], pch, nCopy);
+    // Append what arrived; the buffer grows with the data actually received
+    // rather than with the size the header claims
+    vRecv.write(pch, nCopy);
     nDataPos += nCopy;
 
     return nCopy;
@@ -648,6 +683,7 @@ void SocketSendData(CNode *pnode)
             if (pnode->nSendOffset == data.size()) {
                 pnode->nSendOffset = 0;
                 pnode->nSendSize -= data.size();
+                netBufferPool.Put(*it);
                 it++;
             } else {
                 // could not send full message; stop sending more
@@ -1505,6 +1541,8 @@ void ThreadMessageHandler()
             boost::this_thread::interruption_point();
         }
 
+        g_signals.FlushMessages();
+
         {
             LOCK(cs_vNodes);
             BOOST_FOREACH(CNode* pnode, vNodesCopy)
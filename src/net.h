@@ -76,6 +76,9 @@ struct CNodeSignals
     boost::signals2::signal<int ()> GetHeight;
     boost::signals2::signal<bool (CNode*)> ProcessMessages;
     boost::signals2::signal<bool (CNode*, bool)> SendMessages;
+    // once per message handler pass, after every node was served, for work
+    // batched across nodes
+    boost::signals2::signal<void ()> FlushMessages;
     boost::signals2::signal<void (NodeId, const CNode*)> InitializeNode;
     boost::signals2::signal<void (NodeId)> FinalizeNode;
 };
@@ -177,24 +180,55 @@ public:
 
 
 
+/** Recycles the buffers of sent and received messages. Message payloads are
+ *  public data, so a buffer going back to the pool keeps its capacity and is
+ *  neither freed nor wiped; only buffers the pool cannot take are released
+ *  through the zeroing allocator.
+ */
+class CNetBufferPool
+{
+private:
+    std::vector<CSerializeData> vBuffers;
+    CCriticalSection cs;
+
+public:
+    // Buffers above this capacity, i.e. most blocks, are not kept
+    static const size_t MAX_BUFFER_SIZE = 256 * 1024;
+    static const size_t MAX_BUFFERS = 128;
+
+    // Swap an empty recycled buffer into data, which must be empty
+    void Get(CSerializeData& data);
+    // Take back data's storage, leaving data empty
+    void Put(CSerializeData& data);
+};
+
+extern CNetBufferPool netBufferPool;
+
+
 class CNetMessage {
 public:
     bool in_data;                   // parsing header (false) or data (true)
 
-    CDataStream hdrbuf;             // partially received header
+    char hdrbuf[24];                // partially received header
     CMessageHeader hdr;             // complete header
     unsigned int nHdrPos;
 
     CDataStream vRecv;              // received message data
     unsigned int nDataPos;
 
-    CNetMessage(int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), vRecv(nTypeIn, nVersionIn) {
-        hdrbuf.resize(24);
+    CNetMessage(int nTypeIn, int nVersionIn) : vRecv(nTypeIn, nVersionIn) {
         in_data = false;
         nHdrPos = 0;
         nDataPos = 0;
     }
 
+    ~CNetMessage()
+    {
+        CSerializeData data;
+        vRecv.swap(data);
+        netBufferPool.Put(data);
+    }
+
     bool complete() const
     {
         if (!in_data)
@@ -204,7 +238,6 @@ public:
 
     void SetVersion(int nVersionIn)
     {
-        hdrbuf.SetVersion(nVersionIn);
         vRecv.SetVersion(nVersionIn);
     }
 
@@ -569,6 +602,7 @@ public:
         LogPrint("net", "(%d bytes)\n", nSize);
 
         std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), CSerializeData());
+        netBufferPool.Get(*it);
         ssSend.GetAndClear(*it);
         nSendSize += (*it).size();
 
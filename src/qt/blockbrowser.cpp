@@ -59,10 +59,9 @@ std::string getBlockHash(int Height)
     if (desiredheight < 0 || desiredheight > nBestHeight)
         return 0;
 
-    CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hashBestChain];
-    while (pblockindex->nHeight > desiredheight)
-        pblockindex = pblockindex->pprev;
+    CBlockIndex* pblockindex = FindBlockByHeight(desiredheight);
+    if (pblockindex == NULL)
+        return "351c6703813172725c6d660aa539ee6a3d7a9fe784c87fae7f36582e3b797058";
     return pblockindex->phashBlock->GetHex();
 }
 
@@ -523,7 +523,7 @@ void CoinControlDialog::updateLabels(WalletModel *model, QDialog* dialog)
     qint64 nPayAmount = 0;
     bool fLowOutput = false;
     bool fDust = false;
-    CTransaction txDummy;
+    CMutableTransaction txDummy;
     const int listSize = CoinControlDialog::payAmounts.size();
     clock_t begin = clock();
     //for (int i = 0; i < listSize; ++i)
@@ -118,8 +118,8 @@ void MasternodeManager::updateNodeList()
     ui->countLabel->setText("Updating...");
     ui->tableWidget->clearContents();
     ui->tableWidget->setRowCount(0);
-    std::vector<CMasternode> vMasternodes = mnodeman.GetFullMasternodeVector();
-    BOOST_FOREACH(CMasternode& mn, vMasternodes)
+    CMasternodeSnapshot vMasternodes = mnodeman.GetFullMasternodeVector();
+    BOOST_FOREACH(const CMasternode& mn, *vMasternodes)
     {
         int mnRow = 0;
         ui->tableWidget->insertRow(0);
@@ -269,7 +269,7 @@ void MasternodeManager::on_UpdateButton_clicked()
         std::string strDonateAddress = "";
         std::string strDonationPercentage = "";
 
-        std::vector<CMasternode> vMasternodes = mnodeman.GetFullMasternodeVector();
+        CMasternodeSnapshot vMasternodes = mnodeman.GetFullMasternodeVector();
         if (errorMessage == ""){
             updateAdrenalineNode(QString::fromStdString(mne.getAlias()), QString::fromStdString(mne.getIp()), QString::fromStdString(mne.getPrivKey()), QString::fromStdString(mne.getTxHash()),
                 QString::fromStdString(mne.getOutputIndex()), QString::fromStdString("Not in the masternode list."));
@@ -279,7 +279,7 @@ void MasternodeManager::on_UpdateButton_clicked()
                 QString::fromStdString(mne.getOutputIndex()), QString::fromStdString(errorMessage));
         }
 
-        BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+        BOOST_FOREACH(const CMasternode& mn, *vMasternodes) {
             if (mn.addr.ToString().c_str() == mne.getIp()){
                 updateAdrenalineNode(QString::fromStdString(mne.getAlias()), QString::fromStdString(mne.getIp()), QString::fromStdString(mne.getPrivKey()), QString::fromStdString(mne.getTxHash()),
                 QString::fromStdString(mne.getOutputIndex()), QString::fromStdString("Masternode is Running."));
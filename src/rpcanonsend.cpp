@@ -10,6 +10,7 @@
 #include "activemasternode.h"
 #include "masternodeman.h"
 #include "masternodeconfig.h"
+#include "fasttx.h"
 #include "rpcserver.h"
 #include <boost/lexical_cast.hpp>
 //#include "amount.h"
@@ -789,8 +790,8 @@ Value masternodelist(const Array& params, bool fHelp)
             obj.push_back(Pair(strVin,       s.first));
         }
     } else {
-        std::vector<CMasternode> vMasternodes = mnodeman.GetFullMasternodeVector();
-        BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+        CMasternodeSnapshot vMasternodes = mnodeman.GetFullMasternodeVector();
+        BOOST_FOREACH(const CMasternode& mn, *vMasternodes) {
             std::string strVin = mn.vin.prevout.ToStringShort();
             if (strMode == "activeseconds") {
                 if(strFilter !="" && strVin.find(strFilter) == string::npos) continue;
@@ -882,3 +883,46 @@ Value masternodelist(const Array& params, bool fHelp)
     return obj;
 
 }
+
+Value getfasttxstats(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getfasttxstats\n"
+            "Returns counters of the FastTx transaction locks seen by this node, the\n"
+            "latency from lock request to " + boost::lexical_cast<std::string>(FASTTX_SIGNATURES_REQUIRED) + " signatures in milliseconds, and\n"
+            "the number of requests, votes and locks held in memory.\n");
+
+    Object latency;
+    latency.push_back(Pair("samples",   (uint64_t)fastTxStats.nLatencySamples));
+    latency.push_back(Pair("average",   fastTxStats.nLatencySamples ? fastTxStats.nLatencyTotal / (int64_t)fastTxStats.nLatencySamples : 0));
+    latency.push_back(Pair("max",       fastTxStats.nLatencyMax));
+
+    Object buckets;
+    for (unsigned int i = 0; i < FASTTX_LATENCY_BUCKET_COUNT; i++)
+    {
+        std::string strBucket = i < FASTTX_LATENCY_BUCKET_COUNT - 1 ?
+            "<" + boost::lexical_cast<std::string>(FASTTX_LATENCY_BUCKETS[i]) :
+            ">=" + boost::lexical_cast<std::string>(FASTTX_LATENCY_BUCKETS[i - 1]);
+        buckets.push_back(Pair(strBucket, (uint64_t)fastTxStats.vLatencyBuckets[i]));
+    }
+    latency.push_back(Pair("buckets",   buckets));
+
+    Object obj;
+    obj.push_back(Pair("requests",      (uint64_t)fastTxStats.nLockRequests));
+    obj.push_back(Pair("completed",     (uint64_t)fastTxStats.nLocksCompleted));
+    obj.push_back(Pair("expired",       (uint64_t)fastTxStats.nLocksExpired));
+    obj.push_back(Pair("votes",         (uint64_t)fastTxStats.nVotesAccepted));
+    obj.push_back(Pair("latency",       latency));
+
+    Object sizes;
+    sizes.push_back(Pair("locks",       (uint64_t)mapTxLocks.size()));
+    sizes.push_back(Pair("requests",    (uint64_t)mapTxLockReq.size()));
+    sizes.push_back(Pair("rejected",    (uint64_t)mapTxLockReqRejected.size()));
+    sizes.push_back(Pair("votes",       (uint64_t)mapTxLockVote.size()));
+    sizes.push_back(Pair("lockedinputs", (uint64_t)mapLockedInputs.size()));
+    sizes.push_back(Pair("votecache",   (uint64_t)consensusVoteCache.size()));
+    obj.push_back(Pair("inmemory",      sizes));
+
+    return obj;
+}
@@ -7,6 +7,8 @@
 #include "main.h"
 #include "kernel.h"
 #include "checkpoints.h"
+#include "smessage.h"
+#include "txdb.h"
 
 using namespace json_spirit;
 using namespace std;
@@ -230,6 +232,8 @@ Value getblockhash(const Array& params, bool fHelp)
         throw runtime_error("Block number out of range.");
 
     CBlockIndex* pblockindex = FindBlockByHeight(nHeight);
+    if (pblockindex == NULL)
+        throw runtime_error("Block number out of range.");
     return pblockindex->phashBlock->GetHex();
 }
 
@@ -267,18 +271,49 @@ Value getblockbynumber(const Array& params, bool fHelp)
         throw runtime_error("Block number out of range.");
 
     CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hashBestChain];
-    while (pblockindex->nHeight > nHeight)
-        pblockindex = pblockindex->pprev;
-
-    uint256 hash = *pblockindex->phashBlock;
-
-    pblockindex = mapBlockIndex[hash];
+    CBlockIndex* pblockindex = FindBlockByHeight(nHeight);
+    if (pblockindex == NULL)
+        throw runtime_error("Block number out of range.");
     block.ReadFromDisk(pblockindex, true);
 
     return blockToJSON(block, pblockindex, params.size() > 1 ? params[1].get_bool() : false);
 }
 
+Value getdbstats(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getdbstats\n"
+            "Returns LevelDB compaction statistics and approximate on-disk sizes of the\n"
+            "transaction index, block index and address index.\n");
+
+    CTxDB txdb("r");
+    Object txdbObj;
+    txdbObj.push_back(Pair("bulkload", CTxDB::IsBulkLoading()));
+
+    Object sizes;
+    const char* prefixes[] = { "tx", "blockindex", "adr", "adx" };
+    BOOST_FOREACH(const char* prefix, prefixes)
+        sizes.push_back(Pair(prefix, (uint64_t)txdb.GetApproximateSize(prefix)));
+    txdbObj.push_back(Pair("sizes", sizes));
+    txdbObj.push_back(Pair("stats", txdb.GetStats()));
+
+    Object result;
+    result.push_back(Pair("txdb", txdbObj));
+
+    std::string strStats;
+    {
+        LOCK(cs_smsgDB);
+        if (SecMsgDB::GetStats(strStats))
+        {
+            Object smsgObj;
+            smsgObj.push_back(Pair("stats", strStats));
+            result.push_back(Pair("smsgdb", smsgObj));
+        }
+    }
+    return result;
+}
+
 // ppcoin: get information of sync-checkpoint
 Value getcheckpoint(const Array& params, bool fHelp)
 {
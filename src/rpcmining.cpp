@@ -227,7 +227,9 @@ Value checkkernel(const Array& params, bool fHelp)
     int64_t nFees;
     auto_ptr<CBlock> pblock(CreateNewBlock(*pMiningKey, true, &nFees));
 
-    pblock->nTime = pblock->vtx[0].nTime = nTime;
+    CMutableTransaction txCoinbase(pblock->vtx[0]);
+    pblock->nTime = txCoinbase.nTime = nTime;
+    pblock->vtx[0] = txCoinbase;
 
     CDataStream ss(SER_DISK, PROTOCOL_VERSION);
     ss << *pblock;
@@ -265,6 +267,11 @@ Value getworkex(const Array& params, bool fHelp)
     static mapNewBlock_t mapNewBlock;
     static vector<CBlock*> vNewBlock;
 
+    // the saved blocks are shared by all RPC threads and their headers and
+    // hash caches get written below, so one request at a time
+    static CCriticalSection cs_getworkex;
+    LOCK(cs_getworkex);
+
     if (params.size() == 0)
     {
         // Update block
@@ -362,7 +369,11 @@ Value getworkex(const Array& params, bool fHelp)
         pblock->nNonce = pdata->nNonce;
 
         if(coinbase.size() == 0)
-            pblock->vtx[0].vin[0].scriptSig = mapNewBlock[pdata->hashMerkleRoot].second;
+        {
+            CMutableTransaction txCoinbase(pblock->vtx[0]);
+            txCoinbase.vin[0].scriptSig = mapNewBlock[pdata->hashMerkleRoot].second;
+            pblock->vtx[0] = txCoinbase;
+        }
         else
             CDataStream(coinbase, SER_NETWORK, PROTOCOL_VERSION) >> pblock->vtx[0]; // FIXME - HACK!
 
@@ -396,9 +407,13 @@ Value getwork(const Array& params, bool fHelp)
         throw JSONRPCError(RPC_MISC_ERROR, "No more PoW blocks");
 
     typedef map<uint256, pair<CBlock*, CScript> > mapNewBlock_t;
-    static mapNewBlock_t mapNewBlock;    // FIXME: thread safety
+    static mapNewBlock_t mapNewBlock;
     static vector<CBlock*> vNewBlock;
 
+    // the saved blocks are shared by all RPC threads, see getworkex
+    static CCriticalSection cs_getwork;
+    LOCK(cs_getwork);
+
     if (params.size() == 0)
     {
         // Update block
@@ -481,7 +496,10 @@ Value getwork(const Array& params, bool fHelp)
 
         pblock->nTime = pdata->nTime;
         pblock->nNonce = pdata->nNonce;
-        pblock->vtx[0].vin[0].scriptSig = mapNewBlock[pdata->hashMerkleRoot].second;
+
+        CMutableTransaction txCoinbase(pblock->vtx[0]);
+        txCoinbase.vin[0].scriptSig = mapNewBlock[pdata->hashMerkleRoot].second;
+        pblock->vtx[0] = txCoinbase;
         pblock->hashMerkleRoot = pblock->BuildMerkleTree();
 
         assert(pwalletMain != NULL);
@@ -1831,7 +1831,7 @@ Value gettransaction(const Array& params, bool fHelp)
             else
             {
                 entry.push_back(Pair("blockhash", hashBlock.GetHex()));
-                map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+                BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
                 if (mi != mapBlockIndex.end() && (*mi).second)
                 {
                     CBlockIndex* pindex = (*mi).second;
@@ -2514,9 +2514,7 @@ Value scanforalltxns(const Array& params, bool fHelp)
     if (nFromHeight > 0)
     {
         pindex = mapBlockIndex[hashBestChain];
-        while (pindex->nHeight > nFromHeight
-            && pindex->pprev)
-            pindex = pindex->pprev;
+        pindex = pindex->GetAncestor(std::min(nFromHeight, pindex->nHeight));
     };
 
     if (pindex == NULL)
@@ -2558,9 +2556,7 @@ Value scanforstealthtxns(const Array& params, bool fHelp)
     if (nFromHeight > 0)
     {
         pindex = mapBlockIndex[hashBestChain];
-        while (pindex->nHeight > nFromHeight
-            && pindex->pprev)
-            pindex = pindex->pprev;
+        pindex = pindex->GetAncestor(std::min(nFromHeight, pindex->nHeight));
     };
 
     if (pindex == NULL)
@@ -2620,6 +2616,8 @@ Value cclistcoins(const Array& params, bool fHelp)
                 Object coutput;
                 int64_t nHeight = nBestHeight - out.nDepth;
                 CBlockIndex* pindex = FindBlockByHeight(nHeight);
+                if (pindex == NULL)
+                    continue;
 
                 CTxDestination outputAddress;
                 ExtractDestination(out.tx->vout[out.i].scriptPubKey, outputAddress);
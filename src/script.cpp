@@ -4,8 +4,6 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <boost/foreach.hpp>
-#include <boost/tuple/tuple.hpp>
-#include <boost/tuple/tuple_comparison.hpp>
 
 using namespace std;
 using namespace boost;
@@ -2158,7 +2156,7 @@ uint256 SignatureHash(CScript scriptCode, const CTransaction& txTo, unsigned int
         LogPrintf("ERROR: SignatureHash() : nIn=%d out of range\n", nIn);
         return 1;
     }
-    CTransaction txTmp(txTo);
+    CMutableTransaction txTmp(txTo);
 
     // In case concatenating two scripts ends up with two codeseparators,
     // or an extra one at the end, this prevents all those possible incompatibilities.
@@ -2213,14 +2211,18 @@ uint256 SignatureHash(CScript scriptCode, const CTransaction& txTo, unsigned int
 }
 
 
-bool SignSignature(const CKeyStore &keystore, const CScript& fromPubKey, CTransaction& txTo, unsigned int nIn, int nHashType)
+bool SignSignature(const CKeyStore &keystore, const CScript& fromPubKey, CMutableTransaction& txTo, unsigned int nIn, int nHashType)
 {
     assert(nIn < txTo.vin.size());
     CTxIn& txin = txTo.vin[nIn];
 
+    // Signature hashes blank every scriptSig, so one immutable snapshot
+    // serves the hashing and the final verification below.
+    const CTransaction txToConst(txTo);
+
     // Leave out the signature from the hash, since a signature can't sign itself.
     // The checksig op will also drop the signatures from its hash.
-    uint256 hash = SignatureHash(fromPubKey, txTo, nIn, nHashType);
+    uint256 hash = SignatureHash(fromPubKey, txToConst, nIn, nHashType);
 
     txnouttype whichType;
     if (!Solver(keystore, fromPubKey, hash, nHashType, txin.scriptSig, whichType))
@@ -2234,7 +2236,7 @@ bool SignSignature(const CKeyStore &keystore, const CScript& fromPubKey, CTransa
         CScript subscript = txin.scriptSig;
 
         // Recompute txn hash using subscript in place of scriptPubKey:
-        uint256 hash2 = SignatureHash(subscript, txTo, nIn, nHashType);
+        uint256 hash2 = SignatureHash(subscript, txToConst, nIn, nHashType);
 
         txnouttype subType;
         bool fSolved =
@@ -2245,10 +2247,10 @@ bool SignSignature(const CKeyStore &keystore, const CScript& fromPubKey, CTransa
     }
 
     // Test solution
-    return VerifyScript(txin.scriptSig, fromPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, SignatureChecker(txTo, nIn));
+    return VerifyScript(txin.scriptSig, fromPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, SignatureChecker(txToConst, nIn));
 }
 
-bool SignSignature(const CKeyStore &keystore, const CTransaction& txFrom, CTransaction& txTo, unsigned int nIn, int nHashType)
+bool SignSignature(const CKeyStore &keystore, const CTransaction& txFrom, CMutableTransaction& txTo, unsigned int nIn, int nHashType)
 {
     assert(nIn < txTo.vin.size());
     CTxIn& txin = txTo.vin[nIn];
@@ -2268,52 +2270,99 @@ bool SignSignature(const CKeyStore &keystore, const CTransaction& txFrom, CTrans
 class CSignatureCache
 {
 private:
-     // sigdata_type is (signature hash, signature, public key):
-    typedef boost::tuple<uint256, std::vector<unsigned char>, CPubKey> sigdata_type;
-    std::set< sigdata_type> setValid;
-    boost::shared_mutex cs_sigcache;
+    // Entries are spread over a fixed number of independently locked
+    // shards; each shard is an open-addressing table of salted digests of
+    // (signature hash, signature, public key), probed linearly over a short
+    // window. A zero digest marks an empty slot.
+    static const unsigned int nShards = 16;
+    static const unsigned int nProbe = 8;
+
+    uint256 nonce;
+    std::vector<uint256> vTable;
+    unsigned int nShardMask;
+    boost::shared_mutex cs_sigcache[nShards];
+
+    void ComputeEntry(uint256& entry, const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey)
+    {
+        CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(vchSig.empty() ? NULL : &vchSig[0], vchSig.size()).Write(pubKey.begin(), pubKey.size()).Finalize(entry.begin());
+    }
+
+    // The digest is salted, so its bits can pick the shard and the slot
+    // without giving an attacker control over collisions.
+    unsigned int Shard(const uint256& entry) const { return entry.Get64(0) & (nShards - 1); }
+    unsigned int Base(const uint256& entry) const { return Shard(entry) * (nShardMask + 1); }
+    unsigned int Start(const uint256& entry) const { return entry.Get64(1) & nShardMask; }
 
 public:
+    CSignatureCache() : nShardMask(0)
+    {
+        nonce = GetRandHash();
+
+        // -maxsigcachesize is in megabytes, 0 disables the cache
+        int64_t nMaxCacheSize = GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE);
+        if (nMaxCacheSize <= 0)
+            return;
+        uint64_t nEntries = (uint64_t)std::min(nMaxCacheSize, (int64_t)16384) * 1024 * 1024 / sizeof(uint256) / nShards;
+        unsigned int nPerShard = nProbe;
+        while ((uint64_t)nPerShard * 2 <= nEntries)
+            nPerShard *= 2;
+        nShardMask = nPerShard - 1;
+        vTable.resize((size_t)nPerShard * nShards);
+        LogPrintf("Using %u MiB for the signature cache (%u entries)\n", (unsigned int)((vTable.size() * sizeof(uint256)) >> 20), (unsigned int)vTable.size());
+    }
+
     bool
     Get(const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey)
     {
-        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        if (vTable.empty())
+            return false;
 
-        sigdata_type k(hash, vchSig, pubKey);
-        std::set<sigdata_type>::iterator mi = setValid.find(k);
-        if (mi != setValid.end())
-            return true;
+        uint256 entry;
+        ComputeEntry(entry, hash, vchSig, pubKey);
+        unsigned int nBase = Base(entry), nStart = Start(entry);
+
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache[Shard(entry)]);
+        for (unsigned int i = 0; i < nProbe; i++)
+        {
+            const uint256& slot = vTable[nBase + ((nStart + i) & nShardMask)];
+            if (slot == entry)
+                return true;
+            // Slots are only ever overwritten, never cleared, so the first
+            // empty slot ends the probe sequence
+            if (slot == 0)
+                return false;
+        }
         return false;
     }
 
     void Set(const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey)
     {
-        // DoS prevention: limit cache size to less than 10MB
-        // (~200 bytes per cache entry times 50,000 entries)
-        // Since there are a maximum of 20,000 signature operations per block
-        // 50,000 is a reasonable default.
-        int64_t nMaxCacheSize = GetArg("-maxsigcachesize", 50000);
-        if (nMaxCacheSize <= 0) return;
+        if (vTable.empty())
+            return;
 
-        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        uint256 entry;
+        ComputeEntry(entry, hash, vchSig, pubKey);
+        unsigned int nBase = Base(entry), nStart = Start(entry);
 
-        while (static_cast<int64_t>(setValid.size()) > nMaxCacheSize)
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache[Shard(entry)]);
+        for (unsigned int i = 0; i < nProbe; i++)
         {
-            // Evict a random entry. Random because that helps
-            // foil would-be DoS attackers who might try to pre-generate
-            // and re-use a set of valid signatures just-slightly-greater
-            // than our cache size.
-            uint256 randomHash = GetRandHash();
-            std::vector<unsigned char> unused;
-            std::set<sigdata_type>::iterator it =
-                setValid.lower_bound(sigdata_type(randomHash, unused, unused));
-            if (it == setValid.end())
-                it = setValid.begin();
-            setValid.erase(*it);
+            uint256& slot = vTable[nBase + ((nStart + i) & nShardMask)];
+            if (slot == entry)
+                return;
+            if (slot == 0)
+            {
+                slot = entry;
+                return;
+            }
         }
 
-        sigdata_type k(hash, vchSig, pubKey);
-        setValid.insert(k);
+        // Window is full: evict a slot picked by the salted digest. This
+        // stays unpredictable to would-be DoS attackers who might try to
+        // pre-generate and re-use a set of valid signatures, without
+        // drawing randomness while the lock is held.
+        unsigned int nVictim = entry.Get64(2) % nProbe;
+        vTable[nBase + ((nStart + nVictim) & nShardMask)] = entry;
     }
 };
 
@@ -2932,14 +2981,18 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigne
 }
 
 
-/*bool SignSignature(const CKeyStore &keystore, const CScript& fromPubKey, CTransaction& txTo, unsigned int nIn, int nHashType)
+/*bool SignSignature(const CKeyStore &keystore, const CScript& fromPubKey, CMutableTransaction& txTo, unsigned int nIn, int nHashType)
 {
     assert(nIn < txTo.vin.size());
     CTxIn& txin = txTo.vin[nIn];
 
+    // Signature hashes blank every scriptSig, so one immutable snapshot
+    // serves the hashing and the final verification below.
+    const CTransaction txToConst(txTo);
+
     // Leave out the signature from the hash, since a signature can't sign itself.
     // The checksig op will also drop the signatures from its hash.
-    uint256 hash = SignatureHash(fromPubKey, txTo, nIn, nHashType);
+    uint256 hash = SignatureHash(fromPubKey, txToConst, nIn, nHashType);
 
     txnouttype whichType;
     if (!Solver(keystore, fromPubKey, hash, nHashType, txin.scriptSig, whichType))
@@ -2953,7 +3006,7 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigne
         CScript subscript = txin.scriptSig;
 
         // Recompute txn hash using subscript in place of scriptPubKey:
-        uint256 hash2 = SignatureHash(subscript, txTo, nIn, nHashType);
+        uint256 hash2 = SignatureHash(subscript, txToConst, nIn, nHashType);
 
         txnouttype subType;
         bool fSolved =
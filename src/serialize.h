@@ -8,6 +8,7 @@
 
 #include <string>
 #include <vector>
+#include <list>
 #include <map>
 #include <set>
 #include <cassert>
@@ -480,6 +481,11 @@ template<typename K, typename Pred, typename A> unsigned int GetSerializeSize(co
 template<typename Stream, typename K, typename Pred, typename A> void Serialize(Stream& os, const std::set<K, Pred, A>& m, int nType, int nVersion);
 template<typename Stream, typename K, typename Pred, typename A> void Unserialize(Stream& is, std::set<K, Pred, A>& m, int nType, int nVersion);
 
+// list
+template<typename T, typename A> unsigned int GetSerializeSize(const std::list<T, A>& l, int nType, int nVersion);
+template<typename Stream, typename T, typename A> void Serialize(Stream& os, const std::list<T, A>& l, int nType, int nVersion);
+template<typename Stream, typename T, typename A> void Unserialize(Stream& is, std::list<T, A>& l, int nType, int nVersion);
+
 
 
 
@@ -814,6 +820,40 @@ void Unserialize(Stream& is, std::set<K, Pred, A>& m, int nType, int nVersion)
 
 
 
+//
+// list, same encoding as a vector of the elements
+//
+template<typename T, typename A>
+unsigned int GetSerializeSize(const std::list<T, A>& l, int nType, int nVersion)
+{
+    unsigned int nSize = GetSizeOfCompactSize(l.size());
+    for (typename std::list<T, A>::const_iterator it = l.begin(); it != l.end(); ++it)
+        nSize += GetSerializeSize((*it), nType, nVersion);
+    return nSize;
+}
+
+template<typename Stream, typename T, typename A>
+void Serialize(Stream& os, const std::list<T, A>& l, int nType, int nVersion)
+{
+    WriteCompactSize(os, l.size());
+    for (typename std::list<T, A>::const_iterator it = l.begin(); it != l.end(); ++it)
+        Serialize(os, (*it), nType, nVersion);
+}
+
+template<typename Stream, typename T, typename A>
+void Unserialize(Stream& is, std::list<T, A>& l, int nType, int nVersion)
+{
+    l.clear();
+    unsigned int nSize = ReadCompactSize(is);
+    for (unsigned int i = 0; i < nSize; i++)
+    {
+        l.push_back(T());
+        Unserialize(is, l.back(), nType, nVersion);
+    }
+}
+
+
+
 //
 // Support for IMPLEMENT_SERIALIZE and READWRITE macro
 //
@@ -1183,9 +1223,85 @@ public:
     }
 
     void GetAndClear(CSerializeData &data) {
+        if (data.empty() && nReadPos == 0) {
+            // Hand over the buffer itself; data's storage is kept for reuse
+            vch.swap(data);
+            clear();
+            return;
+        }
         data.insert(data.end(), begin(), end());
         clear();
     }
+
+    // Exchange the underlying buffer, e.g. with a recycled one. Reading
+    // restarts at the beginning of the new contents.
+    void swap(vector_type& other) { vch.swap(other); nReadPos = 0; }
+};
+
+
+/** Read-only deserialization stream over memory it does not own, such as a
+ *  network receive buffer or a CMappedFile. Reading past the end throws
+ *  std::ios_base::failure and sets eof(), so a caller can tell a short
+ *  buffer from malformed data.
+ */
+class CSpanStream
+{
+private:
+    const char* pbegin;
+    const char* pcur;
+    const char* pend;
+    bool fEof;
+
+public:
+    int nType;
+    int nVersion;
+
+    CSpanStream(const char* pbeginIn, const char* pendIn, int nTypeIn, int nVersionIn) :
+        pbegin(pbeginIn), pcur(pbeginIn), pend(pendIn), fEof(false), nType(nTypeIn), nVersion(nVersionIn) {}
+
+    bool eof() const          { return fEof; }
+    size_t tell() const       { return pcur - pbegin; }
+    size_t size() const       { return pend - pcur; }
+    bool empty() const        { return pcur == pend; }
+    int in_avail()            { return size(); }
+
+    CSpanStream& read(char* pch, size_t nSize)
+    {
+        if (nSize > (size_t)(pend - pcur))
+        {
+            fEof = true;
+            throw std::ios_base::failure("CSpanStream::read() : end of data");
+        }
+        memcpy(pch, pcur, nSize);
+        pcur += nSize;
+        return (*this);
+    }
+
+    CSpanStream& ignore(size_t nSize)
+    {
+        if (nSize > (size_t)(pend - pcur))
+        {
+            fEof = true;
+            throw std::ios_base::failure("CSpanStream::ignore() : end of data");
+        }
+        pcur += nSize;
+        return (*this);
+    }
+
+    template<typename T>
+    unsigned int GetSerializeSize(const T& obj)
+    {
+        // Tells the size of the object if serialized to this stream
+        return ::GetSerializeSize(obj, nType, nVersion);
+    }
+
+    template<typename T>
+    CSpanStream& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
 };
 
 
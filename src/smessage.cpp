@@ -82,6 +82,7 @@ CCriticalSection cs_smsgDB;
 CCriticalSection cs_smsgThreads;
 
 leveldb::DB *smsgDB = NULL;
+leveldb::Options smsgDBOptions;
 
 
 namespace fs = boost::filesystem;
@@ -184,6 +185,21 @@ void SecMsgBucket::hashBucket()
 };
 
 
+void SecMsgDB::Close()
+{
+    delete smsgDB;
+    smsgDB = NULL;
+    delete smsgDBOptions.filter_policy;
+    smsgDBOptions.filter_policy = NULL;
+    delete smsgDBOptions.block_cache;
+    smsgDBOptions.block_cache = NULL;
+};
+
+bool SecMsgDB::GetStats(std::string& strStats)
+{
+    return smsgDB && smsgDB->GetProperty("leveldb.stats", &strStats);
+};
+
 bool SecMsgDB::Open(const char* pszMode)
 {
     if (smsgDB)
@@ -204,13 +220,14 @@ bool SecMsgDB::Open(const char* pszMode)
         return false;
     };
 
-    leveldb::Options options;
-    options.create_if_missing = fCreate;
-    leveldb::Status s = leveldb::DB::Open(options, fullpath.string(), &smsgDB);
+    smsgDBOptions = GetLevelDBOptions(8 << 20, false);
+    smsgDBOptions.create_if_missing = fCreate;
+    leveldb::Status s = leveldb::DB::Open(smsgDBOptions, fullpath.string(), &smsgDB);
 
     if (!s.ok())
     {
         LogPrint("smessage", "SecMsgDB::open() - Error opening db: %s.\n", s.ToString().c_str());
+        SecMsgDB::Close();
         return false;
     };
 
@@ -1159,8 +1176,7 @@ bool SecureMsgShutdown()
     if (smsgDB)
     {
         LOCK(cs_smsgDB);
-        delete smsgDB;
-        smsgDB = NULL;
+        SecMsgDB::Close();
     };
 
     return true;
@@ -1278,8 +1294,7 @@ bool SecureMsgDisable()
     if (smsgDB)
     {
         LOCK(cs_smsgDB);
-        delete smsgDB;
-        smsgDB = NULL;
+        SecMsgDB::Close();
     };
 
 
@@ -1985,7 +2000,7 @@ static bool ScanBlock(CBlock& block, CTxDB& txdb, SecMsgDB& addrpkdb,
         {
             for (uint32_t i = 0; i < tx.vin.size(); i++)
             {
-                CScript *script = &tx.vin[i].scriptSig;
+                const CScript *script = &tx.vin[i].scriptSig;
                 CScript::const_iterator pc = script->begin();
                 CScript::const_iterator pend = script->end();
 
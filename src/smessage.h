@@ -302,6 +302,10 @@ public:
 
     bool Open(const char* pszMode="r+");
 
+    // Destroys the global instance and its options, call with cs_smsgDB held.
+    static void Close();
+    static bool GetStats(std::string& strStats);
+
     bool ScanBatch(const CDataStream& key, std::string* value, bool* deleted) const;
 
     bool TxnBegin();
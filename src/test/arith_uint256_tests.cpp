@@ -0,0 +1,49 @@
+#include <boost/test/unit_test.hpp>
+
+#include "arith_uint256.h"
+#include "bignum.h"
+
+BOOST_AUTO_TEST_SUITE(arith_uint256_tests)
+
+BOOST_AUTO_TEST_CASE(arith_uint256_compact)
+{
+    // Compact round trips must match CBigNum, which consensus code used before
+    static const unsigned int vCompact[] = {
+        0x00000000, 0x00123456, 0x01003456, 0x01123456, 0x02008000, 0x03123456,
+        0x04123456, 0x05009234, 0x1d00ffff, 0x1e0fffff, 0x1f00ffff, 0x20123456
+    };
+    for (unsigned int i = 0; i < sizeof(vCompact) / sizeof(vCompact[0]); i++)
+    {
+        CBigNum bn;
+        bn.SetCompact(vCompact[i]);
+        arith_uint256 a;
+        bool fNegative, fOverflow;
+        a.SetCompact(vCompact[i], &fNegative, &fOverflow);
+        BOOST_CHECK(!fNegative && !fOverflow);
+        BOOST_CHECK(ArithToUint256(a) == bn.getuint256());
+        BOOST_CHECK_EQUAL(a.GetCompact(), bn.GetCompact());
+    }
+
+    arith_uint256 a;
+    bool fNegative, fOverflow;
+    a.SetCompact(0x04923456, &fNegative, &fOverflow);
+    BOOST_CHECK(fNegative && !fOverflow);
+    a.SetCompact(0xff123456, &fNegative, &fOverflow);
+    BOOST_CHECK(!fNegative && fOverflow);
+}
+
+BOOST_AUTO_TEST_CASE(arith_uint256_muldiv)
+{
+    CBigNum bn;
+    bn.SetCompact(0x1d00ffff);
+    arith_uint256 a = UintToArith256(bn.getuint256());
+
+    BOOST_CHECK(ArithToUint256(a * arith_uint256(123456789)) == (bn * CBigNum(123456789)).getuint256());
+    BOOST_CHECK(ArithToUint256(a / arith_uint256(600)) == (bn / CBigNum(600)).getuint256());
+    BOOST_CHECK(ArithToUint256((a * arith_uint256(7) + a) / arith_uint256(8)) == ((bn * 7 + bn) / 8).getuint256());
+    BOOST_CHECK(a > a / arith_uint256(2));
+    BOOST_CHECK(a.bits() == 224);
+    BOOST_CHECK_THROW(a / arith_uint256(0), uint_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,59 @@
+#include <boost/test/unit_test.hpp>
+
+#include "hashblock.h"
+
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(hash9_tests)
+
+BOOST_AUTO_TEST_CASE(hash9_engine_headers)
+{
+    // The engine must agree with the scalar chain for batches of 80-byte
+    // headers, with the generic stages and with the runtime selected ones
+    static const size_t nHeaders = 33;
+    std::vector<unsigned char> vHeaders(nHeaders * CHash9Engine::HEADER_SIZE);
+    for (size_t i = 0; i < vHeaders.size(); i++)
+        vHeaders[i] = (unsigned char)(i * 13 + 5);
+
+    std::vector<uint256> vExpected(nHeaders);
+    for (size_t i = 0; i < nHeaders; i++)
+    {
+        const unsigned char* p = &vHeaders[i * CHash9Engine::HEADER_SIZE];
+        vExpected[i] = Hash9(p, p + CHash9Engine::HEADER_SIZE);
+    }
+
+    for (int fGenericOnly = 1; fGenericOnly >= 0; fGenericOnly--)
+    {
+        CHash9Engine engine(fGenericOnly != 0);
+        std::vector<uint256> vHashes(nHeaders);
+        engine.HashHeaders(&vHeaders[0], nHeaders, &vHashes[0]);
+        BOOST_CHECK_MESSAGE(vHashes == vExpected, (fGenericOnly ? "generic" : CHash9Engine::Implementation()));
+
+        // the engine is reused between calls
+        for (size_t i = 0; i < nHeaders; i++)
+            BOOST_CHECK(engine.Hash(&vHeaders[i * CHash9Engine::HEADER_SIZE], CHash9Engine::HEADER_SIZE) == vExpected[i]);
+    }
+
+    // the per-thread engine is created once and gives the same hashes
+    BOOST_CHECK(&CHash9Engine::ThreadEngine() == &CHash9Engine::ThreadEngine());
+    for (size_t i = 0; i < nHeaders; i++)
+        BOOST_CHECK(CHash9Engine::ThreadEngine().Hash(&vHeaders[i * CHash9Engine::HEADER_SIZE], CHash9Engine::HEADER_SIZE) == vExpected[i]);
+}
+
+BOOST_AUTO_TEST_CASE(hash9_engine_lengths)
+{
+    // Inputs other than a block header go through the same chain
+    std::vector<unsigned char> vData(300);
+    for (size_t i = 0; i < vData.size(); i++)
+        vData[i] = (unsigned char)(i * 7 + 3);
+
+    CHash9Engine engine;
+    static const size_t nLengths[] = {0, 1, 63, 64, 65, 79, 81, 128, 300};
+    for (unsigned int n = 0; n < sizeof(nLengths) / sizeof(nLengths[0]); n++)
+    {
+        const unsigned char* pbegin = &vData[0];
+        BOOST_CHECK(engine.Hash(pbegin, nLengths[n]) == Hash9(pbegin, pbegin + nLengths[n]));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
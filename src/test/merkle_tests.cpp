@@ -0,0 +1,40 @@
+#include <boost/test/unit_test.hpp>
+
+#include "hash.h"
+#include "merkle.h"
+
+BOOST_AUTO_TEST_SUITE(merkle_tests)
+
+BOOST_AUTO_TEST_CASE(merkle_pairwise)
+{
+    // The batched levels must match hashing every pair with Hash(), the way
+    // CBlock::BuildMerkleTree() used to, for every parity of level size
+    for (int nLeaves = 0; nLeaves < 40; nLeaves++)
+    {
+        std::vector<uint256> vLeaves;
+        for (int i = 0; i < nLeaves; i++)
+            vLeaves.push_back(Hash(BEGIN(i), END(i)));
+
+        std::vector<uint256> vExpected(vLeaves);
+        int j = 0;
+        for (int nSize = nLeaves; nSize > 1; nSize = (nSize + 1) / 2)
+        {
+            for (int i = 0; i < nSize; i += 2)
+            {
+                int i2 = std::min(i+1, nSize-1);
+                vExpected.push_back(Hash(BEGIN(vExpected[j+i]),  END(vExpected[j+i]),
+                                         BEGIN(vExpected[j+i2]), END(vExpected[j+i2])));
+            }
+            j += nSize;
+        }
+
+        std::vector<uint256> vTree(vLeaves);
+        ComputeMerkleTree(vTree);
+        BOOST_CHECK(vTree == vExpected);
+
+        std::vector<uint256> vHashes(vLeaves);
+        BOOST_CHECK(ComputeMerkleRoot(vHashes) == (vExpected.empty() ? 0 : vExpected.back()));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
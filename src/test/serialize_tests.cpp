@@ -42,4 +42,72 @@ BOOST_AUTO_TEST_CASE(varints)
 
 }
 
+BOOST_AUTO_TEST_CASE(spanstream)
+{
+    CDataStream ss(SER_NETWORK, 0);
+    ss << 0x01020304 << string("span") << VARINT(300);
+
+    CSpanStream span(&ss[0], &ss[0] + ss.size(), SER_NETWORK, 0);
+    int n;
+    string str;
+    int v;
+    span >> n;
+    BOOST_CHECK(n == 0x01020304);
+    BOOST_CHECK(span.tell() == 4);
+    span >> str >> VARINT(v);
+    BOOST_CHECK(str == "span");
+    BOOST_CHECK(v == 300);
+    BOOST_CHECK(span.empty());
+    BOOST_CHECK(!span.eof());
+
+    // reading past the end throws and sets eof
+    BOOST_CHECK_THROW(span >> n, std::ios_base::failure);
+    BOOST_CHECK(span.eof());
+}
+
+BOOST_AUTO_TEST_CASE(getandclear)
+{
+    CDataStream ss(SER_NETWORK, 0);
+    ss << 42 << string("payload");
+    CDataStream::size_type size = ss.size();
+
+    // an empty target takes the stream's buffer
+    CSerializeData data;
+    ss.GetAndClear(data);
+    BOOST_CHECK(data.size() == size);
+    BOOST_CHECK(ss.empty());
+
+    // a non-empty target has the contents appended
+    ss << 7;
+    ss.GetAndClear(data);
+    BOOST_CHECK(data.size() == size + 4);
+    BOOST_CHECK(ss.empty());
+
+    CDataStream ssRead(data, SER_NETWORK, 0);
+    int n, m;
+    string str;
+    ssRead >> n >> str >> m;
+    BOOST_CHECK(n == 42 && str == "payload" && m == 7);
+}
+
+BOOST_AUTO_TEST_CASE(list_encoding)
+{
+    std::vector<string> v;
+    v.push_back("a");
+    v.push_back("bc");
+    v.push_back("");
+    std::list<string> l(v.begin(), v.end());
+
+    // a list is written exactly like a vector of its elements
+    CDataStream ssVector(SER_DISK, 0), ssList(SER_DISK, 0);
+    ssVector << v;
+    ssList << l;
+    BOOST_CHECK(ssVector.str() == ssList.str());
+    BOOST_CHECK(GetSerializeSize(l, SER_DISK, 0) == ssList.size());
+
+    std::list<string> lRead(1, "stale");
+    ssVector >> lRead;
+    BOOST_CHECK(lRead == l);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
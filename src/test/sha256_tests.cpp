@@ -0,0 +1,48 @@
+#include <boost/test/unit_test.hpp>
+
+#include "crypto/sha256.h"
+
+#include <openssl/sha.h>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(sha256_tests)
+
+BOOST_AUTO_TEST_CASE(sha256_backends)
+{
+    // Every backend must agree with OpenSSL, for streaming writes split at
+    // odd offsets and for the double hash of 64-byte inputs, including the
+    // inputs left over after the 8-way and 4-way batches
+    std::vector<unsigned char> vData(64 * 37);
+    for (size_t i = 0; i < vData.size(); i++)
+        vData[i] = (unsigned char)(i * 7 + 3);
+
+    std::vector<unsigned char> vExpected(32 * 37);
+    for (size_t i = 0; i < 37; i++)
+    {
+        unsigned char hash1[32];
+        SHA256(&vData[64 * i], 64, hash1);
+        SHA256(hash1, 32, &vExpected[32 * i]);
+    }
+
+    static const char* const pszImpl[] = {"generic", "sse4.1", "avx2", "shani", "auto"};
+    for (unsigned int n = 0; n < sizeof(pszImpl) / sizeof(pszImpl[0]); n++)
+    {
+        if (!SHA256UseImplementation(pszImpl[n]))
+            continue;
+
+        for (size_t nLen = 0; nLen <= vData.size(); nLen += 61)
+        {
+            unsigned char hash[32], hashExpected[32];
+            CSHA256().Write(&vData[0], nLen / 3).Write(&vData[nLen / 3], nLen - nLen / 3).Finalize(hash);
+            SHA256(&vData[0], nLen, hashExpected);
+            BOOST_CHECK(memcmp(hash, hashExpected, 32) == 0);
+        }
+
+        std::vector<unsigned char> vHashes(32 * 37);
+        SHA256D64(&vHashes[0], &vData[0], 37);
+        BOOST_CHECK(vHashes == vExpected);
+    }
+    SHA256UseImplementation("auto");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,97 @@
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+#include "timingwheel.h"
+
+#include <map>
+#include <stdlib.h>
+
+#define NUM_KEYS 1000
+#define NUM_SLOTS 16
+#define RESOLUTION 10
+
+BOOST_AUTO_TEST_SUITE(timingwheel_tests)
+
+BOOST_AUTO_TEST_CASE(timingwheel_expire)
+{
+    CTimingWheel<int> wheel(NUM_SLOTS, RESOLUTION, 1000);
+    vector<int> vExpired;
+
+    wheel.Insert(1, 1005);
+    wheel.Insert(2, 1010);
+    wheel.Insert(3, 1200);
+    BOOST_CHECK(wheel.size() == 3);
+
+    wheel.Expire(1004, vExpired);
+    BOOST_CHECK(vExpired.empty());
+
+    // keys fire once their time is reached, not at the end of their slot
+    wheel.Expire(1005, vExpired);
+    BOOST_CHECK(vExpired.size() == 1 && vExpired[0] == 1);
+
+    vExpired.clear();
+    wheel.Expire(1011, vExpired);
+    BOOST_CHECK(vExpired.size() == 1 && vExpired[0] == 2);
+    BOOST_CHECK(wheel.size() == 1);
+
+    // going back in time expires nothing
+    vExpired.clear();
+    wheel.Expire(900, vExpired);
+    BOOST_CHECK(vExpired.empty());
+
+    wheel.Expire(1200, vExpired);
+    BOOST_CHECK(vExpired.size() == 1 && vExpired[0] == 3);
+    BOOST_CHECK(wheel.empty());
+}
+
+// Keys past the end of the wheel wait for their turn, keys in the past fire next
+BOOST_AUTO_TEST_CASE(timingwheel_out_of_range)
+{
+    CTimingWheel<int> wheel(NUM_SLOTS, RESOLUTION, 0);
+    vector<int> vExpired;
+
+    wheel.Insert(1, NUM_SLOTS * RESOLUTION * 3 + 5);
+    for (int nTime = 0; nTime < NUM_SLOTS * RESOLUTION * 3; nTime += RESOLUTION)
+        wheel.Expire(nTime, vExpired);
+    BOOST_CHECK(vExpired.empty());
+
+    wheel.Insert(2, 0);
+    wheel.Expire(NUM_SLOTS * RESOLUTION * 3, vExpired);
+    BOOST_CHECK(vExpired.size() == 1 && vExpired[0] == 2);
+
+    wheel.Expire(NUM_SLOTS * RESOLUTION * 3 + 5, vExpired);
+    BOOST_CHECK(vExpired.size() == 2 && vExpired[1] == 1);
+}
+
+// Expiring at random intervals returns every key exactly once, on time
+BOOST_AUTO_TEST_CASE(timingwheel_like_scan)
+{
+    CTimingWheel<int> wheel(NUM_SLOTS, RESOLUTION, 0);
+    map<int, int64_t> mapTime;
+    int64_t nNow = 0;
+
+    for (int i = 0; i < NUM_KEYS; i++)
+    {
+        int64_t nTime = nNow + rand() % (NUM_SLOTS * RESOLUTION * 2);
+        wheel.Insert(i, nTime);
+        mapTime[i] = nTime;
+
+        if (rand() % 4 == 0)
+            nNow += rand() % (NUM_SLOTS * RESOLUTION);
+
+        vector<int> vExpired;
+        wheel.Expire(nNow, vExpired);
+        for (size_t j = 0; j < vExpired.size(); j++)
+        {
+            BOOST_CHECK(mapTime.count(vExpired[j]));
+            BOOST_CHECK(mapTime[vExpired[j]] <= nNow);
+            mapTime.erase(vExpired[j]);
+        }
+        for (map<int, int64_t>::iterator it = mapTime.begin(); it != mapTime.end(); it++)
+            BOOST_CHECK(it->second > nNow);
+        BOOST_CHECK(wheel.size() == mapTime.size());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
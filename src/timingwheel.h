@@ -0,0 +1,83 @@
+// Copyright (c) 2014-2018 The MarteX developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_TIMINGWHEEL_H
+#define BITCOIN_TIMINGWHEEL_H
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+/** Expiry index: keys are put in the slot of the time they expire at, and
+ *  Expire() only visits the slots whose time has come, so finding what
+ *  expired costs O(expired + slots passed) instead of a scan of the store.
+ *
+ *  The wheel covers nSlots * nResolution seconds. Keys that expire later
+ *  wait in their slot and are skipped until their turn comes round. The
+ *  wheel does not own the store: keys are never removed early, so callers
+ *  check the store for keys that are gone or were rescheduled.
+ */
+template <typename K> class CTimingWheel
+{
+private:
+    struct Entry
+    {
+        K key;
+        int64_t nTime;
+
+        Entry(const K& keyIn, int64_t nTimeIn) : key(keyIn), nTime(nTimeIn) {}
+    };
+
+    std::vector<std::vector<Entry> > vSlots;
+    int64_t nResolution;
+    int64_t nTick;      // tick of the slot Expire() continues from
+    size_t nSize;
+
+    std::vector<Entry>& Slot(int64_t nTickIn) { return vSlots[nTickIn % vSlots.size()]; }
+
+public:
+    CTimingWheel(size_t nSlots, int64_t nResolutionIn, int64_t nNow) :
+        vSlots(std::max(nSlots, (size_t)1)), nResolution(std::max(nResolutionIn, (int64_t)1)),
+        nTick(nNow / nResolution), nSize(0) {}
+
+    // Schedule key to expire once the time is nTime or later
+    void Insert(const K& key, int64_t nTime)
+    {
+        Slot(std::max(nTime / nResolution, nTick)).push_back(Entry(key, nTime));
+        nSize++;
+    }
+
+    // Append the keys scheduled at nNow or earlier to vExpired and forget them
+    void Expire(int64_t nNow, std::vector<K>& vExpired)
+    {
+        int64_t nNowTick = nNow / nResolution;
+        if (nNowTick < nTick)
+            return;
+
+        // after a long pause every slot is due, visit each once
+        int64_t nVisit = std::min(nNowTick - nTick + 1, (int64_t)vSlots.size());
+        for (int64_t i = 0; i < nVisit; i++)
+        {
+            std::vector<Entry>& vSlot = Slot(nTick + i);
+            size_t nKeep = 0;
+            for (size_t j = 0; j < vSlot.size(); j++)
+            {
+                if (vSlot[j].nTime <= nNow)
+                    vExpired.push_back(vSlot[j].key);
+                else
+                    vSlot[nKeep++] = vSlot[j];
+            }
+            nSize -= vSlot.size() - nKeep;
+            vSlot.erase(vSlot.begin() + nKeep, vSlot.end());
+        }
+
+        // the current slot may still get keys expiring later in this tick
+        nTick = nNowTick;
+    }
+
+    size_t size() const { return nSize; }
+    bool empty() const { return nSize == 0; }
+};
+
+#endif // BITCOIN_TIMINGWHEEL_H
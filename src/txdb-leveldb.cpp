@@ -8,6 +8,7 @@
 #include <boost/version.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include <leveldb/env.h>
 #include <leveldb/cache.h>
@@ -16,6 +17,7 @@
 
 #include "kernel.h"
 #include "checkpoints.h"
+#include "crypto/common.h"
 #include "txdb.h"
 #include "util.h"
 #include "main.h"
@@ -26,14 +28,32 @@ using namespace boost;
 
 leveldb::DB *txdb; // global pointer for LevelDB object instance
 
-static leveldb::Options GetOptions() {
+// Bulk-load state of the txdb, decided when it is opened
+static bool fBulkLoad = false;
+static int nBulkLoadBlocks = 0;
+
+leveldb::Options GetLevelDBOptions(size_t nCacheSize, bool fBulkLoadIn)
+{
     leveldb::Options options;
-    int nCacheSizeMB = GetArg("-dbcache", 100);
-    options.block_cache = leveldb::NewLRUCache(nCacheSizeMB * 1048576);
+    options.block_cache = leveldb::NewLRUCache(nCacheSize);
     options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    options.write_buffer_size = GetArg("-dbwritebuffer", 4) << 20;
+    options.max_open_files = GetArg("-dbmaxopenfiles", 64);
+    options.block_size = GetArg("-dbblocksize", 4) << 10;
+    options.compression = GetBoolArg("-dbcompression", true) ? leveldb::kSnappyCompression : leveldb::kNoCompression;
+    if (fBulkLoadIn)
+    {
+        // Fewer, larger level-0 files while the whole chain is being written
+        options.write_buffer_size = std::max(options.write_buffer_size, (size_t)GetArg("-dbbulkwritebuffer", 64) << 20);
+    }
     return options;
 }
 
+static leveldb::Options GetOptions() {
+    int nCacheSizeMB = GetArg("-dbcache", 100);
+    return GetLevelDBOptions(nCacheSizeMB * 1048576, fBulkLoad);
+}
+
 void init_blockindex(leveldb::Options& options, bool fRemoveOld = false) {
     // First time init.
     filesystem::path directory = GetDataDir() / "txleveldb";
@@ -79,9 +99,16 @@ CTxDB::CTxDB(const char* pszMode)
 
     bool fCreate = strchr(pszMode, 'c');
 
+    // A new txdb or a block import writes the chain from scratch
+    bool fNewDB = !filesystem::exists(GetDataDir() / "txleveldb");
+    fBulkLoad = GetBoolArg("-dbbulkload", fNewDB || mapArgs.count("-loadblock") || GetBoolArg("-reindexaddr", false) ||
+                                          filesystem::exists(GetDataDir() / "bootstrap.dat"));
+    nBulkLoadBlocks = 0;
+
     options = GetOptions();
     options.create_if_missing = true; //options.create_if_missing = fCreate;
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    if (fBulkLoad)
+        LogPrintf("LevelDB bulk load: write buffer %d MB\n", options.write_buffer_size >> 20);
 
     init_blockindex(options); // Init directory
     pdb = txdb;
@@ -136,14 +163,14 @@ void CTxDB::Close()
 bool CTxDB::TxnBegin()
 {
     assert(!activeBatch);
-    activeBatch = new leveldb::WriteBatch();
+    activeBatch = new CLevelDBBatch();
     return true;
 }
 
 bool CTxDB::TxnCommit()
 {
     assert(activeBatch);
-    leveldb::Status status = pdb->Write(leveldb::WriteOptions(), activeBatch);
+    leveldb::Status status = pdb->Write(leveldb::WriteOptions(), activeBatch->GetWriteBatch());
     delete activeBatch;
     activeBatch = NULL;
     if (!status.ok()) {
@@ -153,75 +180,189 @@ bool CTxDB::TxnCommit()
     return true;
 }
 
-class CBatchScanner : public leveldb::WriteBatch::Handler {
-public:
-    std::string needle;
-    bool *deleted;
-    std::string *foundValue;
-    bool foundEntry;
-
-    CBatchScanner() : foundEntry(false) {}
-
-    virtual void Put(const leveldb::Slice& key, const leveldb::Slice& value) {
-        if (key.ToString() == needle) {
-            foundEntry = true;
-            *deleted = false;
-            *foundValue = value.ToString();
-        }
+void CTxDB::CompactBulkLoad(bool fInitialDownload)
+{
+    if (!fBulkLoad)
+        return;
+
+    int nInterval = GetArg("-dbcompactblocks", 50000);
+    if (fInitialDownload && (nInterval <= 0 || ++nBulkLoadBlocks % nInterval != 0))
+        return;
+
+    int64_t nStart = GetTimeMillis();
+    pdb->CompactRange(NULL, NULL);
+    LogPrintf("LevelDB compaction after %d blocks: %dms\n", nBulkLoadBlocks, GetTimeMillis() - nStart);
+
+    if (!fInitialDownload)
+    {
+        // The write buffer size is fixed until the database is reopened
+        LogPrintf("LevelDB bulk load finished\n");
+        fBulkLoad = false;
     }
+}
 
-    virtual void Delete(const leveldb::Slice& key) {
-        if (key.ToString() == needle) {
-            foundEntry = true;
-            *deleted = true;
-        }
+bool CTxDB::IsBulkLoading()
+{
+    return fBulkLoad;
+}
+
+std::string CTxDB::GetStats()
+{
+    std::string strStats;
+    if (!pdb->GetProperty("leveldb.stats", &strStats))
+        return "";
+    return strStats;
+}
+
+uint64_t CTxDB::GetApproximateSize(const std::string& strPrefix)
+{
+    return GetLevelDBPrefixSize(pdb, strPrefix);
+}
+
+uint64_t GetLevelDBPrefixSize(leveldb::DB* pdb, const std::string& strPrefix)
+{
+    // Keys start with the serialized prefix string; the range ends where
+    // the prefix with its last byte incremented would start.
+    CDataStream ssStart(SER_DISK, CLIENT_VERSION);
+    ssStart << strPrefix;
+    std::string strStart = ssStart.str();
+    std::string strLimit = strStart;
+    strLimit[strLimit.size() - 1]++;
+
+    leveldb::Range range(strStart, strLimit);
+    uint64_t nSize = 0;
+    pdb->GetApproximateSizes(&range, 1, &nSize);
+    return nSize;
+}
+
+// Address index entries are keyed ("adx", address, height, tx position) with
+// the position big-endian, so the entries of one address sort in chain order
+// and can be paged through with an iterator instead of being loaded at once.
+class CAddrIndexKey
+{
+public:
+    uint160 addrHash;
+    unsigned char vchPos[8];
+
+    CAddrIndexKey(const uint160& addrHashIn, unsigned int nHeight, unsigned int nTxIndex) : addrHash(addrHashIn)
+    {
+        WriteBE32(&vchPos[0], nHeight);
+        WriteBE32(&vchPos[4], nTxIndex);
     }
+
+    IMPLEMENT_SERIALIZE
+    (
+        READWRITE(addrHash);
+        READWRITE(FLATDATA(vchPos));
+    )
 };
 
-// When performing a read, if we have an active batch we need to check it first
-// before reading from the database, as the rest of the code assumes that once
-// a database transaction begins reads are consistent with it. It would be good
-// to change that assumption in future and avoid the performance hit, though in
-// practice it does not appear to be large.
-bool CTxDB::ScanBatch(const CDataStream &key, string *value, bool *deleted) const {
-    assert(activeBatch);
-    *deleted = false;
-    CBatchScanner scanner;
-    scanner.needle = key.str();
-    scanner.deleted = deleted;
-    scanner.foundValue = value;
-    leveldb::Status status = activeBatch->Iterate(&scanner);
-    if (!status.ok()) {
-        throw runtime_error(status.ToString());
+bool CTxDB::WriteAddrIndex(uint160 addrHash, int nHeight, unsigned int nTxIndex, uint256 txHash)
+{
+    return Write(make_pair(string("adx"), CAddrIndexKey(addrHash, nHeight, nTxIndex)), txHash);
+}
+
+bool CTxDB::EraseAddrIndex(uint160 addrHash, int nHeight, unsigned int nTxIndex)
+{
+    return Erase(make_pair(string("adx"), CAddrIndexKey(addrHash, nHeight, nTxIndex)));
+}
+
+bool CTxDB::ReadAddrIndexVersion(int& nVersion)
+{
+    nVersion = 0;
+    return Read(string("adxversion"), nVersion);
+}
+
+bool CTxDB::WriteAddrIndexVersion(int nVersion)
+{
+    return Write(string("adxversion"), nVersion);
+}
+
+bool CTxDB::EraseAddrIndexVersion()
+{
+    return Erase(string("adxversion"));
+}
+
+bool CTxDB::EraseLegacyAddrIndex()
+{
+    CDataStream ssKeyPrefix(SER_DISK, CLIENT_VERSION);
+    ssKeyPrefix << string("adr");
+    leveldb::Slice keyPrefix(&ssKeyPrefix[0], ssKeyPrefix.size());
+
+    // Delete in batches so a large old index does not sit in memory at once
+    static const unsigned int nBatchSize = 10000;
+    unsigned int nErased = 0;
+    boost::scoped_ptr<leveldb::Iterator> iterator(pdb->NewIterator(leveldb::ReadOptions()));
+    leveldb::WriteBatch batch;
+    for (iterator->Seek(keyPrefix); iterator->Valid() && iterator->key().starts_with(keyPrefix); iterator->Next())
+    {
+        batch.Delete(iterator->key());
+        if (++nErased % nBatchSize == 0)
+        {
+            leveldb::Status status = pdb->Write(leveldb::WriteOptions(), &batch);
+            if (!status.ok())
+                return error("EraseLegacyAddrIndex() : %s", status.ToString());
+            batch.Clear();
+        }
     }
-    return scanner.foundEntry;
+    leveldb::Status status = pdb->Write(leveldb::WriteOptions(), &batch);
+    if (!status.ok())
+        return error("EraseLegacyAddrIndex() : %s", status.ToString());
+
+    if (nErased > 0)
+        LogPrintf("EraseLegacyAddrIndex() : erased %u old address index entries\n", nErased);
+    return true;
 }
 
-bool CTxDB::WriteAddrIndex(uint160 addrHash, uint256 txHash)
+bool CTxDB::ReadAddrIndex(uint160 addrHash, std::vector<uint256>& txHashes, int nSkip, unsigned int nCount)
 {
-    std::vector<uint256> txHashes;
-    if(!ReadAddrIndex(addrHash, txHashes))
+    txHashes.clear();
+
+    CDataStream ssKeyPrefix(SER_DISK, CLIENT_VERSION);
+    ssKeyPrefix << make_pair(string("adx"), addrHash);
+    leveldb::Slice keyPrefix(&ssKeyPrefix[0], ssKeyPrefix.size());
+
+    boost::scoped_ptr<leveldb::Iterator> iterator(pdb->NewIterator(leveldb::ReadOptions()));
+    if (nSkip >= 0)
     {
-	txHashes.push_back(txHash);
-        return Write(make_pair(string("adr"), addrHash), txHashes);
+        // Oldest first: step over the skipped keys without decoding them
+        iterator->Seek(keyPrefix);
+        for (; nSkip > 0 && iterator->Valid() && iterator->key().starts_with(keyPrefix); nSkip--)
+            iterator->Next();
     }
     else
     {
-	if(std::find(txHashes.begin(), txHashes.end(), txHash) == txHashes.end()) 
-    	{
-    	    txHashes.push_back(txHash);
-            return Write(make_pair(string("adr"), addrHash), txHashes);
-	}
-	else
-	{
-	    return true; // already have this tx hash
-	}
+        // A negative skip counts back from the newest entry
+        CDataStream ssEndKey(SER_DISK, CLIENT_VERSION);
+        ssEndKey << make_pair(string("adx"), CAddrIndexKey(addrHash, 0xffffffff, 0xffffffff));
+        iterator->Seek(ssEndKey.str());
+        if (iterator->Valid())
+            iterator->Prev();
+        else
+            iterator->SeekToLast();
+        for (; nSkip < -1 && iterator->Valid() && iterator->key().starts_with(keyPrefix); nSkip++)
+            iterator->Prev();
+        if (!iterator->Valid() || !iterator->key().starts_with(keyPrefix))
+            iterator->Seek(keyPrefix);
     }
-}
 
-bool CTxDB::ReadAddrIndex(uint160 addrHash, std::vector<uint256>& txHashes)
-{
-    return Read(make_pair(string("adr"), addrHash), txHashes);
+    for (; nCount > 0 && iterator->Valid() && iterator->key().starts_with(keyPrefix); nCount--)
+    {
+        try {
+            CDataStream ssValue(iterator->value().data(), iterator->value().data() + iterator->value().size(), SER_DISK, CLIENT_VERSION);
+            uint256 txHash;
+            ssValue >> txHash;
+            txHashes.push_back(txHash);
+        }
+        catch (std::exception &e) {
+            return error("%s : deserialize error", __func__);
+        }
+        iterator->Next();
+    }
+
+    if (!iterator->status().ok())
+        return error("%s : %s", __func__, iterator->status().ToString());
+    return true;
 }
 
 bool CTxDB::ReadTxIndex(uint256 hash, CTxIndex& txindex)
@@ -257,7 +398,7 @@ bool CTxDB::ContainsTx(uint256 hash)
 
 bool CTxDB::ReadDiskTx(uint256 hash, CTransaction& tx, CTxIndex& txindex)
 {
-    tx.SetNull();
+    tx = CTransaction();
     if (!ReadTxIndex(hash, txindex))
         return false;
     return (tx.ReadFromDisk(txindex.pos));
@@ -280,8 +421,28 @@ bool CTxDB::ReadDiskTx(COutPoint outpoint, CTransaction& tx)
     return ReadDiskTx(outpoint.hash, tx, txindex);
 }
 
+static boost::filesystem::path BlockIndexSnapshotPath()
+{
+    return GetDataDir() / "blkindex.snapshot";
+}
+
+// Whether a block index snapshot may be on disk. It starts out true since
+// an earlier run may have left one behind.
+static bool fBlockIndexSnapshotOnDisk = true;
+
+// Delete the block index snapshot, which goes stale with any change to the
+// block index keys or the best chain, whatever -blockindexsnapshot says.
+static void RemoveBlockIndexSnapshot()
+{
+    if (!fBlockIndexSnapshotOnDisk)
+        return;
+    boost::filesystem::remove(BlockIndexSnapshotPath());
+    fBlockIndexSnapshotOnDisk = false;
+}
+
 bool CTxDB::WriteBlockIndex(const CDiskBlockIndex& blockindex)
 {
+    RemoveBlockIndexSnapshot();
     return Write(make_pair(string("blockindex"), blockindex.GetBlockHash()), blockindex);
 }
 
@@ -292,6 +453,7 @@ bool CTxDB::ReadHashBestChain(uint256& hashBestChain)
 
 bool CTxDB::WriteHashBestChain(uint256 hashBestChain)
 {
+    RemoveBlockIndexSnapshot();
     return Write(string("hashBestChain"), hashBestChain);
 }
 
@@ -311,108 +473,311 @@ static CBlockIndex *InsertBlockIndex(uint256 hash)
         return NULL;
 
     // Return existing
-    map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hash);
+    BlockMap::iterator mi = mapBlockIndex.find(hash);
     if (mi != mapBlockIndex.end())
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
-    if (!pindexNew)
-        throw runtime_error("LoadBlockIndex() : new CBlockIndex failed");
+    CBlockIndex* pindexNew = new (arenaBlockIndex.Allocate()) CBlockIndex();
     mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
     return pindexNew;
 }
 
-bool CTxDB::LoadBlockIndex()
+/** Version of the block index snapshot file format */
+static const int BLOCK_INDEX_SNAPSHOT_VERSION = 1;
+/** Number of block index entries handed to the parser threads at once */
+static const unsigned int BLOCK_INDEX_LOAD_BATCH = 16384;
+/** Maximum number of threads parsing block index entries */
+static const int MAX_BLOCK_INDEX_LOAD_THREADS = 8;
+
+// Link one loaded entry into mapBlockIndex
+static bool AddBlockIndexEntry(const uint256& blockHash, const CDiskBlockIndex& diskindex)
 {
-    if (mapBlockIndex.size() > 0) {
-        // Already loaded once in this session. It can happen during migration
-        // from BDB.
-        return true;
+    // Construct block index object
+    CBlockIndex* pindexNew    = InsertBlockIndex(blockHash);
+    pindexNew->pprev          = InsertBlockIndex(diskindex.hashPrev);
+    pindexNew->pnext          = InsertBlockIndex(diskindex.hashNext);
+    pindexNew->nFile          = diskindex.nFile;
+    pindexNew->nBlockPos      = diskindex.nBlockPos;
+    pindexNew->nHeight        = diskindex.nHeight;
+    pindexNew->nMint          = diskindex.nMint;
+    pindexNew->nMoneySupply   = diskindex.nMoneySupply;
+    pindexNew->nFlags         = diskindex.nFlags;
+    pindexNew->nStakeModifier = diskindex.nStakeModifier;
+    pindexNew->bnStakeModifierV2 = diskindex.bnStakeModifierV2;
+    pindexNew->prevoutStake   = diskindex.prevoutStake;
+    pindexNew->nStakeTime     = diskindex.nStakeTime;
+    pindexNew->hashProof      = diskindex.hashProof;
+    pindexNew->nVersion       = diskindex.nVersion;
+    pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+    pindexNew->nTime          = diskindex.nTime;
+    pindexNew->nBits          = diskindex.nBits;
+    pindexNew->nNonce         = diskindex.nNonce;
+
+    // Watch for genesis block
+    if (pindexGenesisBlock == NULL && blockHash == Params().HashGenesisBlock())
+        pindexGenesisBlock = pindexNew;
+
+    if (!pindexNew->CheckIndex())
+        return error("LoadBlockIndex() : CheckIndex failed at %d", pindexNew->nHeight);
+
+    // NovaCoin: build setStakeSeen
+    if (pindexNew->IsProofOfStake())
+        setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
+
+    return true;
+}
+
+// Drop a partially loaded block index so it can be loaded again from scratch
+static void ClearBlockIndex()
+{
+    BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
+        arenaBlockIndex.Free(item.second);
+    mapBlockIndex.clear();
+    setStakeSeen.clear();
+    pindexGenesisBlock = NULL;
+}
+
+// Deserialize vValue[nBegin, nEnd) and compute the block hashes, which
+// dominates the cost of loading entries younger than -fastindex allows
+static void ParseBlockIndexRange(const vector<string>* pvValue, vector<CDiskBlockIndex>* pvIndex, vector<uint256>* pvHash,
+                                 size_t nBegin, size_t nEnd, char* pfOk)
+{
+    try {
+        for (size_t i = nBegin; i < nEnd; i++)
+        {
+            const string& strValue = (*pvValue)[i];
+            CSpanStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
+            ssValue >> (*pvIndex)[i];
+            (*pvHash)[i] = (*pvIndex)[i].GetBlockHash();
+        }
     }
-    // The block index is an in-memory structure that maps hashes to on-disk
-    // locations where the contents of the block can be found. Here, we scan it
-    // out of the DB and into mapBlockIndex.
+    catch (std::exception &e) {
+        *pfOk = false;
+    }
+}
+
+static bool ParseBlockIndexBatch(const vector<string>& vValue, vector<CDiskBlockIndex>& vIndex, vector<uint256>& vHash, int nThreads)
+{
+    vIndex.resize(vValue.size());
+    vHash.resize(vValue.size());
+
+    size_t nPerThread = (vValue.size() + nThreads - 1) / nThreads;
+    vector<char> vOk(nThreads, true);
+    boost::thread_group threadGroup;
+    for (int i = 1; i < nThreads; i++)
+    {
+        size_t nBegin = min(vValue.size(), i * nPerThread);
+        size_t nEnd = min(vValue.size(), nBegin + nPerThread);
+        if (nBegin < nEnd)
+            threadGroup.create_thread(boost::bind(&ParseBlockIndexRange, &vValue, &vIndex, &vHash, nBegin, nEnd, &vOk[i]));
+    }
+    ParseBlockIndexRange(&vValue, &vIndex, &vHash, 0, min(vValue.size(), nPerThread), &vOk[0]);
+    threadGroup.join_all();
+
+    return find(vOk.begin(), vOk.end(), false) == vOk.end();
+}
+
+// Load the block index from the snapshot written at the last clean shutdown.
+// The snapshot is only used once and only if it matches the database.
+bool CTxDB::LoadBlockIndexSnapshot(const uint256& hashBestChainDB)
+{
+    boost::filesystem::path pathSnapshot = BlockIndexSnapshotPath();
+    if (!boost::filesystem::exists(pathSnapshot))
+        return false;
+
+    bool fLoaded = false;
+    {
+        boost::scoped_ptr<CMappedFile> pmap(CMappedFile::Open(pathSnapshot));
+        if (pmap && pmap->size() > sizeof(uint256))
+        {
+            const char* pend = pmap->end() - sizeof(uint256);
+            uint256 hashChecksum;
+            memcpy(hashChecksum.begin(), pend, sizeof(uint256));
+            if (Hash(pmap->begin(), pend) == hashChecksum)
+            {
+                try {
+                    CSpanStream ssSnapshot(pmap->begin(), pend, SER_DISK, CLIENT_VERSION);
+                    unsigned char pchMessageStart[4];
+                    int nSnapshotVersion;
+                    uint256 hashBestChainSnapshot;
+                    unsigned int nCount;
+                    ssSnapshot >> FLATDATA(pchMessageStart) >> nSnapshotVersion >> hashBestChainSnapshot >> nCount;
+                    if (memcmp(pchMessageStart, Params().MessageStart(), sizeof(pchMessageStart)) == 0 &&
+                        nSnapshotVersion == BLOCK_INDEX_SNAPSHOT_VERSION &&
+                        hashBestChainSnapshot == hashBestChainDB)
+                    {
+                        fLoaded = true;
+                        for (unsigned int i = 0; i < nCount && fLoaded; i++)
+                        {
+                            uint256 blockHash;
+                            CDiskBlockIndex diskindex;
+                            ssSnapshot >> blockHash >> diskindex;
+                            fLoaded = AddBlockIndexEntry(blockHash, diskindex);
+                        }
+                    }
+                }
+                catch (std::exception &e) {
+                    fLoaded = false;
+                }
+            }
+        }
+    }
+
+    if (!fLoaded)
+    {
+        LogPrintf("LoadBlockIndex() : ignoring stale or corrupt block index snapshot\n");
+        ClearBlockIndex();
+    }
+
+    // Any block connected from now on makes the snapshot stale
+    RemoveBlockIndexSnapshot();
+    return fLoaded;
+}
+
+// Load the block index from LevelDB. Iteration is serial, but entries are
+// deserialized and hashed in batches on several threads.
+bool CTxDB::LoadBlockIndexGuts()
+{
+    int nThreads = max(1, min((int)boost::thread::hardware_concurrency(), MAX_BLOCK_INDEX_LOAD_THREADS));
+
+    CDataStream ssKeyPrefix(SER_DISK, CLIENT_VERSION);
+    ssKeyPrefix << string("blockindex");
+    leveldb::Slice keyPrefix(&ssKeyPrefix[0], ssKeyPrefix.size());
+
     leveldb::Iterator *iterator = pdb->NewIterator(leveldb::ReadOptions());
     // Seek to start key.
     CDataStream ssStartKey(SER_DISK, CLIENT_VERSION);
     ssStartKey << make_pair(string("blockindex"), uint256(0));
     iterator->Seek(ssStartKey.str());
-    // Now read each entry.
+
+    vector<string> vValue;
+    vector<CDiskBlockIndex> vIndex;
+    vector<uint256> vHash;
+    vValue.reserve(BLOCK_INDEX_LOAD_BATCH);
     while (iterator->Valid())
     {
         boost::this_thread::interruption_point();
-        // Unpack keys and values.
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.write(iterator->key().data(), iterator->key().size());
-        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-        ssValue.write(iterator->value().data(), iterator->value().size());
-        string strType;
-        ssKey >> strType;
-        // Did we reach the end of the data to read?
-        if (strType != "blockindex")
+
+        // Collect a batch of raw entries, stopping at the end of the block index keys
+        vValue.clear();
+        while (vValue.size() < BLOCK_INDEX_LOAD_BATCH && iterator->Valid() && iterator->key().starts_with(keyPrefix))
+        {
+            vValue.push_back(iterator->value().ToString());
+            iterator->Next();
+        }
+        if (vValue.empty())
             break;
-        CDiskBlockIndex diskindex;
-        ssValue >> diskindex;
-
-        uint256 blockHash = diskindex.GetBlockHash();
-
-        // Construct block index object
-        CBlockIndex* pindexNew    = InsertBlockIndex(blockHash);
-        pindexNew->pprev          = InsertBlockIndex(diskindex.hashPrev);
-        pindexNew->pnext          = InsertBlockIndex(diskindex.hashNext);
-        pindexNew->nFile          = diskindex.nFile;
-        pindexNew->nBlockPos      = diskindex.nBlockPos;
-        pindexNew->nHeight        = diskindex.nHeight;
-        pindexNew->nMint          = diskindex.nMint;
-        pindexNew->nMoneySupply   = diskindex.nMoneySupply;
-        pindexNew->nFlags         = diskindex.nFlags;
-        pindexNew->nStakeModifier = diskindex.nStakeModifier;
-        pindexNew->bnStakeModifierV2 = diskindex.bnStakeModifierV2;
-        pindexNew->prevoutStake   = diskindex.prevoutStake;
-        pindexNew->nStakeTime     = diskindex.nStakeTime;
-        pindexNew->hashProof      = diskindex.hashProof;
-        pindexNew->nVersion       = diskindex.nVersion;
-        pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-        pindexNew->nTime          = diskindex.nTime;
-        pindexNew->nBits          = diskindex.nBits;
-        pindexNew->nNonce         = diskindex.nNonce;
-
-        // Watch for genesis block
-        if (pindexGenesisBlock == NULL && blockHash == Params().HashGenesisBlock())
-            pindexGenesisBlock = pindexNew;
-
-        if (!pindexNew->CheckIndex()) {
+
+        if (!ParseBlockIndexBatch(vValue, vIndex, vHash, nThreads))
+        {
             delete iterator;
-            return error("LoadBlockIndex() : CheckIndex failed at %d", pindexNew->nHeight);
+            return error("LoadBlockIndex() : deserialize error");
         }
 
-        // NovaCoin: build setStakeSeen
-        if (pindexNew->IsProofOfStake())
-            setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
-
-        iterator->Next();
+        for (unsigned int i = 0; i < vIndex.size(); i++)
+        {
+            if (!AddBlockIndexEntry(vHash[i], vIndex[i]))
+            {
+                delete iterator;
+                return false;
+            }
+        }
     }
     delete iterator;
 
+    return true;
+}
+
+bool CTxDB::WriteBlockIndexSnapshot()
+{
+    // Only snapshot an index that matches what is committed to the database
+    uint256 hashBestChainDB;
+    if (pindexBest == NULL || !ReadHashBestChain(hashBestChainDB) || hashBestChainDB != hashBestChain)
+        return false;
+
+    int64_t nStart = GetTimeMillis();
+    boost::filesystem::path pathSnapshot = BlockIndexSnapshotPath();
+    boost::filesystem::path pathTmp = GetDataDir() / "blkindex.snapshot.new";
+
+    CAutoFile fileout = CAutoFile(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    if (!fileout)
+        return error("WriteBlockIndexSnapshot() : open failed");
+
+    CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+    try {
+        int nSnapshotVersion = BLOCK_INDEX_SNAPSHOT_VERSION;
+        unsigned int nCount = mapBlockIndex.size();
+        fileout << FLATDATA(Params().MessageStart()) << nSnapshotVersion << hashBestChain << nCount;
+        hasher << FLATDATA(Params().MessageStart()) << nSnapshotVersion << hashBestChain << nCount;
+        BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
+        {
+            CDiskBlockIndex diskindex(item.second);
+            fileout << item.first << diskindex;
+            hasher << item.first << diskindex;
+        }
+        fileout << hasher.GetHash();
+    }
+    catch (std::exception &e) {
+        return error("WriteBlockIndexSnapshot() : I/O error");
+    }
+    FileCommit(fileout);
+    fileout.fclose();
+
+    if (!RenameOver(pathTmp, pathSnapshot))
+        return error("WriteBlockIndexSnapshot() : rename failed");
+    fBlockIndexSnapshotOnDisk = true;
+
+    LogPrintf("WriteBlockIndexSnapshot() : wrote %u entries in %dms\n", mapBlockIndex.size(), GetTimeMillis() - nStart);
+    return true;
+}
+
+bool CTxDB::LoadBlockIndex()
+{
+    if (mapBlockIndex.size() > 0) {
+        // Already loaded once in this session. It can happen during migration
+        // from BDB.
+        return true;
+    }
+    // The block index is an in-memory structure that maps hashes to on-disk
+    // locations where the contents of the block can be found. Here, we read
+    // it into mapBlockIndex, from the shutdown snapshot if there is a usable
+    // one, otherwise by scanning the DB.
+    int64_t nStart = GetTimeMillis();
+    uint256 hashBestChainDB;
+    bool fSnapshot = GetBoolArg("-blockindexsnapshot", true) && ReadHashBestChain(hashBestChainDB) &&
+                     LoadBlockIndexSnapshot(hashBestChainDB);
+    if (!fSnapshot)
+        RemoveBlockIndexSnapshot();
+    if (!fSnapshot && !LoadBlockIndexGuts())
+        return false;
+    LogPrintf("LoadBlockIndex(): loaded %u entries from %s in %dms\n", mapBlockIndex.size(),
+      fSnapshot ? "snapshot" : "database", GetTimeMillis() - nStart);
+
     boost::this_thread::interruption_point();
 
-    // Calculate nChainTrust
-    vector<pair<int, CBlockIndex*> > vSortedByHeight;
-    vSortedByHeight.reserve(mapBlockIndex.size());
+    // Calculate nChainTrust and build the skip list, visiting parents before children. Entries are
+    // bucketed by height rather than sorted.
+    nStart = GetTimeMillis();
+    int nMaxHeight = 0;
     BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
+        nMaxHeight = max(nMaxHeight, item.second->nHeight);
+    vector<unsigned int> vHeightOffset(nMaxHeight + 2, 0);
+    BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
+        vHeightOffset[item.second->nHeight + 1]++;
+    for (int nHeight = 1; nHeight <= nMaxHeight + 1; nHeight++)
+        vHeightOffset[nHeight] += vHeightOffset[nHeight - 1];
+    vector<CBlockIndex*> vSortedByHeight(mapBlockIndex.size());
+    BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
+        vSortedByHeight[vHeightOffset[item.second->nHeight]++] = item.second;
+    BOOST_FOREACH(CBlockIndex* pindex, vSortedByHeight)
     {
-        CBlockIndex* pindex = item.second;
-        vSortedByHeight.push_back(make_pair(pindex->nHeight, pindex));
-    }
-    sort(vSortedByHeight.begin(), vSortedByHeight.end());
-    BOOST_FOREACH(const PAIRTYPE(int, CBlockIndex*)& item, vSortedByHeight)
-    {
-        CBlockIndex* pindex = item.second;
         pindex->nChainTrust = (pindex->pprev ? pindex->pprev->nChainTrust : 0) + pindex->GetBlockTrust();
+        pindex->BuildSkip();
     }
+    LogPrintf("LoadBlockIndex(): calculated chain trust and skip pointers in %dms\n", GetTimeMillis() - nStart);
 
     // Load hashBestChain pointer to end of best chain
     if (!ReadHashBestChain(hashBestChain))
@@ -424,6 +789,7 @@ bool CTxDB::LoadBlockIndex()
     if (!mapBlockIndex.count(hashBestChain))
         return error("CTxDB::LoadBlockIndex() : hashBestChain not found in the block index");
     pindexBest = mapBlockIndex[hashBestChain];
+    chainActive.SetTip(pindexBest);
     nBestHeight = pindexBest->nHeight;
     nBestChainTrust = pindexBest->nChainTrust;
 
@@ -444,6 +810,7 @@ bool CTxDB::LoadBlockIndex()
     if (nCheckDepth > nBestHeight)
         nCheckDepth = nBestHeight;
     LogPrintf("Verifying last %i blocks at level %i\n", nCheckDepth, nCheckLevel);
+    nStart = GetTimeMillis();
     CBlockIndex* pindexFork = NULL;
     map<pair<unsigned int, unsigned int>, CBlockIndex*> mapBlockPos;
     for (CBlockIndex* pindex = pindexBest; pindex && pindex->pprev; pindex = pindex->pprev)
@@ -552,6 +919,7 @@ bool CTxDB::LoadBlockIndex()
             }
         }
     }
+    LogPrintf("LoadBlockIndex(): verified blocks in %dms\n", GetTimeMillis() - nStart);
     if (pindexFork)
     {
         boost::this_thread::interruption_point();
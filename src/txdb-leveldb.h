@@ -7,6 +7,7 @@
 #define BITCOIN_LEVELDB_H
 
 #include "main.h"
+#include "leveldbbatch.h"
 
 #include <map>
 #include <string>
@@ -15,6 +16,18 @@
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
+/** Address index key layout, stored once the index is complete */
+static const int ADDR_INDEX_VERSION = 1;
+
+// Options shared by the txdb and the secure messaging DB: block cache and
+// bloom filter plus the -dbwritebuffer, -dbmaxopenfiles, -dbblocksize and
+// -dbcompression settings. fBulkLoad raises the write buffer to
+// -dbbulkwritebuffer for writing the whole chain.
+leveldb::Options GetLevelDBOptions(size_t nCacheSize, bool fBulkLoad);
+
+// Approximate on-disk size of all keys under a serialized string prefix.
+uint64_t GetLevelDBPrefixSize(leveldb::DB* pdb, const std::string& strPrefix);
+
 // Class that provides access to a LevelDB. Note that this class is frequently
 // instantiated on the stack and then destroyed again, so instantiation has to
 // be very cheap. Unfortunately that means, a CTxDB instance is actually just a
@@ -45,17 +58,12 @@ private:
 
     // A batch stores up writes and deletes for atomic application. When this
     // field is non-NULL, writes/deletes go there instead of directly to disk.
-    leveldb::WriteBatch *activeBatch;
+    CLevelDBBatch *activeBatch;
     leveldb::Options options;
     bool fReadOnly;
     int nVersion;
 
 protected:
-    // Returns true and sets (value,false) if activeBatch contains the given key
-    // or leaves value alone and sets deleted = true if activeBatch contains a
-    // delete for it.
-    bool ScanBatch(const CDataStream &key, std::string *value, bool *deleted) const;
-
     template<typename K, typename T>
     bool Read(const K& key, T& value)
     {
@@ -69,7 +77,7 @@ protected:
             // First we must search for it in the currently pending set of
             // changes to the db. If not found in the batch, go on to read disk.
             bool deleted = false;
-            readFromDb = ScanBatch(ssKey, &strValue, &deleted) == false;
+            readFromDb = activeBatch->Lookup(ssKey.str(), &strValue, &deleted) == false;
             if (deleted) {
                 return false;
             }
@@ -151,9 +159,8 @@ protected:
 
         if (activeBatch) {
             bool deleted;
-            if (ScanBatch(ssKey, &unused, &deleted) && !deleted) {
-                return true;
-            }
+            if (activeBatch->Lookup(ssKey.str(), &unused, &deleted))
+                return !deleted;
         }
 
 
@@ -172,6 +179,14 @@ public:
         return true;
     }
 
+    // Compact every -dbcompactblocks blocks while bulk loading, and once
+    // more when the initial download is over.
+    void CompactBulkLoad(bool fInitialDownload);
+    static bool IsBulkLoading();
+
+    std::string GetStats();
+    uint64_t GetApproximateSize(const std::string& strPrefix);
+
     bool ReadVersion(int& nVersion)
     {
         nVersion = 0;
@@ -183,8 +198,16 @@ public:
         return Write(std::string("version"), nVersion);
     }
 
-    bool ReadAddrIndex(uint160 addrHash, std::vector<uint256>& txHashes);
-    bool WriteAddrIndex(uint160 addrHash, uint256 txHash);
+    // Address index: nSkip < 0 starts that many entries back from the newest.
+    bool ReadAddrIndex(uint160 addrHash, std::vector<uint256>& txHashes, int nSkip, unsigned int nCount);
+    bool WriteAddrIndex(uint160 addrHash, int nHeight, unsigned int nTxIndex, uint256 txHash);
+    bool EraseAddrIndex(uint160 addrHash, int nHeight, unsigned int nTxIndex);
+    // Version of a complete address index, missing if it has to be rebuilt
+    bool ReadAddrIndexVersion(int& nVersion);
+    bool WriteAddrIndexVersion(int nVersion);
+    bool EraseAddrIndexVersion();
+    // Drop the per-address txid lists of the old "adr" index
+    bool EraseLegacyAddrIndex();
     bool ReadTxIndex(uint256 hash, CTxIndex& txindex);
     bool UpdateTxIndex(uint256 hash, const CTxIndex& txindex);
     bool AddTxIndex(const CTransaction& tx, const CDiskTxPos& pos, int nHeight);
@@ -200,7 +223,9 @@ public:
     bool ReadBestInvalidTrust(CBigNum& bnBestInvalidTrust);
     bool WriteBestInvalidTrust(CBigNum bnBestInvalidTrust);
     bool LoadBlockIndex();
+    bool WriteBlockIndexSnapshot();
 private:
+    bool LoadBlockIndexSnapshot(const uint256& hashBestChainDB);
     bool LoadBlockIndexGuts();
 };
 
@@ -9,8 +9,68 @@
 
 using namespace std;
 
+CTxMemPoolEntry::CTxMemPoolEntry()
+{
+    nFee = 0;
+    nTxSize = 0;
+    dInputPriority = 0;
+    nValueInChain = 0;
+    nHeight = 0;
+}
+
+CTxMemPoolEntry::CTxMemPoolEntry(int64_t nFeeIn, unsigned int nTxSizeIn, double dInputPriorityIn,
+                                 int64_t nValueInChainIn, int nHeightIn) :
+    nFee(nFeeIn), nTxSize(nTxSizeIn), dInputPriority(dInputPriorityIn),
+    nValueInChain(nValueInChainIn), nHeight(nHeightIn)
+{
+}
+
+double CTxMemPoolEntry::GetPriority(int nCurrentHeight) const
+{
+    if (nTxSize == 0)
+        return 0;
+    return (dInputPriority + (double)nValueInChain * (nCurrentHeight - nHeight)) / nTxSize;
+}
+
+double CTxMemPoolEntry::GetFeePerKb() const
+{
+    if (nTxSize == 0)
+        return 0;
+    return double(nFee) / (double(nTxSize) / 1000.0);
+}
+
 CTxMemPool::CTxMemPool()
 {
+    nTransactionsUpdated = 0;
+    nPriorityHeight = 0;
+}
+
+void CTxMemPool::addToIndexes(const uint256& hash, const CTxMemPoolEntry& entry)
+{
+    mapEntry[hash] = entry;
+    setByFeeRate.insert(make_pair(entry.GetFeePerKb(), hash));
+    setByPriority.insert(make_pair(entry.GetPriority(nPriorityHeight), hash));
+}
+
+void CTxMemPool::removeFromIndexes(const uint256& hash)
+{
+    map<uint256, CTxMemPoolEntry>::iterator it = mapEntry.find(hash);
+    if (it == mapEntry.end())
+        return;
+    setByFeeRate.erase(make_pair(it->second.GetFeePerKb(), hash));
+    setByPriority.erase(make_pair(it->second.GetPriority(nPriorityHeight), hash));
+    mapEntry.erase(it);
+}
+
+void CTxMemPool::UpdatePriorities(int nHeight)
+{
+    LOCK(cs);
+    if (nHeight == nPriorityHeight)
+        return;
+    nPriorityHeight = nHeight;
+    setByPriority.clear();
+    for (map<uint256, CTxMemPoolEntry>::const_iterator it = mapEntry.begin(); it != mapEntry.end(); ++it)
+        setByPriority.insert(make_pair(it->second.GetPriority(nPriorityHeight), it->first));
 }
 
 unsigned int CTxMemPool::GetTransactionsUpdated() const
@@ -25,14 +85,16 @@ void CTxMemPool::AddTransactionsUpdated(unsigned int n)
     nTransactionsUpdated += n;
 }
 
-bool CTxMemPool::addUnchecked(const uint256& hash, CTransaction &tx)
+bool CTxMemPool::addUnchecked(const uint256& hash, CTransaction &tx, const CTxMemPoolEntry& entry)
 {
     // Add to memory pool without checking anything.
     // Used by main.cpp AcceptToMemoryPool(), which DOES do
     // all the appropriate checks.
     LOCK(cs);
     {
+        removeFromIndexes(hash);
         mapTx[hash] = tx;
+        addToIndexes(hash, entry);
         for (unsigned int i = 0; i < tx.vin.size(); i++)
             mapNextTx[tx.vin[i].prevout] = CInPoint(&mapTx[hash], i);
         nTransactionsUpdated++;
@@ -58,6 +120,7 @@ bool CTxMemPool::remove(const CTransaction &tx, bool fRecursive)
             BOOST_FOREACH(const CTxIn& txin, tx.vin)
                 mapNextTx.erase(txin.prevout);
             mapTx.erase(hash);
+            removeFromIndexes(hash);
             nTransactionsUpdated++;
         }
     }
@@ -84,6 +147,9 @@ void CTxMemPool::clear()
     LOCK(cs);
     mapTx.clear();
     mapNextTx.clear();
+    mapEntry.clear();
+    setByFeeRate.clear();
+    setByPriority.clear();
     ++nTransactionsUpdated;
 }
 
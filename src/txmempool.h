@@ -7,6 +7,33 @@
 
 #include "core.h"
 
+#include <set>
+
+/** Data about a memory pool transaction that block assembly needs, computed
+ *  once when the transaction is accepted so templates don't re-read inputs.
+ */
+class CTxMemPoolEntry
+{
+public:
+    int64_t nFee;            // inputs minus outputs
+    unsigned int nTxSize;    // serialized size
+    double dInputPriority;   // sum(value * confirmations) over inputs in the chain
+    int64_t nValueInChain;   // value of those inputs, which gain one confirmation per block
+    int nHeight;             // best height when the transaction was accepted
+
+    CTxMemPoolEntry();
+    CTxMemPoolEntry(int64_t nFeeIn, unsigned int nTxSizeIn, double dInputPriorityIn,
+                    int64_t nValueInChainIn, int nHeightIn);
+
+    // Priority is sum(valuein * age) / txsize, at best height nCurrentHeight
+    double GetPriority(int nCurrentHeight) const;
+
+    // This is a more accurate fee-per-kilobyte than is used by the client code, because the
+    // client code rounds up the size to the nearest 1K. That's good, because it gives an
+    // incentive to create smaller transactions.
+    double GetFeePerKb() const;
+};
+
 /*
  * CTxMemPool stores valid-according-to-the-current-best-chain
  * transactions that may be included in the next block.
@@ -22,20 +49,32 @@ class CTxMemPool
 private:
     unsigned int nTransactionsUpdated;
 
+    void addToIndexes(const uint256& hash, const CTxMemPoolEntry& entry);
+    void removeFromIndexes(const uint256& hash);
+
 public:
     mutable CCriticalSection cs;
     std::map<uint256, CTransaction> mapTx;
     std::map<COutPoint, CInPoint> mapNextTx;
+    std::map<uint256, CTxMemPoolEntry> mapEntry;
+
+    // Block assembly orderings, ascending: (fee per kB, txid) and
+    // (priority at nPriorityHeight, txid)
+    std::set<std::pair<double, uint256> > setByFeeRate;
+    std::set<std::pair<double, uint256> > setByPriority;
+    int nPriorityHeight;
 
     CTxMemPool();
 
-    bool addUnchecked(const uint256& hash, CTransaction &tx);
+    bool addUnchecked(const uint256& hash, CTransaction &tx, const CTxMemPoolEntry& entry);
     bool remove(const CTransaction &tx, bool fRecursive = false);
     bool removeConflicts(const CTransaction &tx);
     void clear();
     void queryHashes(std::vector<uint256>& vtxid);
     unsigned int GetTransactionsUpdated() const;
     void AddTransactionsUpdated(unsigned int n);
+    // Re-rank setByPriority for best height nHeight; only does work once per block
+    void UpdatePriorities(int nHeight);
 
     unsigned long size() const
     {